@@ -5,12 +5,14 @@
 #include "etcoverage.h"
 #include "conductor/interface.h"
 #include "pass/aflcoverage.h"
+#include "pass/peephole.h"
 #include "pass/ldsorefs.h"
 #include "pass/ifuncplts.h"
 #include "log/registry.h"
 #include "log/temp.h"
 
-static void parse(const std::string& filename, const std::string& output, bool quiet) {
+static void parse(const std::string& filename, const std::string& output,
+    bool quiet, AFLCoveragePass::Mode mode) {
     std::cout << "Instrumenting file [" << filename << "]\n";
 
     // Set logging levels according to quiet and EGALITO_DEBUG env var.
@@ -37,8 +39,10 @@ static void parse(const std::string& filename, const std::string& output, bool q
         // Apply transformations.
         auto program = egalito.getProgram();
         std::cout << "Adding coverage calls...\n";
-        AFLCoveragePass aflCoverage;
+        AFLCoveragePass aflCoverage(mode);
         program->accept(&aflCoverage);
+        PeepholePass peephole("AFLCoveragePass");
+        program->accept(&peephole);
 
         // Generate output, mirrorgen or uniongen. If only one argument is
         // given to generate(), automatically guess based on whether multiple
@@ -59,6 +63,7 @@ static void printUsage(const char *program) {
         "Options:\n"
         "    -v     Verbose mode, print logging messages\n"
         "    -q     Quiet mode (default), suppress logging messages\n"
+        "    -e     Edge coverage (cur ^ prev, as afl-gcc) with fewer blocks\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
 
@@ -74,6 +79,7 @@ int main(int argc, char *argv[]) {
     }
 
     bool quiet = true;
+    auto mode = AFLCoveragePass::MODE_QUEUE;
 
     struct {
         const char *str;
@@ -82,6 +88,9 @@ int main(int argc, char *argv[]) {
         // should we show debugging log messages?
         {"-v", [&quiet] () { quiet = false; }},
         {"-q", [&quiet] () { quiet = true; }},
+
+        // which instrumentation to insert into each block
+        {"-e", [&mode] () { mode = AFLCoveragePass::MODE_EDGE; }},
     };
 
     for(int a = 1; a < argc; a ++) {
@@ -100,7 +109,7 @@ int main(int argc, char *argv[]) {
             }
         }
         else if(argv[a] && argv[a + 1]) {
-            parse(argv[a], argv[a + 1], quiet);
+            parse(argv[a], argv[a + 1], quiet, mode);
             break;
         }
         else {
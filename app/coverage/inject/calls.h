@@ -8,6 +8,7 @@ void *shmat(int shmid, const void *shmaddr, int shmflg);
 int shmdt(const void *shmaddr);
 ssize_t write(int fd, const void *buf, size_t count);
 void *__mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
+int arch_prctl(int code, void *addr);
 
 #define stdout 1
 #define stderr 2
@@ -3,11 +3,13 @@
 .global exit
 .global write
 .global __mmap
+.global arch_prctl
 .hidden shmat
 .hidden shmdt
 .hidden exit
 .hidden write
 .hidden __mmap
+.hidden arch_prctl
 
 .section .text
 
@@ -34,6 +36,15 @@ shmdt:
     pop     %rcx
     retq
 
+arch_prctl:
+    push    %rcx
+    push    %r11
+    mov     $158, %rax  # arch_prctl
+    syscall             # other args in %rdi, %rsi
+    pop     %r11
+    pop     %rcx
+    retq
+
 write:
     push    %rcx
     push    %r11
@@ -1,5 +1,6 @@
 #include <sys/shm.h>
 #include <sys/mman.h>
+#include <asm/prctl.h>  /* for ARCH_SET_GS */
 #include "calls.h"
 
 #define EGALITO_MAP_BASE 0x50000000
@@ -64,6 +65,9 @@ void map_shmem(char *env) {
 void map_control_page(void) {
     __mmap((void *)(EGALITO_MAP_BASE - 0x1000), 0x1000,
         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    /* edge coverage keeps prev_loc at %gs:0x8 */
+    arch_prctl(ARCH_SET_GS, (void *)(EGALITO_MAP_BASE - 0x1000));
 }
 
 char *find_env(int argc, char **argv) {
@@ -8,8 +8,10 @@
 #include "pass/endbradd.h"
 #include "pass/endbrenforce.h"
 #include "pass/shadowstack.h"
+#include "pass/peephole.h"
 #include "pass/permutedata.h"
 #include "pass/profileinstrument.h"
+#include "pass/edgeprofileinstrument.h"
 #include "pass/profilesave.h"
 #include "pass/condwatchpoint.h"
 #include "pass/retpoline.h"
@@ -61,6 +63,9 @@ void HardenApp::doShadowStack(bool gsMode) {
     ShadowStackPass shadowStack(gsMode
         ? ShadowStackPass::MODE_GS : ShadowStackPass::MODE_CONST);
     program->accept(&shadowStack);
+
+    PeepholePass peephole("ShadowStackPass");
+    program->accept(&peephole);
 }
 
 void HardenApp::doPermuteData() {
@@ -76,6 +81,16 @@ void HardenApp::doProfiling() {
     RUN_PASS(ProfileSavePass(), program);
 }
 
+void HardenApp::doEdgeProfiling() {
+    std::cout << "Adding block and branch profiling...\n";
+    auto program = getProgram();
+    RUN_PASS(EdgeProfileInstrumentPass(), program);
+    RUN_PASS(ProfileSavePass(EdgeProfileInstrumentPass::EDGE_SECTION_NAME,
+        EdgeProfileInstrumentPass::EDGE_NAMESECTION_NAME,
+        EdgeProfileInstrumentPass::EDGE_DATA_FILENAME,
+        "egalito_edge_profiling_save_bytes"), program);
+}
+
 void HardenApp::doWatching() {
     std::cout << "Adding conditional watchpoint...\n";
     auto program = getProgram();
@@ -114,6 +129,7 @@ static void printUsage(const char *program) {
         "        --cet-const     Constant offset shadow stack implementation\n"
         "    --permute-data Randomize order of global variables in .data\n"
         "    --profile      Add profiling counters to each function\n"
+        "    --edge-profile Add counters to each block and branch (for etorder -b)\n"
         "    --cond-watchpoint   Add conditional watchpoints for GDB\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
@@ -146,6 +162,7 @@ void HardenApp::run(int argc, char **argv) {
         {"--cet-const",     [&ops] () { ops.push_back("cet-const"); }},
         {"--permute-data",  [&ops] () { ops.push_back("permute-data"); }},
         {"--profile",       [&ops] () { ops.push_back("profile"); }},
+        {"--edge-profile",  [&ops] () { ops.push_back("edge-profile"); }},
         {"--cond-watchpoint", [&ops] () { ops.push_back("cond-watchpoint"); }},
     };
 
@@ -158,6 +175,7 @@ void HardenApp::run(int argc, char **argv) {
         {"cet-const",       [this] () { doShadowStack(false); doCFI(); }},
         {"permute-data",    [this] () { doPermuteData(); }},
         {"profile",         [this] () { doProfiling(); }},
+        {"edge-profile",    [this] () { doEdgeProfiling(); }},
         {"cond-watchpoint", [this] () { doWatching(); }},
         {"retpolines",      [this] () { doRetpolines(); }},
     };
@@ -2,7 +2,6 @@
 #include <iomanip>
 #include <fstream>
 #include <sstream>
-#include <cassert>
 #include <string>
 #include <utility>
 #include <cmath>
@@ -12,6 +11,12 @@
 #include "conductor/interface.h"
 #include "chunk/function.h"
 #include "operation/find2.h"
+#include "analysis/edgeprofile.h"
+#include "analysis/callgraphlayout.h"
+#include "pass/blockreorder.h"
+#include "pass/hotcoldsplit.h"
+#include "pass/inlinecalls.h"
+#include "pass/permutedata.h"
 
 #undef DEBUG_GROUP
 #define DEBUG_GROUP load
@@ -82,7 +87,9 @@ static std::vector<Function *> parseOrder(Conductor *conductor, Module *module,
 }
 
 static void parse(const std::string &filename, const std::string &orderFile,
-    const std::string &output, bool oneToOne, bool quiet) {
+    const std::string &output, const char *blockProfile, bool splitCold,
+    bool inlineCalls, bool packData, const char *callProfile, bool oneToOne,
+    bool quiet) {
 
     std::cout << "Transforming file [" << filename << "]\n";
 
@@ -108,11 +115,59 @@ static void parse(const std::string &filename, const std::string &orderFile,
         // given to generate(), automatically guess based on whether multiple
         // Modules are present.
         std::cout << "Performing code generation into [" << output << "]...\n";
-        assert(oneToOne);
 
-        auto order = parseOrder(egalito.getConductor(), module, orderFile);
+        EdgeProfile profile;
+        bool haveProfile = false;
+        if(blockProfile) {
+            haveProfile = profile.parse(blockProfile);
+            if(!haveProfile) {
+                std::cout << "Warning: cannot read block profile ["
+                    << blockProfile << "]\n";
+            }
+        }
 
-        egalito.generate(output, order);
+        // before inlining, while the profile still matches every function
+        if(packData) {
+            std::cout << "Packing hot variables in .data...\n";
+            RUN_PASS(PermuteDataPass(PermuteDataPass::MODE_HOT,
+                haveProfile ? &profile : nullptr), module);
+        }
+
+        if(haveProfile) {
+            if(inlineCalls) {
+                std::cout << "Inlining hot calls using [" << blockProfile
+                    << "]...\n";
+                RUN_PASS(InlineCallsPass(&profile), module);
+            }
+            if(splitCold) {
+                std::cout << "Reordering blocks and splitting cold code "
+                    "using [" << blockProfile << "]...\n";
+                RUN_PASS(HotColdSplitPass(&profile, true), module);
+            }
+            else {
+                std::cout << "Reordering blocks using [" << blockProfile
+                    << "]...\n";
+                RUN_PASS(BlockReorderPass(&profile), module);
+            }
+        }
+
+        // after splitting, so that the new cold functions are included
+        std::vector<Function *> order;
+        EdgeProfile callCounts;
+        if(callProfile && callCounts.parse(callProfile)) {
+            std::cout << "Clustering functions by calls in ["
+                << callProfile << "]...\n";
+            order = CallGraphLayout::layout(egalito.getProgram(), &callCounts);
+        }
+        else {
+            if(callProfile) {
+                std::cout << "Warning: cannot read call profile ["
+                    << callProfile << "]\n";
+            }
+            order = parseOrder(egalito.getConductor(), module, orderFile);
+        }
+
+        egalito.generate(output, order, !oneToOne);
 
     }
     catch(const char *message) {
@@ -129,6 +184,20 @@ static void printUsage(const char *program) {
         "    -u     Perform union elf generation (merged output)\n"
         "    -v     Verbose mode, print logging messages\n"
         "    -q     Quiet mode (default), suppress logging messages\n"
+        "    -b edge-profile\n"
+        "           Also reorder blocks within functions, using the output\n"
+        "           of etprofile -e\n"
+        "    -c     With -b, also move never-executed code into .text.cold\n"
+        "    -i     With -b, first inline small leaf functions at hot call\n"
+        "           sites (those callers are then not reordered)\n"
+        "    -d     Pack frequently accessed variables of .data together,\n"
+        "           keeping written ones apart from read-mostly ones; uses\n"
+        "           the -b profile if given, else static access counts\n"
+        "    -g edge-profile\n"
+        "           Cluster callers with their callees (C3), using call counts\n"
+        "           from the output of etprofile -e, instead of the\n"
+        "           function-ordering file. With -u, functions of all\n"
+        "           libraries are laid out together\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
 
@@ -140,6 +209,11 @@ int main(int argc, char *argv[]) {
 
     bool oneToOne = true;
     bool quiet = true;
+    const char *blockProfile = nullptr;
+    bool splitCold = false;
+    bool inlineCalls = false;
+    bool packData = false;
+    const char *callProfile = nullptr;
 
     struct {
         const char *str;
@@ -152,11 +226,22 @@ int main(int argc, char *argv[]) {
         // should we show debugging log messages?
         {"-v", [&quiet] () { quiet = false; }},
         {"-q", [&quiet] () { quiet = true; }},
+
+        // profile-guided layout
+        {"-c", [&splitCold] () { splitCold = true; }},
+        {"-i", [&inlineCalls] () { inlineCalls = true; }},
+        {"-d", [&packData] () { packData = true; }},
     };
 
     for(int a = 1; a < argc; a ++) {
         const char *arg = argv[a];
-        if(arg[0] == '-') {
+        if(std::strcmp(arg, "-b") == 0 && a + 1 < argc) {
+            blockProfile = argv[++a];
+        }
+        else if(std::strcmp(arg, "-g") == 0 && a + 1 < argc) {
+            callProfile = argv[++a];
+        }
+        else if(arg[0] == '-') {
             bool found = false;
 
             for(auto action : actions) {
@@ -171,7 +256,8 @@ int main(int argc, char *argv[]) {
             }
         }
         else if(argv[a] && argv[a + 1] && argv[a + 2]) {
-            parse(argv[a], argv[a + 1], argv[a + 2], oneToOne, quiet);
+            parse(argv[a], argv[a + 1], argv[a + 2], blockProfile, splitCold,
+                inlineCalls, packData, callProfile, oneToOne, quiet);
             break;
         }
         else {
@@ -1,31 +1,135 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <cstring>  // for std::strlen
+#include <cstring>  // for std::strlen, std::strcmp
 #include <cstdio>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "elf/elfmap.h"
+#include "runtime/sampler.h"
 
 static void printUsage(const char *program) {
     std::cout << "Usage: " << program << " [options] executable\n"
         "    Summarizes profiling information from profile.data, like gprof.\n"
+        "   OR: " << program << " -e executable\n"
+        "    Prints block and branch counts from edges.data, written by a\n"
+        "    binary from etharden --edge-profile (for etorder -b).\n"
+        "   OR: " << program << " -s samples [symbols.elf]\n"
+        "    Maps PCs sampled by the loader (EGALITO_SAMPLE=samples) back to\n"
+        "    functions. The output can be given to etorder directly.\n"
         "\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
 
-int main(int argc, char *argv[]) {
-    if(argc < 2) {
-        printUsage(argv[0] ? argv[0] : "etprofile");
-        return 0;
+static const SampleBuffer *mapSamples(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) return nullptr;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SampleBuffer)) {
+        close(fd);
+        return nullptr;
+    }
+    void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) return nullptr;
+
+    auto buffer = static_cast<const SampleBuffer *>(mem);
+    if(buffer->magic != SampleBuffer::MAGIC
+        || buffer->version != SampleBuffer::VERSION
+        || sizeof(SampleBuffer) + buffer->capacity * sizeof(uint64_t)
+            > (size_t)st.st_size) {
+
+        return nullptr;
+    }
+    return buffer;
+}
+
+static int printSamples(const char *sampleFile, const char *symbolFile) {
+    auto buffer = mapSamples(sampleFile);
+    if(!buffer) {
+        std::cerr << "cannot read samples from " << sampleFile << "\n";
+        return 1;
+    }
+
+    // symbols.elf holds one symbol per function, named with a $new suffix
+    ElfMap *elf = new ElfMap(symbolFile);
+    auto symtab = elf->findSection(".symtab");
+    if(!symtab) {
+        std::cerr << "no symbols in " << symbolFile << "\n";
+        return 1;
+    }
+    auto symbols = elf->getSectionReadPtr<ElfXX_Sym *>(symtab);
+    size_t symbolCount = symtab->getSize() / sizeof(ElfXX_Sym);
+
+    struct Range {
+        address_t start, end;
+        std::string name;
+        bool operator < (const Range &other) const
+            { return start < other.start; }
+    };
+    std::vector<Range> ranges;
+    for(size_t i = 0; i < symbolCount; i ++) {
+        if(!symbols[i].st_size) continue;
+
+        std::string name = elf->getStrtab() + symbols[i].st_name;
+        auto suffix = name.rfind('$');
+        if(suffix != std::string::npos) name = name.substr(0, suffix);
+        ranges.push_back({symbols[i].st_value,
+            symbols[i].st_value + symbols[i].st_size, name});
+    }
+    std::sort(ranges.begin(), ranges.end());
+
+    std::map<std::string, unsigned long> count;
+    unsigned long unknown = 0;
+    auto total = std::min(buffer->count, buffer->capacity);
+    for(uint64_t i = 0; i < total; i ++) {
+        auto pc = buffer->pcs[i];
+        auto it = std::upper_bound(ranges.begin(), ranges.end(),
+            Range{pc, pc, ""});
+        if(it != ranges.begin() && pc < (--it)->end) {
+            count[it->name] ++;
+        }
+        else unknown ++;
+    }
+
+    std::vector<std::pair<unsigned long, std::string>> sorted;
+    for(auto &kv : count) sorted.push_back({kv.second, kv.first});
+    std::sort(sorted.rbegin(), sorted.rend());
+    for(auto &p : sorted) {
+        std::printf("%5ld [%s]\n", p.first, p.second.c_str());
+    }
+
+    std::fprintf(stderr, "%ld samples at %d Hz, %ld outside the sandbox",
+        (long)total, (int)buffer->hz, unknown);
+    if(buffer->count > buffer->capacity) {
+        std::fprintf(stderr, ", %ld dropped",
+            (long)(buffer->count - buffer->capacity));
     }
+    std::fprintf(stderr, "\n");
+    return 0;
+}
 
-    ElfMap *elf = new ElfMap(argv[1]);
-    auto section = elf->findSection(".profiling");
-    auto nameSection = elf->findSection(".profiling.names");
+static int printCounts(const char *executable, const char *sectionName,
+    const char *nameSectionName, const char *dataFile, bool edges) {
+
+    ElfMap *elf = new ElfMap(executable);
+    auto section = elf->findSection(sectionName);
+    auto nameSection = elf->findSection(nameSectionName);
+    if(!section || !nameSection) {
+        std::cerr << "no " << sectionName << " section in "
+            << executable << "\n";
+        return 1;
+    }
 
     size_t size = section->getSize();
     char *data = new char [size];
     std::vector<unsigned long> count(size / sizeof(unsigned long));
-    std::ifstream file("profile.data");
+    std::ifstream file(dataFile);
     while(file.read(data, size)) {
         unsigned long *uldata = reinterpret_cast<unsigned long *>(data);
         for(size_t i = 0; i < size / sizeof(unsigned long); i ++) {
@@ -35,9 +139,45 @@ int main(int argc, char *argv[]) {
 
     char *p = reinterpret_cast<char *>(nameSection->getReadAddress());
     for(size_t i = 0; i < count.size(); i ++) {
-        std::printf("%5ld [%s]\n", count[i], p);
+        if(edges) {
+            // names are "function index kind module"
+            std::string name(p);
+            auto space = name.find(' ');
+            std::printf("%5ld [%s]%s\n", count[i],
+                name.substr(0, space).c_str(), name.substr(space).c_str());
+        }
+        else {
+            std::printf("%5ld [%s]\n", count[i], p);
+        }
         p += std::strlen(p) + 1;
     }
 
     return 0;
 }
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        printUsage(argv[0] ? argv[0] : "etprofile");
+        return 0;
+    }
+
+    if(!std::strcmp(argv[1], "-s")) {
+        if(argc < 3) {
+            printUsage(argv[0]);
+            return 0;
+        }
+        return printSamples(argv[2], argc > 3 ? argv[3] : "symbols.elf");
+    }
+
+    if(!std::strcmp(argv[1], "-e")) {
+        if(argc < 3) {
+            printUsage(argv[0]);
+            return 0;
+        }
+        return printCounts(argv[2], ".profiling.edges",
+            ".profiling.edges.names", "edges.data", true);
+    }
+
+    return printCounts(argv[1], ".profiling", ".profiling.names",
+        "profile.data", false);
+}
@@ -16,6 +16,7 @@
 #include "pass/clearplts.h"
 #include "pass/clearspatial.h"
 #include "pass/collapseplt.h"
+#include "pass/collapsegot.h"
 #include "pass/collectglobals.h"
 #include "pass/debloat.h"
 #include "pass/detectnullptr.h"
@@ -55,6 +56,7 @@
 #include "pass/makecache.h"
 #include "pass/nonreturn.h"
 #include "pass/noppass.h"
+#include "pass/peephole.h"
 #include "pass/permutedata.h"
 #include "pass/populateplt.h"
 #include "pass/positiondump.h"
@@ -112,6 +114,8 @@ void PassCommands::makePassMap(EgalitoInterface *egalito) {
     passMap["collapseplt"] = PassContext(true, {},
         [egalito] (Chunk *chunk)
             { return new CollapsePLTPass(egalito->getConductor()); });
+    passMap["collapsegot"] = PassContext({TYPE_Program, TYPE_Module},
+        [] (Chunk *chunk) { return new CollapseGOTPass(); });
     passMap["endbradd"] = PassContext(true, {},
         [] (Chunk *chunk) { return new EndbrAddPass(); });
     passMap["endbrenforce"] = PassContext(true, {},
@@ -122,6 +126,8 @@ void PassCommands::makePassMap(EgalitoInterface *egalito) {
         [] (Chunk *chunk) { return new ShadowStackPass(ShadowStackPass::MODE_CONST); });
     passMap["shadowstackgs"] = PassContext(true, {},
         [] (Chunk *chunk) { return new ShadowStackPass(ShadowStackPass::MODE_GS); });
+    passMap["peephole"] = PassContext(true, {},
+        [] (Chunk *chunk) { return new PeepholePass(); });
 
 #if 0
 pass/clearplts.h
@@ -0,0 +1,148 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>  // for std::atoi
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <signal.h>
+#include "runtime/jitstats.h"
+
+static void printUsage(const char *program) {
+    std::cout << "Usage: " << program << " pid [interval]\n"
+        "    Prints the JIT-shuffling counters of a process run by the\n"
+        "    Egalito loader with EGALITO_USE_GS=1 EGALITO_JIT_STATS=1.\n"
+        "    With an interval (in seconds), repeats and shows rates.\n"
+        "    Removes the segment file, so it can only be read once.\n";
+}
+
+static const JITStatsSegment *openSegment(int pid) {
+    char path[64];
+    JITStatsSegment::getPath(pid, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "cannot open " << path << "\n";
+        return nullptr;
+    }
+    void *mem = mmap(nullptr, sizeof(JITStatsSegment), PROT_READ,
+        MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) return nullptr;
+
+    // the process never removes its segment; the mapping outlives the file
+    unlink(path);
+
+    auto segment = static_cast<const JITStatsSegment *>(mem);
+    if(__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE)
+        != JITStatsSegment::MAGIC
+        || segment->version != JITStatsSegment::VERSION) {
+
+        std::cerr << path << " is not a JIT statistics segment\n";
+        return nullptr;
+    }
+    return segment;
+}
+
+static std::vector<JITStats> snapshot(const JITStatsSegment *segment) {
+    auto count = __atomic_load_n(&segment->threadCount, __ATOMIC_RELAXED);
+    if(count > segment->maxThreads) count = segment->maxThreads;
+
+    std::vector<JITStats> list;
+    for(uint32_t i = 0; i < count; i ++) {
+        const auto &s = segment->threads[i];
+        JITStats copy;
+        copy.tid = __atomic_load_n(&s.tid, __ATOMIC_RELAXED);
+        copy.fixups = __atomic_load_n(&s.fixups, __ATOMIC_RELAXED);
+        copy.fixupNanos = __atomic_load_n(&s.fixupNanos, __ATOMIC_RELAXED);
+        copy.bytesGenerated = __atomic_load_n(&s.bytesGenerated,
+            __ATOMIC_RELAXED);
+        copy.resets = __atomic_load_n(&s.resets, __ATOMIC_RELAXED);
+        copy.resetNanos = __atomic_load_n(&s.resetNanos, __ATOMIC_RELAXED);
+        copy.lastResetNanos = __atomic_load_n(&s.lastResetNanos,
+            __ATOMIC_RELAXED);
+        copy.bytesRegenerated = __atomic_load_n(&s.bytesRegenerated,
+            __ATOMIC_RELAXED);
+        copy.initNanos = __atomic_load_n(&s.initNanos, __ATOMIC_RELAXED);
+        copy.entriesSet = __atomic_load_n(&s.entriesSet, __ATOMIC_RELAXED);
+        copy.sandboxUsed = __atomic_load_n(&s.sandboxUsed, __ATOMIC_RELAXED);
+        copy.sandboxSize = __atomic_load_n(&s.sandboxSize, __ATOMIC_RELAXED);
+        copy.tableEntries = __atomic_load_n(&s.tableEntries, __ATOMIC_RELAXED);
+        copy.tableResetNanos = __atomic_load_n(&s.tableResetNanos,
+            __ATOMIC_RELAXED);
+        list.push_back(copy);
+    }
+    return list;
+}
+
+static void print(const std::vector<JITStats> &now,
+    const std::vector<JITStats> &before, int interval) {
+
+    std::cout << std::setw(8) << "tid"
+        << std::setw(10) << "fixups"
+        << std::setw(10) << "fixup/s"
+        << std::setw(10) << "avg us"
+        << std::setw(8) << "resets"
+        << std::setw(10) << "avg us"
+        << std::setw(10) << "last us"
+        << std::setw(10) << "regen kB"
+        << std::setw(10) << "init us"
+        << std::setw(16) << "sandbox kB"
+        << std::setw(9) << "entries"
+        << std::setw(10) << "table ns" << "\n";
+
+    for(size_t i = 0; i < now.size(); i ++) {
+        const auto &s = now[i];
+        std::cout << std::setw(8) << s.tid
+            << std::setw(10) << s.fixups;
+        if(interval && i < before.size()) {
+            std::cout << std::setw(10)
+                << (s.fixups - before[i].fixups) / interval;
+        }
+        else {
+            std::cout << std::setw(10) << "-";
+        }
+        std::cout << std::setw(10)
+                << (s.fixups ? s.fixupNanos / s.fixups / 1000 : 0)
+            << std::setw(8) << s.resets
+            << std::setw(10)
+                << (s.resets ? s.resetNanos / s.resets / 1000 : 0)
+            << std::setw(10) << s.lastResetNanos / 1000
+            << std::setw(10) << s.bytesRegenerated / 1024
+            << std::setw(10) << s.initNanos / 1000
+            << std::setw(8) << s.sandboxUsed / 1024
+                << "/" << std::left << std::setw(7)
+                << s.sandboxSize / 1024 << std::right
+            << std::setw(9) << s.tableEntries
+            << std::setw(10) << s.tableResetNanos << "\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        printUsage(argv[0] ? argv[0] : "etstat");
+        return 0;
+    }
+
+    int pid = std::atoi(argv[1]);
+    int interval = (argc > 2 ? std::atoi(argv[2]) : 0);
+
+    auto segment = openSegment(pid);
+    if(!segment) return 1;
+
+    auto before = snapshot(segment);
+    if(!interval) {
+        print(before, before, 0);
+        return 0;
+    }
+
+    // stop once the process is gone
+    while(kill(pid, 0) == 0) {
+        sleep(interval);
+        auto now = snapshot(segment);
+        print(now, before, interval);
+        std::cout << std::endl;
+        before = now;
+    }
+    return 0;
+}
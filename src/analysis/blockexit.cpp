@@ -0,0 +1,85 @@
+#include <capstone/capstone.h>
+#include "blockexit.h"
+#include "chunk/concrete.h"
+#include "instr/concrete.h"
+
+BlockExit::BlockExit(Block *block) : kind(EXIT_FALLTHROUGH),
+    branch(nullptr), target(nullptr), fallThrough(nullptr), fallsOut(false),
+    shortOnly(false) {
+
+    auto function = static_cast<Function *>(block->getParent());
+    auto last = block->getChildren()->getIterable()->getLast();
+    auto semantic = last ? last->getSemantic() : nullptr;
+
+#ifdef ARCH_X86_64
+    if(dynamic_cast<ReturnInstruction *>(semantic)
+        || dynamic_cast<IndirectJumpInstruction *>(semantic)
+        || dynamic_cast<LiteralInstruction *>(semantic)
+        || dynamic_cast<BreakInstruction *>(semantic)) {
+
+        kind = EXIT_OTHER;
+    }
+    else if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+        if(cfi->getId() == X86_INS_CALL) {
+            if(!cfi->returns()) kind = EXIT_OTHER;
+        }
+        else {
+            kind = (cfi->getId() == X86_INS_JMP
+                ? EXIT_JUMP : EXIT_CONDITIONAL);
+            branch = last;
+            target = getTargetBlock(cfi->getLink(), function);
+
+            switch(cfi->getId()) {
+            case X86_INS_JCXZ:
+            case X86_INS_JECXZ:
+            case X86_INS_JRCXZ:
+            case X86_INS_LOOP:
+            case X86_INS_LOOPE:
+            case X86_INS_LOOPNE:
+                shortOnly = true;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    else if(auto dlcfi
+        = dynamic_cast<DataLinkedControlFlowInstruction *>(semantic)) {
+
+        if(!dlcfi->isCall()) kind = EXIT_OTHER;
+    }
+    else if(semantic) {
+        if(auto assembly = semantic->getAssembly()) {
+            switch(assembly->getId()) {
+            case X86_INS_UD2:
+            case X86_INS_HLT:
+            case X86_INS_JMP:
+                kind = EXIT_OTHER;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+#else
+    // not analyzed; treat every control flow instruction as opaque
+    if(semantic && semantic->isControlFlow()) kind = EXIT_OTHER;
+#endif
+
+    if(canFallThrough()) {
+        fallThrough = static_cast<Block *>(block->getNextSibling());
+        if(!fallThrough) fallsOut = true;
+    }
+}
+
+Block *BlockExit::getTargetBlock(Link *link, Function *function) {
+    if(!link) return nullptr;
+
+    auto instr = dynamic_cast<Instruction *>(link->getTarget());
+    if(!instr) return nullptr;
+
+    auto block = static_cast<Block *>(instr->getParent());
+    if(!block || block->getParent() != function) return nullptr;
+    if(block->getChildren()->getIterable()->get(0) != instr) return nullptr;
+    return block;
+}
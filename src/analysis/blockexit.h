@@ -0,0 +1,45 @@
+#ifndef EGALITO_ANALYSIS_BLOCK_EXIT_H
+#define EGALITO_ANALYSIS_BLOCK_EXIT_H
+
+class Block;
+class Function;
+class Instruction;
+class Link;
+
+/** Describes how control leaves a Block, for passes that change the order
+    of blocks within a function.
+*/
+class BlockExit {
+public:
+    enum Kind {
+        EXIT_FALLTHROUGH,   // no branch, or a call that returns
+        EXIT_JUMP,          // unconditional direct jump
+        EXIT_CONDITIONAL,   // conditional direct jump, else falls through
+        EXIT_OTHER          // return, indirect jump, trap, ...
+    };
+private:
+    Kind kind;
+    Instruction *branch;    // jump instruction, for EXIT_(CONDITIONAL|JUMP)
+    Block *target;          // nullptr if the jump leaves the function
+    Block *fallThrough;     // the next block, if control can fall into it
+    bool fallsOut;          // falls off the end of the function
+    bool shortOnly;         // branch has no rel32 form (jrcxz, loop, ...)
+public:
+    BlockExit(Block *block);
+
+    Kind getKind() const { return kind; }
+    Instruction *getBranch() const { return branch; }
+    Block *getTarget() const { return target; }
+    Block *getFallThrough() const { return fallThrough; }
+    bool canFallThrough() const
+        { return kind == EXIT_FALLTHROUGH || kind == EXIT_CONDITIONAL; }
+    bool fallsOutOfFunction() const { return fallsOut; }
+    /** The branch only has an 8-bit displacement, so PromoteJumpsPass
+        cannot widen it if its target moves away. */
+    bool isShortOnly() const { return shortOnly; }
+
+    /** Returns the block of function starting exactly at link's target. */
+    static Block *getTargetBlock(Link *link, Function *function);
+};
+
+#endif
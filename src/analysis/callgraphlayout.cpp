@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <map>
+#include <utility>
+#include "callgraphlayout.h"
+#include "edgeprofile.h"
+#include "chunk/concrete.h"
+#include "instr/concrete.h"
+#include "log/log.h"
+
+// don't merge into a caller's cluster if its density would drop this much
+#define MAX_DENSITY_DEGRADATION 8.0
+
+size_t CallGraphLayout::addNode(size_t size, unsigned long samples) {
+    nodes.push_back({size ? size : 1, samples});
+    return nodes.size() - 1;
+}
+
+void CallGraphLayout::addArc(size_t caller, size_t callee,
+    unsigned long weight) {
+
+    if(caller == callee || weight == 0) return;
+    arcs.push_back({caller, callee, weight});
+}
+
+std::vector<size_t> CallGraphLayout::computeOrder() const {
+    const size_t NONE = static_cast<size_t>(-1);
+
+    std::map<std::pair<size_t, size_t>, unsigned long> weights;
+    for(auto &arc : arcs) weights[{arc.caller, arc.callee}] += arc.weight;
+
+    std::vector<size_t> heaviestCaller(nodes.size(), NONE);
+    std::vector<unsigned long> heaviestWeight(nodes.size(), 0);
+    for(auto &kv : weights) {
+        auto callee = kv.first.second;
+        if(kv.second > heaviestWeight[callee]) {
+            heaviestWeight[callee] = kv.second;
+            heaviestCaller[callee] = kv.first.first;
+        }
+    }
+
+    struct Cluster {
+        std::vector<size_t> members;
+        size_t size;
+        unsigned long samples;
+        double density() const { return double(samples) / size; }
+    };
+    std::vector<Cluster> clusters;
+    std::vector<size_t> clusterOf(nodes.size());
+    for(size_t i = 0; i < nodes.size(); i ++) {
+        clusters.push_back({{i}, nodes[i].size, nodes[i].samples});
+        clusterOf[i] = i;
+    }
+
+    std::vector<size_t> hot;
+    for(size_t i = 0; i < nodes.size(); i ++) {
+        if(nodes[i].samples) hot.push_back(i);
+    }
+    std::stable_sort(hot.begin(), hot.end(), [this] (size_t a, size_t b) {
+        return nodes[a].samples > nodes[b].samples;
+    });
+
+    for(auto f : hot) {
+        auto caller = heaviestCaller[f];
+        if(caller == NONE) continue;
+
+        auto &to = clusters[clusterOf[caller]];
+        auto &from = clusters[clusterOf[f]];
+        if(&to == &from) continue;
+        if(to.size + from.size > maxClusterSize) continue;
+
+        double merged = double(to.samples + from.samples)
+            / (to.size + from.size);
+        if(to.density() > merged * MAX_DENSITY_DEGRADATION) continue;
+
+        for(auto m : from.members) {
+            to.members.push_back(m);
+            clusterOf[m] = clusterOf[caller];
+        }
+        to.size += from.size;
+        to.samples += from.samples;
+        from.members.clear();
+    }
+
+    std::vector<const Cluster *> sorted;
+    for(auto &cluster : clusters) {
+        if(!cluster.members.empty()) sorted.push_back(&cluster);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [] (const Cluster *a, const Cluster *b) {
+            return a->density() > b->density();
+        });
+
+    std::vector<size_t> order;
+    for(auto cluster : sorted) {
+        order.insert(order.end(), cluster->members.begin(),
+            cluster->members.end());
+    }
+    return order;
+}
+
+std::vector<Function *> CallGraphLayout::layout(Program *program,
+    EdgeProfile *profile, size_t maxClusterSize) {
+
+    CallGraphLayout graph(maxClusterSize);
+    std::vector<Function *> functions;
+    std::map<Function *, size_t> index;
+    for(auto module : CIter::modules(program)) {
+        std::vector<Function *> list;
+        for(auto f : CIter::functions(module)) list.push_back(f);
+        std::sort(list.begin(), list.end(), [] (Function *a, Function *b) {
+            return a->getAddress() < b->getAddress();
+        });
+
+        for(auto f : list) {
+            index[f] = graph.addNode(f->getSize(),
+                profile->getBlockCount(f, 0));
+            functions.push_back(f);
+        }
+    }
+
+    size_t arcCount = 0;
+    for(auto f : functions) {
+        auto counts = profile->getCounts(f);
+        if(!counts || counts->block.size()
+            != f->getChildren()->getIterable()->getCount()) continue;
+
+        size_t i = 0;
+        for(auto block : CIter::children(f)) {
+            auto count = counts->block[i ++];
+            if(!count) continue;
+
+            for(auto instr : CIter::children(block)) {
+                auto callee = getCallee(instr);
+                if(!callee || callee == f || callee->isCold()) continue;
+
+                auto it = index.find(callee);
+                if(it == index.end()) continue;
+                graph.addArc(index[f], (*it).second, count);
+                arcCount ++;
+            }
+        }
+    }
+    LOG(1, "call graph has " << functions.size() << " functions and "
+        << arcCount << " profiled call sites");
+
+    std::vector<Function *> order;
+    for(auto i : graph.computeOrder()) order.push_back(functions[i]);
+    return order;
+}
+
+Function *CallGraphLayout::getCallee(Instruction *instruction) {
+#ifdef ARCH_X86_64
+    // calls, and jumps that leave the function (tail calls)
+    auto cfi = dynamic_cast<ControlFlowInstruction *>(
+        instruction->getSemantic());
+    if(!cfi || !cfi->getLink()) return nullptr;
+
+    auto target = cfi->getLink()->getTarget();
+    if(auto plt = dynamic_cast<PLTTrampoline *>(target)) {
+        target = plt->getTarget();
+    }
+    if(auto function = dynamic_cast<Function *>(target)) return function;
+    if(auto instr = dynamic_cast<Instruction *>(target)) {
+        if(instr->getParent()) {
+            return dynamic_cast<Function *>(instr->getParent()->getParent());
+        }
+    }
+#endif
+    return nullptr;
+}
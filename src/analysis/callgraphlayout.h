@@ -0,0 +1,59 @@
+#ifndef EGALITO_ANALYSIS_CALL_GRAPH_LAYOUT_H
+#define EGALITO_ANALYSIS_CALL_GRAPH_LAYOUT_H
+
+#include <vector>
+#include <cstddef>
+
+class Program;
+class Function;
+class Instruction;
+class EdgeProfile;
+
+/** Orders functions so that hot callers and their callees end up next to
+    each other, with C3 (call-chain clustering, as in hfsort).
+
+    Functions are visited from hottest to coldest, and each one's cluster
+    is appended to the cluster of its heaviest caller, unless that would
+    exceed maxClusterSize or dilute the caller's cluster too much. The
+    clusters are then sorted by density (samples per byte). Ties, including
+    all functions that never ran, keep the order in which nodes were added.
+*/
+class CallGraphLayout {
+public:
+    static const size_t DEFAULT_MAX_CLUSTER_SIZE = 0x1000;  // one page
+private:
+    struct Node {
+        size_t size;
+        unsigned long samples;
+    };
+    struct Arc {
+        size_t caller, callee;
+        unsigned long weight;
+    };
+    std::vector<Node> nodes;
+    std::vector<Arc> arcs;
+    size_t maxClusterSize;
+public:
+    CallGraphLayout(size_t maxClusterSize = DEFAULT_MAX_CLUSTER_SIZE)
+        : maxClusterSize(maxClusterSize) {}
+
+    /** Returns the index of the new node. */
+    size_t addNode(size_t size, unsigned long samples);
+    void addArc(size_t caller, size_t callee, unsigned long weight);
+
+    /** Returns a permutation of all node indices. */
+    std::vector<size_t> computeOrder() const;
+
+    /** Lays out the functions of all modules in program together. A call
+        is counted as often as the block containing it ran, according to
+        profile (from etprofile -e); a function's samples are the entry
+        count of its first block.
+    */
+    static std::vector<Function *> layout(Program *program,
+        EdgeProfile *profile,
+        size_t maxClusterSize = DEFAULT_MAX_CLUSTER_SIZE);
+private:
+    static Function *getCallee(Instruction *instruction);
+};
+
+#endif
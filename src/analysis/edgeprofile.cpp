@@ -0,0 +1,67 @@
+#include <fstream>
+#include <sstream>
+#include "edgeprofile.h"
+#include "chunk/function.h"
+#include "chunk/module.h"
+#include "log/log.h"
+
+bool EdgeProfile::parse(const std::string &filename) {
+    std::ifstream file(filename.c_str());
+    if(!file) return false;
+
+    std::string line;
+    while(std::getline(file, line)) {
+        std::istringstream stream(line);
+
+        unsigned long count = 0;
+        std::string nameToken, kind;
+        size_t index = 0;
+        if(!(stream >> count >> nameToken >> index >> kind)) continue;
+        if(nameToken.size() < 2 || nameToken[0] != '['
+            || nameToken[nameToken.length() - 1] != ']') continue;
+
+        std::string module;
+        stream >> module;   // absent in older profiles
+
+        auto name = nameToken.substr(1, nameToken.length() - 2);
+        auto &counts = countsMap[std::make_pair(module, name)];
+        auto &list = (kind == "taken" ? counts.taken : counts.block);
+        if(list.size() <= index) list.resize(index + 1);
+        list[index] += count;
+    }
+
+    LOG(1, "edge profile has counts for " << countsMap.size()
+        << " functions");
+    return true;
+}
+
+const EdgeProfile::Counts *EdgeProfile::getCounts(Function *function) const {
+    // not every Function is attached to a Module
+    auto list = function->getParent();
+    auto module = dynamic_cast<Module *>(list ? list->getParent() : nullptr);
+    if(module) {
+        auto it = countsMap.find(
+            std::make_pair(module->getName(), function->getName()));
+        if(it != countsMap.end()) return &(*it).second;
+    }
+
+    auto it = countsMap.find(std::make_pair(std::string(),
+        function->getName()));
+    return (it != countsMap.end() ? &(*it).second : nullptr);
+}
+
+unsigned long EdgeProfile::getBlockCount(Function *function,
+    size_t index) const {
+
+    auto counts = getCounts(function);
+    if(!counts || index >= counts->block.size()) return 0;
+    return counts->block[index];
+}
+
+unsigned long EdgeProfile::getTakenCount(Function *function,
+    size_t index) const {
+
+    auto counts = getCounts(function);
+    if(!counts || index >= counts->taken.size()) return 0;
+    return counts->taken[index];
+}
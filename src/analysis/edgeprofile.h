@@ -0,0 +1,39 @@
+#ifndef EGALITO_ANALYSIS_EDGE_PROFILE_H
+#define EGALITO_ANALYSIS_EDGE_PROFILE_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Function;
+
+/** Block and branch counts gathered by EdgeProfileInstrumentPass, in the
+    text form printed by etprofile -e:
+
+        count [function] block-index block|taken module
+
+    "block" counts entries into a block; "taken" counts how often the
+    conditional jump ending a block was taken. Indices refer to the blocks
+    of the uninstrumented function. Counts are looked up by module and
+    function name; lines without a module match that name in any module.
+*/
+class EdgeProfile {
+public:
+    struct Counts {
+        std::vector<unsigned long> block;
+        std::vector<unsigned long> taken;
+    };
+private:
+    // keyed by (module name, function name); module is "" if unknown
+    std::map<std::pair<std::string, std::string>, Counts> countsMap;
+public:
+    /** Returns false if the file could not be read. */
+    bool parse(const std::string &filename);
+
+    const Counts *getCounts(Function *function) const;
+    unsigned long getBlockCount(Function *function, size_t index) const;
+    unsigned long getTakenCount(Function *function, size_t index) const;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include <capstone/capstone.h>
+#include "localliveness.h"
+#include "chunk/concrete.h"
+#include "instr/register.h"
+#include "instr/semantic.h"
+
+bool LocalLiveness::isDead(Instruction *point, int reg) {
+    return isDead(getRest(point), 0, reg);
+}
+
+bool LocalLiveness::flagsDead(Instruction *point) {
+    return flagsDead(getRest(point), 0);
+}
+
+bool LocalLiveness::isDead(const std::vector<Instruction *> &list, size_t i,
+    int reg) {
+
+#ifdef ARCH_X86_64
+    for(; i < list.size(); i ++) {
+        auto semantic = list[i]->getSemantic();
+        auto assembly = semantic->getAssembly();
+        if(!assembly || semantic->isControlFlow()) return false;
+
+        for(size_t r = 0; r < assembly->getImplicitRegsReadCount(); r ++) {
+            if(X86Register::convertToPhysical(
+                assembly->getImplicitRegsRead()[r]) == reg) return false;
+        }
+
+        // a full write of the destination, not reading it first
+        bool overwrites = false;
+        switch(assembly->getId()) {
+        case X86_INS_SYSCALL:
+        case X86_INS_SYSENTER:
+        case X86_INS_INT:
+            // arguments are passed in registers capstone does not list
+            return false;
+        case X86_INS_MOV:
+        case X86_INS_MOVABS:
+        case X86_INS_MOVZX:
+        case X86_INS_MOVSX:
+        case X86_INS_MOVSXD:
+        case X86_INS_LEA:
+        case X86_INS_POP:
+            overwrites = true;
+            break;
+        default:
+            break;
+        }
+
+        // operands are in AT&T order, the destination comes last
+        auto asmOps = assembly->getAsmOperands();
+        size_t count = asmOps->getOpCount();
+        for(size_t k = 0; k < count; k ++) {
+            auto &op = asmOps->getOperands()[k];
+            if(op.type == X86_OP_REG
+                && X86Register::convertToPhysical(op.reg) == reg) {
+
+                if(k + 1 < count || !overwrites) return false;
+            }
+            if(op.type == X86_OP_MEM
+                && (X86Register::convertToPhysical(op.mem.base) == reg
+                    || X86Register::convertToPhysical(op.mem.index) == reg)) {
+
+                return false;
+            }
+        }
+
+        if(overwrites && count > 0) {
+            auto &dest = asmOps->getOperands()[count - 1];
+            // 32-bit writes clear the upper half; narrower ones merge
+            if(dest.type == X86_OP_REG && dest.size >= 4
+                && X86Register::convertToPhysical(dest.reg) == reg) {
+
+                return true;
+            }
+        }
+    }
+#endif
+    return false;
+}
+
+bool LocalLiveness::flagsDead(const std::vector<Instruction *> &list,
+    size_t i) {
+
+#ifdef ARCH_X86_64
+    for(; i < list.size(); i ++) {
+        auto semantic = list[i]->getSemantic();
+        auto assembly = semantic->getAssembly();
+        if(!assembly || semantic->isControlFlow()) return false;
+
+        for(size_t r = 0; r < assembly->getImplicitRegsReadCount(); r ++) {
+            if(assembly->getImplicitRegsRead()[r] == X86_REG_EFLAGS) {
+                return false;
+            }
+        }
+
+        // these set every status flag without reading any
+        switch(assembly->getId()) {
+        case X86_INS_PUSHFQ:
+            return false;
+        case X86_INS_POPFQ:
+        case X86_INS_ADD:
+        case X86_INS_SUB:
+        case X86_INS_AND:
+        case X86_INS_OR:
+        case X86_INS_XOR:
+        case X86_INS_CMP:
+        case X86_INS_TEST:
+        case X86_INS_NEG:
+            return true;
+        default:
+            break;
+        }
+    }
+#endif
+    return false;
+}
+
+std::vector<Instruction *> LocalLiveness::getRest(Instruction *point) {
+    std::vector<Instruction *> list;
+    if(!point || !point->getParent()) return list;
+
+    bool found = false;
+    for(auto instr : CIter::children(static_cast<Block *>(
+        point->getParent()))) {
+
+        if(instr == point) found = true;
+        if(found) list.push_back(instr);
+    }
+    return list;
+}
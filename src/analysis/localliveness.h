@@ -0,0 +1,32 @@
+#ifndef EGALITO_ANALYSIS_LOCAL_LIVENESS_H
+#define EGALITO_ANALYSIS_LOCAL_LIVENESS_H
+
+#include <cstddef>  // for size_t
+#include <vector>
+
+class Instruction;
+
+/** Conservative liveness within one block, for code inserted by passes
+    (LiveRegister only supports AArch64). A value is dead at an
+    instruction if, scanning forward, it is fully overwritten before
+    anything reads it; reaching a control-flow instruction or the end of
+    the block counts as a read.
+
+    Registers are X86Register (physical) numbers. x86_64 only; elsewhere
+    nothing is ever dead.
+*/
+class LocalLiveness {
+public:
+    /** Liveness just before point. */
+    static bool isDead(Instruction *point, int reg);
+    static bool flagsDead(Instruction *point);
+
+    /** Liveness just before list[i], where list is the rest of a block. */
+    static bool isDead(const std::vector<Instruction *> &list, size_t i,
+        int reg);
+    static bool flagsDead(const std::vector<Instruction *> &list, size_t i);
+private:
+    static std::vector<Instruction *> getRest(Instruction *point);
+};
+
+#endif
@@ -9,43 +9,102 @@
 #include "log/temp.h"
 #include "chunk/dump.h"
 
-void ChunkCache::make(Chunk *chunk) {
+void ChunkCache::make(Chunk *chunk, const char *image) {
     //TemporaryLogLevel tll("chunk", 10);
     //TemporaryLogLevel tll2("disasm", 10);
 
     LOG(10, "fixups for ChunkCache::make " << chunk->getName());
-#ifdef ARCH_X86_64
     this->address = chunk->getAddress();
+    if(image) data.assign(image, chunk->getSize());
     InstrWriterCppString writer(data);
     for(auto b : chunk->getChildren()->genericIterable()) {
         auto block = dynamic_cast<Block *>(b);
         for(auto i : CIter::children(block)) {
             auto semantic = i->getSemantic();
-            semantic->accept(&writer);
-            if(auto link = semantic->getLink()) {
-                if(dynamic_cast<DataOffsetLink *>(link)) {
-                    auto v = dynamic_cast<LinkedInstruction *>(semantic);
-                    assert(v);
-
-                    fixups.push_back(i->getAddress() + v->getDispOffset()
-                        - chunk->getAddress());
-                    IF_LOG(10) {
-                        ChunkDumper d;
-                        i->accept(&d);
-                    }
-                }
+            if(!image) semantic->accept(&writer);
+            instructionCount ++;
+
+            auto link = semantic->getLink();
+            if(!link || !dependsOnPosition(link, chunk)) continue;
+
+            auto offset = i->getAddress() - chunk->getAddress();
+            size_t dispOffset = 0;
+            if(canPatchDisplacement(semantic, link, &dispOffset)) {
+                fixups.push_back(offset + dispOffset);
+            }
+            else {
+                rewrites.push_back(std::make_pair(offset, i));
+            }
+            IF_LOG(10) {
+                ChunkDumper d;
+                i->accept(&d);
             }
         }
     }
+}
+
+bool ChunkCache::dependsOnPosition(Link *link, Chunk *chunk) {
+    // encoded as table offsets, independent of any code address
+    if(dynamic_cast<GSTableLink *>(link)) return false;
+    if(dynamic_cast<TLSDataOffsetLink *>(link)) return false;
+
+    bool targetInside = false;
+    for(Chunk *c = link->getTarget(); c; c = c->getParent()) {
+        if(c == chunk) {
+            targetInside = true;
+            break;
+        }
+    }
+
+    if(link->isRIPRelative()) {
+        // relative links within the chunk move along with it
+        return !targetInside;
+    }
+    if(link->isAbsolute()) {
+        // absolute data addresses do not depend on code placement
+        if(!targetInside && dynamic_cast<DataOffsetLinkBase *>(link)) {
+            return false;
+        }
+        return true;
+    }
+
+    // e.g. DistanceLink; be conservative and re-encode
+    return true;
+}
+
+bool ChunkCache::canPatchDisplacement(InstructionSemantic *semantic,
+    Link *link, size_t *dispOffset) {
+
+#ifdef ARCH_X86_64
+    // data (including jump tables) stays put while code is re-emitted, so
+    // a rel32 displacement only has to absorb the change in code address
+    if(dynamic_cast<DataOffsetLink *>(link)
+        || dynamic_cast<JumpTableLink *>(link)) {
+
+        auto v = dynamic_cast<LinkedInstructionBase *>(semantic);
+        if(v && v->getDispSize() == 4) {
+            *dispOffset = v->getDispOffset();
+            return true;
+        }
+    }
 #endif
+    return false;
 }
 
 void ChunkCache::copyAndFix(char *output) {
+    copyAndFix(output, reinterpret_cast<address_t>(output));
+}
+
+void ChunkCache::copyAndFix(char *output, address_t outputAddress) {
     std::memcpy(output, data.c_str(), data.size());
     for(auto offset : fixups) {
         uint32_t *point = reinterpret_cast<uint32_t *>(output + offset);
-        int32_t delta = address - reinterpret_cast<address_t>(output);
+        int32_t delta = address - outputAddress;
         *point = *reinterpret_cast<const uint32_t *>(data.c_str() + offset)
             + delta;
     }
+    for(const auto &rewrite : rewrites) {
+        InstrWriterCString writer(output + rewrite.first);
+        rewrite.second->getSemantic()->accept(&writer);
+    }
 }
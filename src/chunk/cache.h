@@ -3,21 +3,57 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 
 #include "instr/instr.h"
 
 class Chunk;
+class Link;
+class InstructionSemantic;
 
+/** Relocatable image of a Function or PLTTrampoline.
+
+    The chunk is encoded once. Re-emitting it is then a memcpy followed by
+    fixups for only those instructions whose encoding depends on where the
+    chunk (or something outside of it) is placed. Links into data use a
+    32-bit delta patch on x86_64; every other position-dependent link
+    (control flow, PLTLink, MarkerLink, ...) is re-encoded in place, so the
+    same cache works on all architectures.
+
+    The cache refers to the chunk's Instructions, so it must be discarded
+    whenever they change; Function::setDirty() takes care of this.
+*/
 class ChunkCache {
 private:
     address_t address;
     std::string data;
-    std::vector<address_t> fixups;
+    std::vector<address_t> fixups;  // offsets of rel32 displacements
+    std::vector<std::pair<address_t, Instruction *>> rewrites;
+    size_t instructionCount;
 public:
-    ChunkCache(Chunk *chunk) { make(chunk); }
+    /** Encodes chunk, or if image is given, takes the code from there
+        instead: it must be the chunk encoded at its current address.
+    */
+    ChunkCache(Chunk *chunk, const char *image = nullptr)
+        : address(0), instructionCount(0) { make(chunk, image); }
+
+    /** Copies to output, which must be the chunk's current address. */
     void copyAndFix(char *output);
+
+    /** Copies to output, where the chunk will be executed at address.
+        The chunk itself must already be positioned at address.
+    */
+    void copyAndFix(char *output, address_t outputAddress);
+
+    size_t getSize() const { return data.size(); }
+    size_t getInstructionCount() const { return instructionCount; }
+    size_t getFixupCount() const { return fixups.size(); }
+    size_t getRewriteCount() const { return rewrites.size(); }
 private:
-    void make(Chunk *chunk);
+    void make(Chunk *chunk, const char *image);
+    bool dependsOnPosition(Link *link, Chunk *chunk);
+    bool canPatchDisplacement(InstructionSemantic *semantic, Link *link,
+        size_t *dispOffset);
 };
 
 #endif
@@ -1,5 +1,6 @@
 #include <cassert>
 #include <iomanip>
+#include <algorithm>
 #include "dataregion.h"
 #include "link.h"
 #include "position.h"
@@ -102,7 +103,7 @@ DataVariable *DataVariable::create(DataSection *section, address_t address,
     }
     //ChunkMutator(section).append(var);
     var->setParent(section);
-    section->getChildren()->add(var);
+    section->addVariable(var);
 
     assert(section->findVariable(address));
 
@@ -154,7 +155,7 @@ void DataVariable::accept(ChunkVisitor *visitor) {
 }
 
 DataSection::DataSection(ElfMap *elfMap, address_t segmentAddress,
-    ElfXX_Shdr *shdr) {
+    ElfXX_Shdr *shdr) : variablesInOrderValid(false) {
 
     name = std::string(elfMap->getSHStrtab() + shdr->sh_name);
     alignment = shdr->sh_addralign;
@@ -220,6 +221,38 @@ DataVariable *DataSection::findVariable(address_t address) {
 #endif
 }
 
+void DataSection::addVariable(DataVariable *var) {
+    getChildren()->add(var);
+    variablesInOrderValid = false;
+}
+
+void DataSection::removeVariable(DataVariable *var) {
+    getChildren()->remove(var);
+    variablesInOrderValid = false;
+}
+
+const std::vector<DataVariable *> &DataSection::getVariablesInOrder() {
+    if(!variablesInOrderValid) {
+        variablesInOrder.clear();
+        for(auto var : CIter::children(this)) {
+            variablesInOrder.push_back(var);
+        }
+
+        // usually already in order
+        auto byAddress = [] (DataVariable *a, DataVariable *b) {
+            return a->getAddress() < b->getAddress();
+        };
+        if(!std::is_sorted(variablesInOrder.begin(), variablesInOrder.end(),
+            byAddress)) {
+
+            std::sort(variablesInOrder.begin(), variablesInOrder.end(),
+                byAddress);
+        }
+        variablesInOrderValid = true;
+    }
+    return variablesInOrder;
+}
+
 void DataSection::serialize(ChunkSerializerOperations &op,
     ArchiveStreamWriter &writer) {
 
@@ -244,6 +277,7 @@ bool DataSection::deserialize(ChunkSerializerOperations &op,
     setPosition(new AbsoluteOffsetPosition(this, originalOffset));
 
     op.deserializeChildren(this, reader);
+    variablesInOrderValid = false;
     return reader.stillGood();
 }
 
@@ -120,8 +120,11 @@ private:
     uint64_t permissions;
     Type type;
     std::vector<GlobalVariable *> globalVariables;
+    std::vector<DataVariable *> variablesInOrder;  // !!! not serialized
+    bool variablesInOrderValid;
 public:
-    DataSection() : alignment(0), originalOffset(0), permissions(0), type(TYPE_UNKNOWN) {}
+    DataSection() : alignment(0), originalOffset(0), permissions(0),
+        type(TYPE_UNKNOWN), variablesInOrderValid(false) {}
     DataSection(ElfMap *elfMap, address_t segmentAddress, ElfXX_Shdr *shdr);
 
     virtual std::string getName() const;
@@ -131,6 +134,17 @@ public:
     DataVariable *findVariable(const std::string &name);
     DataVariable *findVariable(address_t address);
 
+    /** Adds or removes a variable, keeping getVariablesInOrder() current.
+        Variables should not be added to the child list directly.
+    */
+    void addVariable(DataVariable *var);
+    void removeVariable(DataVariable *var);
+
+    /** Variables sorted by address. Built on first use and rebuilt after
+        addVariable() or removeVariable().
+    */
+    const std::vector<DataVariable *> &getVariablesInOrder();
+
     size_t getAlignment() const { return alignment; }
     void setAlignment(size_t align) { alignment = align; }
     address_t getOriginalOffset() const { return originalOffset; }
@@ -18,13 +18,23 @@
 
 #include "log/temp.h"
 
-void Function::makeCache() {
-    this->cache = new ChunkCache(this);
+void Function::makeCache(const char *image) {
+    delete cache;
+    this->cache = new ChunkCache(this, image);
+}
+
+void Function::setDirty(bool dirty) {
+    this->dirty = dirty;
+    if(dirty && cache) {
+        delete cache;
+        this->cache = nullptr;
+    }
 }
 
 Function::Function(address_t originalAddress)
     : symbol(nullptr), dynamicSymbol(nullptr), nonreturn(false),
-    ifunc(false), cache(nullptr) {
+    ifunc(false), dirty(true), cold(false), cache(nullptr),
+    ownsSymbol(false) {
 
     std::ostringstream stream;
     stream << "fuzzyfunc-0x" << std::hex << originalAddress;
@@ -32,12 +42,26 @@ Function::Function(address_t originalAddress)
 }
 
 Function::Function(Symbol *symbol)
-    : symbol(symbol), dynamicSymbol(nullptr), nonreturn(false), cache(nullptr) {
+    : symbol(symbol), dynamicSymbol(nullptr), nonreturn(false), dirty(true),
+    cold(false), cache(nullptr), ownsSymbol(false) {
 
     name = symbol->getName();
     ifunc = (symbol->getType() == Symbol::TYPE_IFUNC);
 }
 
+Function::Function(const std::string &name)
+    : dynamicSymbol(nullptr), name(name), nonreturn(false), ifunc(false),
+    dirty(true), cold(false), cache(nullptr), ownsSymbol(true),
+    symbolName(name) {
+
+    this->symbol = new Symbol(0x0, 0, symbolName.c_str(),
+        Symbol::TYPE_FUNC, Symbol::BIND_LOCAL, 0, 0);
+}
+
+Function::~Function() {
+    if(ownsSymbol) delete symbol;
+}
+
 bool Function::hasName(std::string name) const {
     if(this->name == name) return true;
     if(!symbol) return false;
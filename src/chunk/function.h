@@ -18,10 +18,15 @@ private:
     std::string name;
     bool nonreturn;
     bool ifunc;
+    bool dirty;  // !!! not serialized
+    bool cold;  // !!! not serialized
     ChunkCache *cache;
+    bool ownsSymbol;
+    std::string symbolName;  // storage for an owned symbol's name
 public:
     Function() : symbol(nullptr), dynamicSymbol(nullptr), nonreturn(false),
-        ifunc(false), cache(nullptr) {}
+        ifunc(false), dirty(true), cold(false), cache(nullptr),
+        ownsSymbol(false) {}
 
     /** Create a fuzzy function named according to the original address. */
     Function(address_t originalAddress);
@@ -29,6 +34,12 @@ public:
     /** Create an authoritative function from symbol information. */
     Function(Symbol *symbol);
 
+    /** Create a function that is not in the original ELF (e.g. split off
+        another one), with a local symbol that it owns.
+    */
+    Function(const std::string &name);
+    virtual ~Function();
+
     Symbol *getSymbol() const { return symbol; }
     Symbol *getDynamicSymbol() const { return dynamicSymbol; }
     virtual void setDynamicSymbol(Symbol *ds) { dynamicSymbol = ds; }
@@ -50,8 +61,21 @@ public:
     bool isIFunc() const { return ifunc; }
     void setIsIFunc(bool yes) { ifunc = yes; }
 
-    void makeCache();
+    /** See ChunkCache; image is this function's code as just emitted. */
+    void makeCache(const char *image = nullptr);
     ChunkCache *getCache() const { return cache; }
+
+    /** Set by ChunkMutator when contents change since the last codegen.
+        Marking a function dirty discards its (now stale) ChunkCache.
+    */
+    bool isDirty() const { return dirty; }
+    void setDirty(bool dirty);
+
+    /** Cold functions (never executed according to a profile, or the cold
+        part split off a hot function) are laid out after all other code.
+    */
+    bool isCold() const { return cold; }
+    void setCold(bool cold) { this->cold = cold; }
 };
 
 class FunctionList : public ChunkSerializerImpl<TYPE_FunctionList,
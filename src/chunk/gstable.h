@@ -2,6 +2,7 @@
 #define EGALITO_CHUNK_GS_TABLE_H
 
 #include <map>
+#include <vector>
 #include "chunk.h"
 #include "chunklist.h"
 #include "types.h"
@@ -32,10 +33,12 @@ private:
     std::map<Chunk *, GSTableEntry *> entryMap;
     void *tableAddress;
     void *signalTableAddress;
+    address_t *resetImage;
+    std::vector<GSTableEntry *> movableEntries;
     size_t reserved;
 public:
     GSTable()
-        : /* escapeTarget(nullptr), */ tableAddress(nullptr), signalTableAddress(nullptr), reserved(0) {}
+        : /* escapeTarget(nullptr), */ tableAddress(nullptr), signalTableAddress(nullptr), resetImage(nullptr), reserved(0) {}
 
     // no going back
     void finishReservation();
@@ -55,6 +58,18 @@ public:
     void setSignalTableAddress(void *address) { signalTableAddress = address; }
     void *getSignalTableAddress() const { return signalTableAddress; }
 
+    /** Flat copy of the table contents right after a reset (see
+        ManageGS::buildResetImage). */
+    void setResetImage(address_t *image) { resetImage = image; }
+    address_t *getResetImage() const { return resetImage; }
+    /** Reserved entries whose target has no position of its own (e.g. a
+        jump table target inside a function), so that its address changes
+        whenever its parent is regenerated; not covered by the image. */
+    void addMovableEntry(GSTableEntry *entry)
+        { movableEntries.push_back(entry); }
+    const std::vector<GSTableEntry *> &getMovableEntries() const
+        { return movableEntries; }
+
     virtual void accept(ChunkVisitor *visitor);
 private:
     GSTableEntry *makeEntryFor(Chunk *target);
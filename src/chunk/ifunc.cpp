@@ -22,6 +22,12 @@ void IFuncList::addIFuncFor(address_t address, Chunk *target) {
     map[address] = ifuncEntry;
 }
 
+void IFuncList::addIFuncFor(address_t address, address_t resolver) {
+    auto ifuncEntry = new IFunc(new UnresolvedLink(resolver));
+    getChildren()->add(ifuncEntry);
+    map[address] = ifuncEntry;
+}
+
 auto IFuncList::getFor(address_t address) const -> IFuncType {
     auto it = map.find(address);
     if(it == map.end()) return nullptr;
@@ -13,6 +13,7 @@ private:
 public:
     IFunc(Chunk *target) : link(
         new NormalLink(target, Link::SCOPE_EXTERNAL_CODE)) {}
+    IFunc(Link *link) : link(link) {}
     address_t getAddress() const { return link->getTargetAddress(); }
     Link *getLink() const { return link; }
     void setLink(Link *link) { this->link = link; }
@@ -26,7 +27,10 @@ private:
     std::map<address_t, IFunc *> map;
 public:
     void addIFuncFor(address_t address, Chunk *target);
+    /** For a resolver at a known address, without any Chunk. */
+    void addIFuncFor(address_t address, address_t resolver);
     IFuncType getFor(address_t address) const;
+    const std::map<address_t, IFunc *> &getMap() const { return map; }
     virtual void accept(ChunkVisitor *visitor) {}
 };
 
@@ -32,6 +32,16 @@ void EgalitoTLS::setSandbox(ShufflingSandbox *sandbox) {
     SET_TO_TLS(sandbox);
 }
 
+RecyclingSandbox *EgalitoTLS::getRecyclingSandbox() {
+    RecyclingSandbox *recyclingSandbox = nullptr;
+    GET_FROM_TLS(recyclingSandbox);
+    return recyclingSandbox;
+}
+
+void EgalitoTLS::setRecyclingSandbox(RecyclingSandbox *recyclingSandbox) {
+    SET_TO_TLS(recyclingSandbox);
+}
+
 GSTable *EgalitoTLS::getGSTable() {
     GSTable *gsTable = nullptr;
     GET_FROM_TLS(gsTable);
@@ -62,6 +72,36 @@ void EgalitoTLS::setBarrier(volatile size_t *barrier) {
     SET_TO_TLS(barrier);
 }
 
+JITBackground *EgalitoTLS::getJITBackground() {
+    JITBackground *JIT_background = nullptr;
+    GET_FROM_TLS(JIT_background);
+    return JIT_background;
+}
+
+void EgalitoTLS::setJITBackground(JITBackground *JIT_background) {
+    SET_TO_TLS(JIT_background);
+}
+
+DirectCallPatcher *EgalitoTLS::getJITDirectCalls() {
+    DirectCallPatcher *JIT_directCalls = nullptr;
+    GET_FROM_TLS(JIT_directCalls);
+    return JIT_directCalls;
+}
+
+void EgalitoTLS::setJITDirectCalls(DirectCallPatcher *JIT_directCalls) {
+    SET_TO_TLS(JIT_directCalls);
+}
+
+JITStats *EgalitoTLS::getJITStats() {
+    JITStats *JIT_stats = nullptr;
+    GET_FROM_TLS(JIT_stats);
+    return JIT_stats;
+}
+
+void EgalitoTLS::setJITStats(JITStats *JIT_stats) {
+    SET_TO_TLS(JIT_stats);
+}
+
 void *EgalitoTLS::getJITAddressTable() {
     void *JIT_addressTable = nullptr;
     GET_FROM_TLS(JIT_addressTable);
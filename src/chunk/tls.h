@@ -24,6 +24,9 @@
 // operation for libegalito (e.g. __tls_get_addr)
 
 class GSTable;
+class JITBackground;
+class DirectCallPatcher;
+struct JITStats;
 
 // the list grows upward
 class EgalitoTLS {
@@ -34,25 +37,41 @@ private:
     EgalitoTLS *child;  // used only to initialize the child's TLS
     GSTable *gsTable;
     ShufflingSandbox *sandbox;
+    RecyclingSandbox *recyclingSandbox;
+    JITBackground *JIT_background;
+    DirectCallPatcher *JIT_directCalls;
+    JITStats *JIT_stats;
     void *JIT_addressTable;
     size_t JIT_temporary2;  // hard coded in assembly (-0x18)
     size_t JIT_jitting;     // hard coded in assembly (-0x10)
     size_t JIT_temporary;   // hard coded in assembly (-0x8)
 public:
     EgalitoTLS(volatile size_t *barrier, GSTable *gsTable,
-        ShufflingSandbox *sandbox, void *JIT_addressTable, size_t JIT_resetThreshold=1)
+        ShufflingSandbox *sandbox, void *JIT_addressTable, size_t JIT_resetThreshold=1,
+        RecyclingSandbox *recyclingSandbox=nullptr, JITStats *JIT_stats=nullptr,
+        DirectCallPatcher *JIT_directCalls=nullptr)
         :  JIT_resetThreshold(JIT_resetThreshold), JIT_resetCounter(0),
         barrier(barrier), child(nullptr), gsTable(gsTable), sandbox(sandbox),
+        recyclingSandbox(recyclingSandbox), JIT_background(nullptr),
+        JIT_directCalls(JIT_directCalls), JIT_stats(JIT_stats),
         JIT_addressTable(JIT_addressTable), JIT_jitting(0) {}
 
     static ShufflingSandbox *getSandbox();
     static void setSandbox(ShufflingSandbox *sandbox);
+    static RecyclingSandbox *getRecyclingSandbox();
+    static void setRecyclingSandbox(RecyclingSandbox *recyclingSandbox);
     static GSTable *getGSTable();
     static void setGSTable(GSTable *gsTable);
     static EgalitoTLS *getChild();
     static void setChild(EgalitoTLS *child);
     static volatile size_t *getBarrier();
     static void setBarrier(volatile size_t *barrier);
+    static JITBackground *getJITBackground();
+    static void setJITBackground(JITBackground *JIT_background);
+    static DirectCallPatcher *getJITDirectCalls();
+    static void setJITDirectCalls(DirectCallPatcher *JIT_directCalls);
+    static JITStats *getJITStats();
+    static void setJITStats(JITStats *JIT_stats);
     static void *getJITAddressTable();
     static void setJITAddressTable(void *JIT_addressTable);
     static size_t getJITResetThreshold();
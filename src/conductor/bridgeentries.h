@@ -10,6 +10,9 @@ class ConductorSetup;
 class Conductor;
 class Chunk;
 class IFuncList;
+class Sandbox;
+struct JITStatsSegment;
+struct SampleBuffer;
 #endif
 
 EGALITO_BRIDGE_ENTRY(address_t, egalito_entry)
@@ -21,6 +24,16 @@ EGALITO_BRIDGE_ENTRY(Conductor *, egalito_conductor)
 EGALITO_BRIDGE_ENTRY(Chunk *, egalito_gsCallback)
 EGALITO_BRIDGE_ENTRY(IFuncList *, egalito_ifuncList)
 EGALITO_BRIDGE_ENTRY(bool, egalito_init_done)
+EGALITO_BRIDGE_ENTRY(const char *, egalito_tls_image)
+EGALITO_BRIDGE_ENTRY(size_t, egalito_tls_image_size)
+EGALITO_BRIDGE_ENTRY(size_t, egalito_tls_image_offset)
+EGALITO_BRIDGE_ENTRY(bool, egalito_jit_measure_reset)
+EGALITO_BRIDGE_ENTRY(bool, egalito_jit_background)
+EGALITO_BRIDGE_ENTRY(Sandbox *, egalito_jit_shared_sandbox)
+EGALITO_BRIDGE_ENTRY(int, egalito_jit_record_fd)
+EGALITO_BRIDGE_ENTRY(size_t, egalito_jit_direct_calls)
+EGALITO_BRIDGE_ENTRY(JITStatsSegment *, egalito_jit_stats)
+EGALITO_BRIDGE_ENTRY(SampleBuffer *, egalito_sample_buffer)
 EGALITO_BRIDGE_ENTRY(address_t, egalito_hook_function_entry_hook)
 EGALITO_BRIDGE_ENTRY(address_t, egalito_hook_function_exit_hook)
 EGALITO_BRIDGE_ENTRY(address_t, egalito_hook_instruction_hook)
@@ -1,4 +1,7 @@
 #include <cassert>
+#include <vector>
+#include <elf.h>  // for SHN_UNDEF
+#include <cstdlib>  // for getenv
 #include "config.h"
 #include "conductor.h"
 #include "parseoverride.h"
@@ -6,6 +9,9 @@
 #include "chunk/ifunc.h"
 #include "chunk/tls.h"
 #include "elf/elfmap.h"
+#include "elf/elfspace.h"
+#include "elf/symbol.h"
+#include "elf/reloc.h"
 #include "elf/elfdynamic.h"
 #include "generate/debugelf.h"
 #include "operation/find2.h"
@@ -35,7 +41,8 @@
 
 IFuncList *egalito_ifuncList __attribute__((weak));
 
-Conductor::Conductor() : mainThreadPointer(0), ifuncList(nullptr) {
+Conductor::Conductor() : mainThreadPointer(0), TLSOffsetFromTCB(0),
+    TLSAreaBase(0), TLSAreaSize(0), ifuncList(nullptr) {
     program = new Program();
     program->setLibraryList(new LibraryList());
 
@@ -121,18 +128,88 @@ Module *Conductor::parseExtraLibrary(ElfMap *elf, const std::string &name) {
     return module;
 }
 
+void Conductor::parseLibrariesLazily() {
+    // ElfSpaces of libraries that have only their symbol and relocation
+    // tables built so far, in LibraryList order so the result is the same
+    // on every run
+    std::vector<std::pair<Library *, ElfSpace *>> pending;
+    // fully parsed modules whose imports have not been looked at yet
+    std::vector<ElfSpace *> worklist;
+    for(auto module : CIter::modules(program)) {
+        if(module->getElfSpace()) worklist.push_back(module->getElfSpace());
+    }
+
+    auto iterable = getLibraryList()->getChildren()->getIterable();
+    size_t discovered = 0;
+    for(;;) {
+        // the list grows as ElfDynamic finds more dependencies
+        for(; discovered < iterable->getCount(); discovered ++) {
+            auto library = iterable->get(discovered);
+            if(library->getModule()) continue;
+
+            auto space = parseTables(
+                new ElfMap(library->getResolvedPathCStr()), library);
+            if(library->getRole() == Library::ROLE_LIBC
+                || library->getRole() == Library::ROLE_LIBCPP) {
+
+                parseModule(space, library);
+                worklist.push_back(space);
+            }
+            else {
+                pending.emplace_back(library, space);
+            }
+        }
+        if(worklist.empty()) break;
+
+        auto space = worklist.back();
+        worklist.pop_back();
+        for(auto reloc : *space->getRelocList()) {
+            auto symbol = reloc->getSymbol();
+            if(!symbol || symbol->getSectionIndex() != SHN_UNDEF) continue;
+
+            std::string name = symbol->getName();
+            name = name.substr(0, name.find('@'));
+            for(auto it = pending.begin(); it != pending.end(); ) {
+                auto provider = it->second->getDynamicSymbolList();
+                auto found = provider ? provider->find(name.c_str()) : nullptr;
+                if(found && found->getSectionIndex() != SHN_UNDEF) {
+                    LOG(1, "library [" << it->first->getName()
+                        << "] is needed for " << name);
+                    parseModule(it->second, it->first);
+                    worklist.push_back(it->second);
+                    it = pending.erase(it);
+                }
+                else ++it;
+            }
+        }
+    }
+
+    for(auto &unused : pending) {
+        LOG(0, "not loading unreferenced library ["
+            << unused.first->getName() << "]");
+        delete unused.second;  // also deletes the ElfMap
+    }
+}
+
 Module *Conductor::parse(ElfMap *elf, Library *library) {
+    return parseModule(parseTables(elf, library), library);
+}
+
+ElfSpace *Conductor::parseTables(ElfMap *elf, Library *library) {
     program->add(library);  // add current lib before its dependencies
 
     ElfSpace *space = new ElfSpace(elf, library->getName(),
         library->getResolvedPath());
 
-    ParseOverride::getInstance()->setCurrentModule("module-" + library->getName());
-
     LOG(1, "\n=== BUILDING ELF DATA STRUCTURES for ["
         << space->getName() << "] ===");
     space->findSymbolsAndRelocs();
     ElfDynamic(getLibraryList()).parse(elf, library);
+    return space;
+}
+
+Module *Conductor::parseModule(ElfSpace *space, Library *library) {
+    ParseOverride::getInstance()->setCurrentModule("module-" + library->getName());
 
     LOG(1, "--- RUNNING DEFAULT ELF PASSES for ["
         << space->getName() << "] ---");
@@ -262,7 +339,11 @@ void Conductor::fixDataSections(bool allocateTLS) {
         loadTLSData();
     }
 
+    // EGALITO_RELOCATE_THREADS=N fixes modules on N threads (0 = per core)
     FixDataRegionsPass fixDataRegions;
+    if(const char *threads = getenv("EGALITO_RELOCATE_THREADS")) {
+        fixDataRegions.setThreadCount(std::strtoul(threads, nullptr, 0));
+    }
     program->accept(&fixDataRegions);
 
     // NOTE: this overwrites DataVariables, which are stored as
@@ -298,7 +379,9 @@ void Conductor::allocateTLSArea(address_t base) {
 
     // allocate headers
     address_t offset = 0;
-    mainThreadPointer = dataLoader.allocateTLS(base, size, &offset);
+    mainThreadPointer = dataLoader.allocateTLS(base, size, &offset,
+        &TLSAreaSize);
+    this->TLSAreaBase = base;
     LOG(1, "mainThreadPointer is at " << std::hex << mainThreadPointer);
     this->TLSOffsetFromTCB = (base + offset) - mainThreadPointer;
 
@@ -12,6 +12,7 @@ class ElfMap;
 class Module;
 class ChunkVisitor;
 class IFuncList;
+class ElfSpace;
 struct EgalitoTLS;
 
 class Conductor {
@@ -19,6 +20,8 @@ private:
     Program *program;
     address_t mainThreadPointer;
     size_t TLSOffsetFromTCB;
+    address_t TLSAreaBase;
+    size_t TLSAreaSize;
     IFuncList *ifuncList;
 
     std::set<Module *> resolveFinished;
@@ -33,6 +36,9 @@ public:
     void parseEgalitoElfSpaceOnly(ElfMap *elf, Module *module,
         const std::string &fullPath);
     void parseLibraries();
+    /** Like parseLibraries(), but a library is only disassembled if an
+        already parsed module imports one of its symbols. */
+    void parseLibrariesLazily();
     Module *parseAddOnLibrary(ElfMap *elf);
     Module *parseExtraLibrary(ElfMap *elf, const std::string &name = "");
     void parseEgalitoArchive(const char *archive);
@@ -55,6 +61,9 @@ public:
     ElfSpace *getMainSpace() const;
 
     address_t getMainThreadPointer() const { return mainThreadPointer; }
+    size_t getTLSOffsetFromTCB() const { return TLSOffsetFromTCB; }
+    address_t getTLSAreaBase() const { return TLSAreaBase; }
+    size_t getTLSAreaSize() const { return TLSAreaSize; }
     IFuncList *getIFuncList() const { return ifuncList; }
 
     void loadTLSDataFor(address_t tcb);
@@ -62,6 +71,8 @@ public:
     void check();
 private:
     Module *parse(ElfMap *elf, Library *library);
+    ElfSpace *parseTables(ElfMap *elf, Library *library);
+    Module *parseModule(ElfSpace *space, Library *library);
     void allocateTLSArea(address_t base);
     void loadTLSData();
     void backupTLSData();
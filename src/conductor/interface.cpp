@@ -2,7 +2,9 @@
 
 #include "pass/fixenviron.h"
 #include "pass/collapseplt.h"
+#include "pass/collapsegot.h"
 #include "pass/promotejumps.h"
+#include "pass/relaxbranches.h"
 #include "pass/ldsorefs.h"
 #include "pass/externalsymbollinks.h"
 #include "pass/ifuncplts.h"
@@ -57,8 +59,17 @@ void EgalitoInterface::prepareForGeneration(bool isUnion) {
     CollapsePLTPass collapsePLT(setup.getConductor());
     getProgram()->accept(&collapsePLT);
 
+    if(isUnion) {
+        // every module ends up in one image, so .got targets are in reach
+        CollapseGOTPass collapseGOT;
+        getProgram()->accept(&collapseGOT);
+    }
+
     PromoteJumpsPass promoteJumps;
     getProgram()->accept(&promoteJumps);
+
+    RelaxBranchesPass relaxBranches;
+    getProgram()->accept(&relaxBranches);
 }
 
 void EgalitoInterface::generate(const std::string &outputName) {
@@ -98,21 +109,38 @@ void EgalitoInterface::generate(const std::string &outputName, bool isUnion) {
 void EgalitoInterface::generate(const std::string &outputName,
     const std::vector<Function *> &order) {
 
+    generate(outputName, order, false);
+}
+
+void EgalitoInterface::generate(const std::string &outputName,
+    const std::vector<Function *> &order, bool isUnion) {
+
     auto program = getProgram();
-    prepareForGeneration(false);
+    prepareForGeneration(isUnion);
+    if(!isUnion) {
+        // generate mirror executable.
+        LOG(0, "Generating 1-1 executable [" << outputName << "]...");
+        LdsoRefsPass ldsoRefs;
+        program->accept(&ldsoRefs);
 
-    // generate mirror executable.
-    LOG(0, "Generating 1-1 executable [" << outputName << "]...");
-    LdsoRefsPass ldsoRefs;
-    program->accept(&ldsoRefs);
+        ExternalSymbolLinksPass externalSymbolLinks;
+        program->accept(&externalSymbolLinks);
 
-    ExternalSymbolLinksPass externalSymbolLinks;
-    program->accept(&externalSymbolLinks);
+        IFuncPLTs ifuncPLTs;
+        program->accept(&ifuncPLTs);
 
-    IFuncPLTs ifuncPLTs;
-    program->accept(&ifuncPLTs);
+        setup.generateMirrorELF(outputName.c_str(), order);
+    }
+    else {
+        // generate static executable.
+        LOG(0, "Generating union executable [" << outputName << "]...");
+        LdsoRefsPass ldsoRefs;
+        program->accept(&ldsoRefs);
+        IFuncPLTs ifuncPLTs;
+        program->accept(&ifuncPLTs);
 
-    setup.generateMirrorELF(outputName.c_str(), order);
+        setup.generateStaticExecutable(outputName.c_str(), order);
+    }
 }
 
 void EgalitoInterface::assignNewFunctionAddresses() {
@@ -76,6 +76,12 @@ public:
     void generate(const std::string &outputName,
         const std::vector<Function *> &order);
 
+    /** Generates an output ELF laying out functions in the given order,
+        which may mix functions of all Modules when isUnion is true.
+    */
+    void generate(const std::string &outputName,
+        const std::vector<Function *> &order, bool isUnion);
+
     /** Generates an output ELF into outputName. If isUnion is true, use
         uniongen, otherwise mirrorgen.
     */
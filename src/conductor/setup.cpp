@@ -1,6 +1,7 @@
 #include <cassert>
 #include <cstring>
 #include <climits>  // for PATH_MAX
+#include <cstdlib>  // for getenv
 #include <unistd.h>  // for readlink
 #include "config.h"
 #include "setup.h"
@@ -26,6 +27,13 @@ address_t runEgalito(ElfMap *elf, ElfMap *egalito);
 ConductorSetup *egalito_conductor_setup __attribute__((weak));
 Conductor *egalito_conductor __attribute__((weak));
 
+// EGALITO_GENERATE_THREADS=N emits code on N threads (0 = one per core)
+static void setGeneratorThreads(Generator &generator) {
+    if(const char *threads = getenv("EGALITO_GENERATE_THREADS")) {
+        generator.setThreadCount(std::strtoul(threads, nullptr, 0));
+    }
+}
+
 void ConductorSetup::parseEgalito(bool fromArchive) {
 #ifdef EGALITO_PATH
     const char *path = EGALITO_PATH;
@@ -94,7 +102,13 @@ Module *ConductorSetup::injectElfFiles(const char *executable, Library::Role rol
     }
 
     if(withSharedLibs) {
-        conductor->parseLibraries();
+        // EGALITO_LAZY_LIBRARIES=1 skips libraries nothing links against
+        if(isFeatureEnabled("EGALITO_LAZY_LIBRARIES")) {
+            conductor->parseLibrariesLazily();
+        }
+        else {
+            conductor->parseLibraries();
+        }
     }
 
     if(true || withSharedLibs) {
@@ -250,13 +264,37 @@ Sandbox *ConductorSetup::makeLoaderSandbox() {
     auto sandbox = new SandboxImpl<MemoryBacking,
         WatermarkAllocator<MemoryBacking>>(backing);
 #else
-    auto sandbox = new SandboxImpl<MemoryBacking,
-        AlignedWatermarkAllocator<MemoryBacking>>(backing);
+    auto sandbox = new LoaderSandbox(backing);
 #endif
     //this->sandbox = sandbox;
     return sandbox;
 }
 
+Sandbox *ConductorSetup::makeHugePageLoaderSandbox(int numaNode) {
+    // huge pages are a scarce, reserved resource, so only take as many as
+    // the code needs: allow for functions that are moved again later (by
+    // moveCodeIncremental()) and for padding at huge page boundaries
+    size_t codeSize = 0;
+    for(auto module : CIter::modules(conductor->getProgram())) {
+        for(auto function : CIter::functions(module)) {
+            codeSize += function->getSize();
+        }
+        if(module->getPLTList()) {
+            for(auto plt : CIter::plts(module)) {
+                codeSize += plt->getSize();
+            }
+        }
+    }
+    size_t size = 2 * codeSize + HUGE_PAGE_SIZE;
+    LOG(1, "reserving 0x" << std::hex << size
+        << " bytes of huge pages for 0x" << codeSize << " bytes of code");
+
+    auto backing = HugePageMemoryBacking(sandboxBase, size, numaNode);
+    sandboxBase += backing.getSize();
+    return new SandboxImpl<MemoryBacking,
+        HugePageAllocator<MemoryBacking>>(backing);
+}
+
 ShufflingSandbox *ConductorSetup::makeShufflingSandbox() {
     auto backing = MemoryBacking(sandboxBase, 1 * 0x1000 * 0x1000);
     sandboxBase += 2 * 0x1000 * 0x1000;
@@ -271,6 +309,20 @@ ShufflingSandbox *ConductorSetup::makeShufflingSandbox() {
         WatermarkAllocator<MemoryBacking>>>(sandbox1, sandbox2);
 }
 
+RecyclingSandbox *ConductorSetup::makeRecyclingSandbox() {
+    // same address space as the two halves of a ShufflingSandbox, but only
+    // the pages below the allocator's watermark are ever touched
+    auto backing = MemoryBacking(sandboxBase, 2 * 0x1000 * 0x1000);
+    sandboxBase += 4 * 0x1000 * 0x1000;
+    return new RecyclingSandbox(backing);
+}
+
+SharedSandbox *ConductorSetup::makeSharedSandbox() {
+    auto backing = DualMappedMemoryBacking(sandboxBase, 2 * 0x1000 * 0x1000);
+    sandboxBase += 4 * 0x1000 * 0x1000;
+    return new SharedSandbox(backing);
+}
+
 Sandbox *ConductorSetup::makeFileSandbox(const char *outputFile) {
     auto backing = MemoryBacking(SANDBOX_BASE_ADDRESS, MAX_SANDBOX_SIZE);
     return new SandboxImpl<MemoryBacking,
@@ -316,6 +368,34 @@ bool ConductorSetup::generateStaticExecutable(const char *outputFile) {
     return true;
 }
 
+bool ConductorSetup::generateStaticExecutable(const char *outputFile,
+    const std::vector<Function *> &order) {
+
+    auto sandbox = makeStaticExecutableSandbox(outputFile);
+    auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
+    auto program = conductor->getProgram();
+
+    auto generator = UnionGen(program, backing);
+    generator.preCodeGeneration();
+
+    {
+        Generator(sandbox, true).assignAddresses(conductor->getProgram(), order);
+        generator.afterAddressAssign();
+        {
+            // get data sections; allow links to change bytes in data sections
+            SegMap::mapAllSegments(this);
+            ConductorPasses(conductor).newExecutablePasses(program);
+        }
+        Generator codeGenerator(sandbox, true);
+        setGeneratorThreads(codeGenerator);
+        codeGenerator.generateCode(conductor->getProgram(), order);
+        moveCodeMakeExecutable(sandbox);
+    }
+
+    generator.generateContent(outputFile);
+    return true;
+}
+
 bool ConductorSetup::generateMirrorELF(const char *outputFile) {
     auto sandbox = makeStaticExecutableSandbox(outputFile);
     auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
@@ -363,7 +443,9 @@ bool ConductorSetup::generateMirrorELF(const char *outputFile,
             ConductorPasses(conductor).newMirrorPasses(program);
         }
         //copyCodeToNewAddresses(sandbox, true);
-        Generator(sandbox, true).generateCode(conductor->getProgram(), order);
+        Generator codeGenerator(sandbox, true);
+        setGeneratorThreads(codeGenerator);
+        codeGenerator.generateCode(conductor->getProgram(), order);
         moveCodeMakeExecutable(sandbox);
     }
 
@@ -408,12 +490,24 @@ void ConductorSetup::moveCode(Sandbox *sandbox, bool useDisps) {
     moveCodeMakeExecutable(sandbox);
 }
 
+void ConductorSetup::moveCodeIncremental(Sandbox *sandbox, bool useDisps) {
+    // only functions changed since the last moveCode() are re-emitted;
+    // the others keep their slots and get references to moved code patched
+    sandbox->reopen();
+    Generator generator(sandbox, useDisps);
+    auto moved = generator.reassignAddresses(conductor->getProgram());
+    generator.regenerateCode(conductor->getProgram(), moved);
+    moveCodeMakeExecutable(sandbox);
+}
+
 void ConductorSetup::moveCodeAssignAddresses(Sandbox *sandbox, bool useDisps) {
     Generator(sandbox, useDisps).assignAddresses(conductor->getProgram());
 }
 
 void ConductorSetup::copyCodeToNewAddresses(Sandbox *sandbox, bool useDisps) {
-    Generator(sandbox, useDisps).generateCode(conductor->getProgram());
+    Generator generator(sandbox, useDisps);
+    setGeneratorThreads(generator);
+    generator.generateCode(conductor->getProgram());
 }
 
 void ConductorSetup::moveCodeMakeExecutable(Sandbox *sandbox) {
@@ -21,6 +21,8 @@ class Symbol;
             moveCodeAssignAddresses(),
             copyCodeToNewAddresses(),
             moveCodeMakeExecutable()
+        and then, after further passes, optionally moveCodeIncremental()
+        with the same sandbox.
 */
 class ConductorSetup {
 private:
@@ -44,16 +46,22 @@ public:
     void ensureBaseAddresses();
     void createNewProgram();  // optional
     Sandbox *makeLoaderSandbox();
+    Sandbox *makeHugePageLoaderSandbox(int numaNode = -1);
     ShufflingSandbox *makeShufflingSandbox();
+    RecyclingSandbox *makeRecyclingSandbox();
+    SharedSandbox *makeSharedSandbox();
     Sandbox *makeFileSandbox(const char *outputFile);
     Sandbox *makeStaticExecutableSandbox(const char *outputFile);
     Sandbox *makeKernelSandbox(const char *outputFile);
     bool generateStaticExecutable(const char *outputFile);
+    bool generateStaticExecutable(const char *outputFile,
+        const std::vector<Function *> &order);
     bool generateMirrorELF(const char *outputFile);
     bool generateMirrorELF(const char *outputFile,
         const std::vector<Function *> &order);
     bool generateKernel(const char *outputFile);
     void moveCode(Sandbox *sandbox, bool useDisps = true);
+    void moveCodeIncremental(Sandbox *sandbox, bool useDisps = true);
 public:
     void moveCodeAssignAddresses(Sandbox *sandbox, bool useDisps);
     void copyCodeToNewAddresses(Sandbox *sandbox, bool useDisps);
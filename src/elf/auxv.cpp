@@ -6,7 +6,7 @@
 #include "elfxx.h"
 #include "log/log.h"
 
-static address_t *findAuxiliaryVector(char **argv) {
+address_t *findAuxiliaryVector(char **argv) {
     address_t *address = reinterpret_cast<address_t *>(argv);
 
     //address ++;  // skip argc
@@ -4,6 +4,7 @@
 #include "types.h"
 #include "elf/elfmap.h"
 
+address_t *findAuxiliaryVector(char **argv);
 void adjustAuxiliaryVector(char **argv, ElfMap *elf, ElfMap *interpreter);
 int removeLoaderFromArgv(void *argv);
 
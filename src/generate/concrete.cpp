@@ -541,9 +541,22 @@ void TextSectionCreator::execute() {
     DeferredString *textValue = nullptr;
     // Don't modify backing after this point to avoid invalidating c_str
     auto copy = new std::string(getData()->getBacking()->getBuffer());
+
+    // the Generator places all cold functions at the end
+    size_t hotSize = copy->length();
+    if(!getConfig()->isFreestandingKernel()) {
+        for(auto module : CIter::modules(getData()->getProgram())) {
+            for(auto func : CIter::functions(module)) {
+                if(!func->isCold()) continue;
+                if(func->getAddress() < address) continue;
+                hotSize = std::min(hotSize,
+                    static_cast<size_t>(func->getAddress() - address));
+            }
+        }
+    }
+
     textValue = new DeferredString(
-        reinterpret_cast<const char *>(copy->c_str()),
-        copy->length());
+        reinterpret_cast<const char *>(copy->c_str()), hotSize);
 
     if(getConfig()->isFreestandingKernel()) {
         textSection->getHeader()->setAddress(LINUX_KERNEL_CODE_BASE);
@@ -557,6 +570,20 @@ void TextSectionCreator::execute() {
 
     auto loadSegment = new SegmentInfo(PT_LOAD, PF_R | PF_X, 0x1000);
     loadSegment->addContains(textSection);
+
+    if(hotSize < copy->length()) {
+        LOG(1, "cold code at " << std::hex << (address + hotSize)
+            << " size " << (copy->length() - hotSize));
+        auto coldSection = new Section(".text.cold", SHT_PROGBITS,
+            SHF_ALLOC | SHF_EXECINSTR);
+        coldSection->getHeader()->setAddress(address + hotSize);
+        coldSection->setContent(new DeferredString(
+            reinterpret_cast<const char *>(copy->c_str()) + hotSize,
+            copy->length() - hotSize));
+        getSectionList()->addSection(coldSection);
+        loadSegment->addContains(coldSection);
+    }
+
     phdrTable->add(loadSegment);
 }
 
@@ -397,7 +397,7 @@ void ModuleGen::makeTextAccumulative() {
     auto address = backing->getBase();
     auto size = backing->getSize();
     makeRelocSectionFor(".text");
-    makeSymbolsAndRelocs(address, size, ".text");
+    makeSymbolsAndRelocs(address, size, ".text", ".text.cold");
 }
 
 void ModuleGen::makeRelocSectionFor(const std::string &otherName) {
@@ -412,7 +412,7 @@ void ModuleGen::makeRelocSectionFor(const std::string &otherName) {
 }
 
 void ModuleGen::makeSymbolsAndRelocs(address_t begin, size_t size,
-    const std::string &textSection) {
+    const std::string &textSection, const std::string &coldSection) {
 
     // Add symbols to the symbol list, but only for those functions
     // which fall into the given range [begin, begin+size).
@@ -434,7 +434,8 @@ void ModuleGen::makeSymbolsAndRelocs(address_t begin, size_t size,
         }
 
         LOG(1, "making symbol for " << func->getName());
-        makeSymbolInText(func, textSection);
+        makeSymbolInText(func, func->isCold() && !coldSection.empty()
+            ? coldSection : textSection);
 #if 0
         makeRelocInText(func, textSection);
 #endif
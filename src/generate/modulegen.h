@@ -61,8 +61,9 @@ public:
     void makeTextAccumulative();
     void makeRelocSectionFor(const std::string &otherName);
     void maybeMakeDataRelocs(DataSection *section, Section *sec);
+    /** Symbols of cold functions go in coldSection, if one is given. */
     void makeSymbolsAndRelocs(address_t begin, size_t size,
-        const std::string &textSection);
+        const std::string &textSection, const std::string &coldSection = "");
     void makeSymbolInText(Function *func, const std::string &textSection);
     void makeRelocInText(Function *func, const std::string &textSection);
 
@@ -8,6 +8,7 @@
 #include "semantic.h"
 #include "writer.h"
 #include "disasm/disassemble.h"
+#include "operation/mutator.h"
 #include "log/log.h"
 
 #include "isolated.h"  // for debugging
@@ -23,6 +24,11 @@ std::string Instruction::getName() const {
     return stream.str();
 }
 
+void Instruction::setSemantic(InstructionSemantic *semantic) {
+    this->semantic = semantic;
+    ChunkMutator(this, false).markFunctionDirty();
+}
+
 size_t Instruction::getSize() const {
     return semantic->getSize();
 }
@@ -20,8 +20,9 @@ public:
     virtual std::string getName() const;
 
     InstructionSemantic *getSemantic() const { return semantic; }
-    void setSemantic(InstructionSemantic *semantic)
-        { this->semantic = semantic; }
+
+    /** Also marks the enclosing Function dirty, since its code changed. */
+    void setSemantic(InstructionSemantic *semantic);
 
     virtual size_t getSize() const;
 
@@ -18,6 +18,7 @@
 #include "elf/elfspace.h"
 #include "operation/find.h"
 #include "operation/find2.h"
+#include "operation/mutator.h"
 #include "util/streamasstring.h"
 
 #include "log/log.h"
@@ -33,6 +34,11 @@ void LinkedInstruction::setAssembly(AssemblyPtr assembly) {
     LinkDecorator<SemanticImpl>::setAssembly(assembly);
 }
 
+void LinkedInstruction::setLink(Link *link) {
+    LinkDecorator<SemanticImpl>::setLink(link);
+    if(instruction) ChunkMutator(instruction, false).markFunctionDirty();
+}
+
 const LinkedInstruction::AARCH64_modeInfo_t LinkedInstruction::AARCH64_ImInfo[AARCH64_IM_MAX] = {
 
       /* ADRP */
@@ -57,6 +57,8 @@ public:
     virtual ~LinkedInstruction() {}
 
     virtual void setAssembly(AssemblyPtr assembly);
+    /** Replaces the link and marks the enclosing Function dirty. */
+    virtual void setLink(Link *link);
 
     void writeTo(char *target, bool useDisp);
     void writeTo(std::string &target, bool useDisp);
@@ -10,6 +10,7 @@
 #include "analysis/liveregister.h"
 #include "analysis/pointerdetection.h"
 #include "analysis/walker.h"
+#include "operation/mutator.h"
 
 #include "log/log.h"
 
@@ -19,6 +20,11 @@ void LinkedInstruction::regenerateAssembly() {
     LOG(10, "assembly regeneration NYI for RISC-V");
 }
 
+void LinkedInstruction::setLink(Link *link) {
+    LinkDecorator<SemanticImpl>::setLink(link);
+    if(instruction) ChunkMutator(instruction, false).markFunctionDirty();
+}
+
 void LinkedInstruction::writeTo(char *target, bool useDisp) {
     if(getSize() == 2) {
         *reinterpret_cast<uint16_t *>(target) = rebuild();
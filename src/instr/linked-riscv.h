@@ -25,6 +25,9 @@ public:
 
     void regenerateAssembly();
 
+    /** Replaces the link and marks the enclosing Function dirty. */
+    virtual void setLink(Link *link);
+
     void setInstruction(Instruction *instruction)
         { this->instruction = instruction; }
 
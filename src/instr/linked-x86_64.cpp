@@ -7,6 +7,7 @@
 #include "disasm/disassemble.h"
 #include "disasm/makesemantic.h"  // for determineDisplacementSize
 #include "operation/find.h"
+#include "operation/mutator.h"
 #include "log/log.h"
 #include "log/temp.h"
 #include "chunk/dump.h"
@@ -77,6 +78,11 @@ void LinkedInstructionBase::regenerateAssembly() {
         getStorage(), instruction->getAddress()));
 }
 
+void LinkedInstructionBase::setLink(Link *link) {
+    LinkDecorator<SemanticImpl>::setLink(link);
+    if(instruction) ChunkMutator(instruction, false).markFunctionDirty();
+}
+
 static PLTTrampoline *findPLTTrampoline(Module *module, address_t target) {
     auto pltList = module->getPLTList();
     if(!pltList) return nullptr;
@@ -216,6 +222,11 @@ LinkedInstructionBase *LinkedInstruction::makeLinked(Module *module,
     return linked;
 }
 
+void ControlFlowInstructionBase::setLink(Link *link) {
+    LinkDecorator<InstructionSemantic>::setLink(link);
+    if(source) ChunkMutator(source, false).markFunctionDirty();
+}
+
 void ControlFlowInstructionBase::setSize(size_t value) {
     diff_t disp = value - opcode.size();
     assert(disp >= 0);
@@ -33,6 +33,9 @@ public:
 
     void regenerateAssembly();
 
+    /** Replaces the link and marks the enclosing Function dirty. */
+    virtual void setLink(Link *link);
+
     void setIndex(int index) { opIndex = index; makeDisplacementInfo(); }
     void setIndex(int index, size_t dispSize, size_t dispOffset)
         { opIndex = index; displacementSize = dispSize; displacementOffset = dispOffset; }
@@ -86,6 +89,9 @@ public:
     void writeTo(std::string &target, bool useDisp);
     size_t getDispOffset() const { return opcode.size(); }
 
+    /** Replaces the link and marks the enclosing Function dirty. */
+    virtual void setLink(Link *link);
+
     virtual AssemblyPtr getAssembly() { return AssemblyPtr(); }
     virtual void setAssembly(AssemblyPtr assembly)
         { throw "Can't call setAssembly() on ControlFlowInstructionBase"; }
@@ -98,7 +104,8 @@ public:
     bool returns() const { return !nonreturn; }
     void setNonreturn() { nonreturn = true; }
 
-    // the following should only be called by PromoteJumpsPass
+    // the following should only be called by PromoteJumpsPass and
+    // RelaxBranchesPass
     int getId() const { return id; }
     void setDisplacementSize(int ds) { displacementSize = ds; }
     void setOpcode(const std::string &string) { opcode = string; }
@@ -34,6 +34,7 @@ AssemblyFactory AssemblyFactory::instance;
 AssemblyPtr AssemblyFactory::buildAssembly(InstructionStorage *storage,
     address_t address) {
 
+    std::lock_guard<std::mutex> lock(mutex);
     static DisasmHandle handle(true);
     auto assembly = DisassembleInstruction(handle, true)
         .allocateAssembly(storage->getData(), address);
@@ -43,9 +44,11 @@ AssemblyPtr AssemblyFactory::buildAssembly(InstructionStorage *storage,
 }
 
 void AssemblyFactory::registerAssembly(AssemblyPtr assembly) {
+    std::lock_guard<std::mutex> lock(mutex);
     assemblyList.push_back(assembly);
 }
 
 void AssemblyFactory::clearCache() {
+    std::lock_guard<std::mutex> lock(mutex);
     assemblyList.clear();
 }
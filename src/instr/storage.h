@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <mutex>
 #include "assembly.h"
 
 class InstructionStorage {
@@ -20,6 +21,9 @@ public:
     void clearAssembly() { assembly.reset(); }
 };
 
+/** Builds and keeps alive the Assembly objects of all instructions. Calls
+    may come from code generation worker threads, so they are serialized.
+*/
 class AssemblyFactory {
 private:
     static AssemblyFactory instance;
@@ -27,6 +31,7 @@ public:
     static AssemblyFactory *getInstance() { return &instance; }
 private:
     std::vector<AssemblyPtr> assemblyList;
+    std::mutex mutex;
 public:
     AssemblyPtr buildAssembly(InstructionStorage *storage, address_t address);
     void registerAssembly(AssemblyPtr assembly);
@@ -69,6 +69,7 @@ void CallInit::makeInitArray(Program *program, int argc, char **argv,
             if(met.find(library) != met.end()) continue;
             bool allmet = true;
             for(auto dep : library->getDependencies()) {
+                if(!dep->getModule()) continue;  // skipped as unused
                 if(met.find(dep) == met.end()) {
                     allmet = false;
                     break;
@@ -169,3 +170,23 @@ auto CallInit::getStart2(Conductor *conductor) -> Start2Type {
     return reinterpret_cast<Start2Type>(addr);
 }
 
+
+std::vector<address_t> CallInit::getInitFunctions() {
+    size_t init_index = (size_t)egalito_init_array[0];
+    return std::vector<address_t>(
+        egalito_init_array + 4, egalito_init_array + init_index);
+}
+
+void CallInit::setInitFunctions(const std::vector<address_t> &functions,
+    int argc, char **argv, char **envp) {
+
+    assert(4 + functions.size() <= EGALITO_INIT_ARRAY_SZ);
+    egalito_init_array[1] = (address_t)argc;
+    egalito_init_array[2] = (address_t)argv;
+    egalito_init_array[3] = (address_t)envp;
+    size_t init_index = 4;
+    for(auto function : functions) {
+        egalito_init_array[init_index++] = function;
+    }
+    egalito_init_array[0] = init_index;
+}
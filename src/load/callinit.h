@@ -1,17 +1,25 @@
 #ifndef EGALITO_LOAD_CALL_INIT_H
 #define EGALITO_LOAD_CALL_INIT_H
 
+#include <vector>
+#include "types.h"
+
 class Program;
 class GSTable;
 class Conductor;
 
 class CallInit {
-private:
-    using Start2Type = void (*)();
 public:
+    using Start2Type = void (*)();
     static void makeInitArray(Program *program, int argc, char **argv,
         char **envp, GSTable *gsTable);
     static Start2Type getStart2(Conductor *conductor);
+
+    /** Functions placed in the init array by makeInitArray(). */
+    static std::vector<address_t> getInitFunctions();
+    /** Rebuilds the init array from getInitFunctions() of an earlier run. */
+    static void setInitFunctions(const std::vector<address_t> &functions,
+        int argc, char **argv, char **envp);
 };
 
 #endif
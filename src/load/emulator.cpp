@@ -1,10 +1,12 @@
 #include <cstring>  // for memcpy in generated code
 #include <cassert>
+#include <elf.h>  // for AT_*
 #include "config.h"
 #include "emulator.h"
 #include "chunk/link.h"
 #include "chunk/concrete.h"
 #include "chunk/tls.h"
+#include "elf/auxv.h"
 #include "elf/elfspace.h"
 #include "conductor/conductor.h"
 #include "conductor/setup.h"
@@ -13,6 +15,11 @@
 #include "log/log.h"
 
 extern ConductorSetup *egalito_conductor_setup;
+
+// set instead of egalito_conductor_setup when launched from a LoaderSnapshot
+const char *egalito_tls_image __attribute__((weak));
+size_t egalito_tls_image_size __attribute__((weak));
+size_t egalito_tls_image_offset __attribute__((weak));
 #ifdef USE_LOADER
 namespace Emulation {
     #include "../dep/rtld/rtld.h"
@@ -67,6 +74,25 @@ namespace Emulation {
     }
     void set_dl_error_catch_tsd(...) {}
 
+    // The _rtld_global_ro dump comes from the build machine; ld.so would
+    // fill these fields from the auxiliary vector instead. Which of them
+    // exist depends on the glibc version.
+    #define EMULATE_AUXV_FIELD(field) \
+        template <typename T, \
+            typename typecheck<decltype(T::field)>::type = 0> \
+        void set##field(T *rtld, address_t value) { \
+            rtld->field = (decltype(rtld->field))(value); \
+        } \
+        void set##field(...) {}
+    EMULATE_AUXV_FIELD(_dl_pagesize)
+    EMULATE_AUXV_FIELD(_dl_clktck)
+    EMULATE_AUXV_FIELD(_dl_hwcap)
+    EMULATE_AUXV_FIELD(_dl_hwcap2)
+    EMULATE_AUXV_FIELD(_dl_sysinfo_dso)
+    EMULATE_AUXV_FIELD(_dl_minsigstacksize)
+    EMULATE_AUXV_FIELD(_dl_auxv)
+    #undef EMULATE_AUXV_FIELD
+
 
     // cf. elf/dl-tls.c
     void _dl_get_tls_static_info(size_t *sizep, size_t *alignp) {
@@ -76,9 +102,16 @@ namespace Emulation {
     // cf. elf/dl-tls.c
     void *_dl_allocate_tls(void *mem) {
         while(!mem);    // poor man's assert (must work in constructor)
-        auto conductor = egalito_conductor_setup->getConductor();
         address_t tcb = reinterpret_cast<address_t>(mem);
-        conductor->loadTLSDataFor(tcb);
+        if(egalito_tls_image) {
+            std::memcpy(reinterpret_cast<void *>(
+                tcb + egalito_tls_image_offset),
+                egalito_tls_image, egalito_tls_image_size);
+        }
+        else {
+            auto conductor = egalito_conductor_setup->getConductor();
+            conductor->loadTLSDataFor(tcb);
+        }
         // we initialize child's EgalitoTLS here using the data structures
         // created by the parent. However, %gs is not set until the child
         // is actually created. (The child has to execute the parent code
@@ -127,6 +160,51 @@ void LoaderEmulator::setStackLinks(char **argv, char **envp) {
     createDataVariable2(libc_stack_end, argv, egalito);
 }
 
+std::vector<address_t> LoaderEmulator::getStackLinkLocations() {
+    std::vector<address_t> locations;
+    if(!egalito || !egalito->getElfSpace()) return locations;
+    auto symbolList = egalito->getElfSpace()->getSymbolList();
+    auto base = egalito->getElfSpace()->getElfMap()->getBaseAddress();
+
+    for(auto name : {"_ZN9Emulation8_dl_argvE", "_ZN9Emulation9__environE",
+        "_ZN9Emulation16__libc_stack_endE"}) {
+
+        auto symbol = symbolList->find(name);
+        locations.push_back(symbol ? base + symbol->getAddress() : 0);
+    }
+    return locations;
+}
+
+void LoaderEmulator::setAuxiliaryValues(char **argv) {
+    setAuxiliaryValues(rtldGlobalRO, argv);
+}
+
+void LoaderEmulator::setAuxiliaryValues(address_t rtldGlobalRO, char **argv) {
+#ifdef USE_LOADER
+    if(!rtldGlobalRO) return;
+    auto ro = reinterpret_cast<Emulation::my_rtld_global_ro *>(rtldGlobalRO);
+
+    address_t *auxv = findAuxiliaryVector(argv);
+    Emulation::set_dl_auxv(ro, reinterpret_cast<address_t>(auxv));
+    for(address_t *p = auxv; p[0] != AT_NULL; p += 2) {
+        switch(p[0]) {
+        case AT_PAGESZ:         Emulation::set_dl_pagesize(ro, p[1]); break;
+        case AT_CLKTCK:         Emulation::set_dl_clktck(ro, p[1]); break;
+        case AT_HWCAP:          Emulation::set_dl_hwcap(ro, p[1]); break;
+        case AT_HWCAP2:         Emulation::set_dl_hwcap2(ro, p[1]); break;
+        case AT_SYSINFO_EHDR:   Emulation::set_dl_sysinfo_dso(ro, p[1]); break;
+#ifdef AT_MINSIGSTKSZ
+        case AT_MINSIGSTKSZ:
+            Emulation::set_dl_minsigstacksize(ro, p[1]);
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+#endif
+}
+
 LoaderEmulator LoaderEmulator::instance;
 
 void LoaderEmulator::setup(Conductor *conductor) {
@@ -272,6 +350,7 @@ void LoaderEmulator::initRT(Conductor *conductor) {
     auto rtld_ro_casted = reinterpret_cast<Emulation::my_rtld_global_ro *>(
         rtld_ro->getDest()->getTargetAddress());
     Emulation::init_rtld_global_ro(rtld_ro_casted);
+    this->rtldGlobalRO = reinterpret_cast<address_t>(rtld_ro_casted);
 
     LOG(1, "initialize rtld_global at " << rtld_casted);
     LOG(1, "initialize rtld_global_ro at " << rtld_ro_casted);
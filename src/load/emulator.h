@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include "types.h"
 
 class Conductor;
@@ -15,6 +16,7 @@ class DataVariable;
 class LoaderEmulator {
 private:
     Module *egalito;
+    address_t rtldGlobalRO;
     static LoaderEmulator instance;
 public:
     static LoaderEmulator &getInstance() { return instance; }
@@ -26,12 +28,22 @@ public:
     void setupForExecutableGen(Conductor *conductor);
 
     void setStackLinks(char **argv, char **envp);
+    /** Where setStackLinks() stores argv, envp and the stack end. */
+    std::vector<address_t> getStackLinkLocations();
     void initRT(Conductor *conductor);
 
+    /** After initRT(), fills in the values ld.so takes from the auxiliary
+        vector (page size, vDSO, hwcaps, ...) for this process.
+    */
+    void setAuxiliaryValues(char **argv);
+    static void setAuxiliaryValues(address_t rtldGlobalRO, char **argv);
+    /** Address of the emulated _rtld_global_ro, 0 before initRT(). */
+    address_t getRtldGlobalRO() const { return rtldGlobalRO; }
+
     Function *findFunction(const std::string &symbol);
     Link *makeDataLink(const std::string &symbol, bool afterMapping);
 private:
-    LoaderEmulator() : egalito(nullptr) {}
+    LoaderEmulator() : egalito(nullptr), rtldGlobalRO(0) {}
 
     DataVariable *findEgalitoDataVariable(const char *name);
 
@@ -2,6 +2,7 @@
 #include <cstdio>  // for std::fflush
 #include <cstdlib>  // for getenv
 #include <unistd.h>  // for STDERR_FILENO
+#include <fcntl.h>  // for open
 
 #include "loader.h"
 #include "usage.h"
@@ -11,6 +12,7 @@
 #include "preparetls.h"
 #include "datastruct.h"
 #include "makebridge.h"
+#include "snapshot.h"
 #include "chunk/tls.h"
 #include "elf/auxv.h"
 #include "elf/elfmap.h"
@@ -20,7 +22,9 @@
 #include "pass/logcalls.h"
 #include "pass/loginstr.h"
 #include "pass/noppass.h"
+#include "pass/peephole.h"
 #include "pass/promotejumps.h"
+#include "pass/relaxbranches.h"
 #include "pass/resolveplt.h"
 #include "pass/collapseplt.h"
 #include "pass/hijack.h"
@@ -37,6 +41,8 @@
 #include "pass/syscallsandbox.h"
 #include "pass/clearplts.h"
 #include "runtime/managegs.h"
+#include "runtime/directcall.h"
+#include "runtime/sampler.h"
 #include "transform/sandbox.h"
 #include "util/feature.h"
 #include "util/timing.h"
@@ -50,6 +56,9 @@ extern const char *egalito_initial_stack;
 extern "C" void _start2(void);
 
 extern ConductorSetup *egalito_conductor_setup;
+extern Sandbox *egalito_jit_shared_sandbox;
+extern int egalito_jit_record_fd;
+extern size_t egalito_jit_direct_calls;
 
 static GSTable *gsTable;
 
@@ -97,6 +106,7 @@ void EgalitoLoader::setupEnvironment(int argc, char *argv[]) {
 
     SegMap::mapAllSegments(setup);
     LoaderEmulator::getInstance().initRT(setup->getConductor());
+    LoaderEmulator::getInstance().setAuxiliaryValues(argv);
 
     // assign addresses of global variables passed-through to target
     MakeLoaderBridge::make();
@@ -104,7 +114,20 @@ void EgalitoLoader::setupEnvironment(int argc, char *argv[]) {
 
 void EgalitoLoader::generateCode() {
     if(isFeatureEnabled("EGALITO_USE_GS")) {
-        this->sandbox = setup->makeShufflingSandbox();
+        if(isFeatureEnabled("EGALITO_JIT_SHARED")) {
+            this->sandbox = setup->makeSharedSandbox();
+        }
+        else if(isFeatureEnabled("EGALITO_USE_RECYCLING")) {
+            this->sandbox = setup->makeRecyclingSandbox();
+        }
+        else {
+            this->sandbox = setup->makeShufflingSandbox();
+        }
+    }
+    else if(isFeatureEnabled("EGALITO_USE_HUGEPAGES")) {
+        const char *node = getenv("EGALITO_NUMA_NODE");
+        this->sandbox = setup->makeHugePageLoaderSandbox(
+            node ? std::atoi(node) : -1);
     }
     else {
         this->sandbox = setup->makeLoaderSandbox();
@@ -139,6 +162,20 @@ void EgalitoLoader::run() {
 
     auto start2 = CallInit::getStart2(setup->getConductor());
 
+    if(auto snapshot = getenv("EGALITO_SNAPSHOT")) {
+        if(!fromArchive) LoaderSnapshot::save(snapshot, setup, sandbox);
+    }
+
+    if(auto samples = getenv("EGALITO_SAMPLE")) {
+        if(isFeatureEnabled("EGALITO_USE_GS")) {
+            LOG(0, "WARNING: EGALITO_SAMPLE is not supported with JIT GS,"
+                " code moves during execution");
+        }
+        else {
+            SamplingProfiler::start(setup->getConductor(), samples);
+        }
+    }
+
     std::cout.flush();
     std::fflush(stdout);
 
@@ -147,6 +184,9 @@ void EgalitoLoader::run() {
 
     ShufflingSandbox *shufflingSandbox
         = dynamic_cast<ShufflingSandbox *>(sandbox);
+    RecyclingSandbox *recyclingSandbox
+        = dynamic_cast<RecyclingSandbox *>(sandbox);
+    SharedSandbox *sharedSandbox = dynamic_cast<SharedSandbox *>(sandbox);
 
     // --- last point virtual functions work ---
     // update vtable pointers to new libegalito code (LOG needs vtable)
@@ -160,12 +200,29 @@ void EgalitoLoader::run() {
             static_cast<int>(duration / 1000));
     }
 
+    // the fixup hook must not allocate, so this is set up in advance
+    DirectCallPatcher *directCalls = nullptr;
+    if((shufflingSandbox || recyclingSandbox) && ::egalito_jit_direct_calls) {
+        directCalls = new DirectCallPatcher(gsTable,
+            ::egalito_jit_direct_calls);
+    }
+
     // --- last point accesses to loader TLS work ('new' needs loader TLS)
     PrepareTLS::prepare(setup->getConductor());
 
     if(shufflingSandbox) {
         EgalitoTLS::setSandbox(shufflingSandbox);
         EgalitoTLS::setGSTable(gsTable);
+        EgalitoTLS::setJITDirectCalls(directCalls);
+    }
+    else if(recyclingSandbox) {
+        EgalitoTLS::setRecyclingSandbox(recyclingSandbox);
+        EgalitoTLS::setGSTable(gsTable);
+        EgalitoTLS::setJITDirectCalls(directCalls);
+    }
+    else if(sharedSandbox) {
+        ::egalito_jit_shared_sandbox = sharedSandbox;
+        EgalitoTLS::setGSTable(gsTable);
     }
 
     // jump to the target program (never returns)
@@ -186,6 +243,9 @@ void EgalitoLoader::otherPasses() {
         // false = do not add tracing to Egalito's own functions
         setup->getConductor()->acceptInAllModules(&logCalls, false);
         //setup->getConductor()->getProgram()->getMain()->accept(&logCalls);
+
+        PeepholePass peephole("LogCallsPass");
+        setup->getConductor()->acceptInAllModules(&peephole, false);
     }
 
 #if 1  // add instruction logging?
@@ -223,9 +283,15 @@ void EgalitoLoader::otherPasses() {
         gsTable = new GSTable();
         //setup->getConductor()->getProgram()->getChildren()->add(gsTable);
 
-        JitGSSetup jitGSSetup(setup->getConductor(), gsTable);
+        JitGSSetup jitGSSetup(setup->getConductor(), gsTable,
+            getenv("EGALITO_JIT_PROFILE"));
         program->accept(&jitGSSetup);
 
+        if(auto record = getenv("EGALITO_JIT_RECORD")) {
+            ::egalito_jit_record_fd
+                = open(record, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        }
+
         auto ifuncList = setup->getConductor()->getIFuncList();
         UseGSTablePass useGSTable(setup->getConductor(), gsTable, ifuncList);
         program->accept(&useGSTable);
@@ -259,6 +325,10 @@ void EgalitoLoader::otherPasses() {
     if(!fromArchive) {
         PromoteJumpsPass promoteJumps;
         setup->getConductor()->acceptInAllModules(&promoteJumps, true);
+        if(isFeatureEnabled("EGALITO_USE_RELAX_BRANCHES")) {
+            RelaxBranchesPass relaxBranches;
+            setup->getConductor()->acceptInAllModules(&relaxBranches, true);
+        }
     }
     if(0) {
         ClearPLTs clearPLTs;
@@ -276,16 +346,18 @@ void EgalitoLoader::otherPasses() {
 void EgalitoLoader::otherPassesAfterMove() {
     if(isFeatureEnabled("EGALITO_USE_GS")) {
         ManageGS::init(gsTable);
-        auto sb = dynamic_cast<ShufflingSandbox *>(sandbox);
-        sb->flip();
-        sb->reopen();
-        sb->recreate();
-        sb->finalize();
+        if(auto sb = dynamic_cast<ShufflingSandbox *>(sandbox)) {
+            sb->flip();
+            sb->reopen();
+            sb->recreate();
+            sb->finalize();
+        }
 
         MakeCachePass makeCachePass;
         for(auto entry : CIter::children(gsTable)) {
             entry->getTarget()->accept(&makeCachePass);
         }
+        makeCachePass.dumpStatistics();
     }
 }
 
@@ -313,6 +385,10 @@ int main(int argc, char *argv[]) {
 
     const char *program = argv[1];
 
+    if(auto snapshot = getenv("EGALITO_SNAPSHOT")) {
+        LoaderSnapshot::launch(snapshot, argc, argv);  // returns if stale
+    }
+
     EgalitoLoader loader;
     if(loader.parse(program)) {
         loader.setupEnvironment(argc, argv);
@@ -11,9 +11,11 @@ extern "C" void _set_tpidr_el0(address_t addr);
 
 // Do not call any virtual function
 void PrepareTLS::prepare(Conductor *conductor) {
-#ifdef ARCH_X86_64
-    auto main_tp = conductor->getMainThreadPointer();
+    prepare(conductor->getMainThreadPointer());
+}
 
+void PrepareTLS::prepare(address_t main_tp) {
+#ifdef ARCH_X86_64
     void *_thrdescr = reinterpret_cast<void *>(main_tp);
     struct my_tcbhead_t *_head = static_cast<struct my_tcbhead_t *>(_thrdescr);
 
@@ -54,7 +56,6 @@ void PrepareTLS::prepare(Conductor *conductor) {
     //LOG(1, "set %""fs to point at " << main_tp);
     _set_fs(main_tp);
 #elif defined(ARCH_AARCH64)
-    auto main_tp = conductor->getMainThreadPointer();
     _set_tpidr_el0(main_tp);
 #endif
 }
@@ -1,11 +1,14 @@
 #ifndef EGALITO_LOAD_PREPARE_TLS_H
 #define EGALITO_LOAD_PREPARE_TLS_H
 
+#include "types.h"
+
 class Conductor;
 
 class PrepareTLS {
 public:
     static void prepare(Conductor *conductor);
+    static void prepare(address_t main_tp);
 };
 
 #endif
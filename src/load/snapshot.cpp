@@ -0,0 +1,400 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>  // for std::fflush, std::rename
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "callinit.h"
+#include "emulator.h"
+#include "preparetls.h"
+#include "archive/stream.h"
+#include "chunk/concrete.h"
+#include "chunk/ifunc.h"
+#include "conductor/conductor.h"
+#include "conductor/setup.h"
+#include "elf/auxv.h"
+#include "elf/elfmap.h"
+#include "transform/sandbox.h"
+#include "util/feature.h"
+#include "log/log.h"
+
+#define ROUND_DOWN(x)   ((x) & ~0xfff)
+#define ROUND_UP(x)     (((x) + 0xfff) & ~0xfff)
+
+extern address_t egalito_entry;
+extern const char *egalito_initial_stack;
+extern IFuncList *egalito_ifuncList;
+extern const char *egalito_tls_image;
+extern size_t egalito_tls_image_size;
+extern size_t egalito_tls_image_offset;
+extern char **environ;
+
+static const char SNAPSHOT_MAGIC[] = "EGSNAP02";
+
+namespace {
+struct SnapshotRegion {
+    address_t address;
+    size_t size;
+    uint32_t prot;
+    uint64_t offset;  // from the start of the page-aligned data
+};
+}
+
+static uint64_t hashBytes(const char *data, size_t size,
+    uint64_t hash = 0xcbf29ce484222325ull) {
+
+    // FNV-1a
+    for(size_t i = 0; i < size; i ++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t hashFile(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) return 0;
+
+    struct stat st;
+    uint64_t hash = 0;
+    if(fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED) {
+            hash = hashBytes(static_cast<const char *>(map), st.st_size);
+            munmap(map, st.st_size);
+        }
+    }
+    close(fd);
+    return hash;
+}
+
+static uint64_t hashSettings() {
+    // log levels do not affect the generated code
+    std::vector<std::string> settings;
+    for(char **env = environ; *env; env ++) {
+        if(std::strncmp(*env, "EGALITO_", 8) != 0) continue;
+        if(std::strncmp(*env, "EGALITO_SNAPSHOT=", 17) == 0) continue;
+        if(std::strncmp(*env, "EGALITO_DEBUG=", 14) == 0) continue;
+        settings.push_back(*env);
+    }
+    std::sort(settings.begin(), settings.end());
+
+    uint64_t hash = hashBytes(nullptr, 0);
+    for(const auto &setting : settings) {
+        hash = hashBytes(setting.c_str(), setting.length() + 1, hash);
+    }
+    return hash;
+}
+
+bool LoaderSnapshot::save(const char *filename, ConductorSetup *setup,
+    Sandbox *sandbox) {
+
+    if(isFeatureEnabled("EGALITO_USE_GS")
+        || isFeatureEnabled("EGALITO_LOG_CALL")
+        || isFeatureEnabled("EGALITO_LOG_INSTRUCTION_PASS")) {
+
+        LOG(0, "WARNING: snapshots are not supported in this configuration");
+        return false;
+    }
+    auto loaderSandbox = dynamic_cast<LoaderSandbox *>(sandbox);
+    if(!loaderSandbox) {
+        LOG(0, "WARNING: snapshots require the default loader sandbox");
+        return false;
+    }
+
+    auto conductor = setup->getConductor();
+    auto program = conductor->getProgram();
+
+    // the executable must come first, it is checked against argv[1]
+    std::vector<std::string> inputs;
+    inputs.push_back(program->getMain()->getLibrary()->getResolvedPath());
+    inputs.push_back("/proc/self/exe");
+    for(auto module : CIter::modules(program)) {
+        if(module == program->getMain()) continue;
+        inputs.push_back(module->getLibrary()->getResolvedPath());
+    }
+
+    std::vector<SnapshotRegion> regions;
+    auto backing = loaderSandbox->getBacking();
+    regions.push_back({backing->getBase(),
+        ROUND_UP(loaderSandbox->getAllocator()->getCurrent())
+            - backing->getBase(), PROT_READ | PROT_EXEC, 0});
+
+    // data regions may share pages, so merge them as SegMap mapped them.
+    // SegMap leaves every region writable for the data fixups; these are
+    // done by now, so each region gets its ELF permissions back.
+    std::vector<SnapshotRegion> pages;
+    size_t tlsImageSize = 0;
+    for(auto module : CIter::modules(program)) {
+        for(auto region : CIter::regions(module)) {
+            if(dynamic_cast<TLSDataRegion *>(region)) {
+                tlsImageSize += region->getSize();
+                continue;
+            }
+            if(!region->getSize()) continue;
+            uint32_t prot = 0;
+            if(region->readable()) prot |= PROT_READ;
+            if(region->writable()) prot |= PROT_WRITE;
+            auto start = ROUND_DOWN(region->getAddress());
+            auto end = ROUND_UP(region->getAddress() + region->getSize());
+            pages.push_back({start, end - start, prot, 0});
+        }
+    }
+    std::sort(pages.begin(), pages.end(),
+        [] (const SnapshotRegion &a, const SnapshotRegion &b) {
+            return a.address < b.address;
+        });
+    for(size_t i = 0; i < pages.size(); ) {
+        auto start = pages[i].address;
+        auto end = start + pages[i].size;
+        auto prot = pages[i].prot;
+        for(i ++; i < pages.size() && pages[i].address <= end; i ++) {
+            if(pages[i].address < end) prot |= pages[i].prot;
+            else if(pages[i].prot != prot) break;
+            end = std::max(end, pages[i].address + pages[i].size);
+        }
+        regions.push_back({start, end - start, prot, 0});
+    }
+    if(conductor->getTLSAreaSize()) {
+        regions.push_back({conductor->getTLSAreaBase(),
+            conductor->getTLSAreaSize(), PROT_READ | PROT_WRITE, 0});
+    }
+
+    // pristine copy of the TLS data, for threads created later
+    address_t tlsImage = conductor->getMainThreadPointer()
+        + conductor->getTLSOffsetFromTCB();
+    SnapshotRegion tlsImageRegion = {tlsImage, tlsImageSize, PROT_READ, 0};
+
+    uint64_t offset = 0;
+    for(auto &region : regions) {
+        region.offset = offset;
+        offset += ROUND_UP(region.size);
+    }
+    tlsImageRegion.offset = offset;
+
+    std::ostringstream table;
+    ArchiveStreamWriter writer(table);
+    writer.writeFixedLengthBytes(SNAPSHOT_MAGIC, 8);
+    writer.write<uint64_t>(hashSettings());
+    writer.write<uint32_t>(inputs.size());
+    for(const auto &input : inputs) {
+        auto hash = hashFile(input.c_str());
+        if(!hash) {
+            LOG(0, "WARNING: cannot snapshot, unable to read " << input);
+            return false;
+        }
+        writer.writeBytes(input);
+        writer.write<uint64_t>(hash);
+    }
+
+    writer.write<address_t>(::egalito_entry);
+    writer.write<address_t>(reinterpret_cast<address_t>(
+        CallInit::getStart2(conductor)));
+    writer.write<address_t>(conductor->getMainThreadPointer());
+    writer.write<address_t>(LoaderEmulator::getInstance().getRtldGlobalRO());
+    auto stackLinks = LoaderEmulator::getInstance().getStackLinkLocations();
+    stackLinks.resize(3);
+    for(auto location : stackLinks) {
+        writer.write<address_t>(location);
+    }
+
+    auto initFunctions = CallInit::getInitFunctions();
+    writer.write<uint32_t>(initFunctions.size());
+    for(auto function : initFunctions) {
+        writer.write<address_t>(function);
+    }
+
+    auto ifuncList = conductor->getIFuncList();
+    writer.write<uint32_t>(ifuncList ? ifuncList->getMap().size() : 0);
+    if(ifuncList) {
+        for(const auto &ifunc : ifuncList->getMap()) {
+            writer.write<address_t>(ifunc.first);
+            writer.write<address_t>(ifunc.second->getAddress());
+        }
+    }
+
+    writer.write<uint32_t>(regions.size());
+    for(const auto &region : regions) {
+        writer.write<address_t>(region.address);
+        writer.write<uint64_t>(region.size);
+        writer.write<uint32_t>(region.prot);
+        writer.write<uint64_t>(region.offset);
+    }
+    writer.write<uint64_t>(conductor->getTLSOffsetFromTCB());
+    writer.write<uint64_t>(tlsImageRegion.size);
+    writer.write<uint64_t>(tlsImageRegion.offset);
+
+    // write to a temporary file so that a concurrent launch never sees
+    // a partial snapshot
+    std::string temporary = std::string(filename) + ".tmp";
+    std::ofstream file(temporary, std::ios::binary);
+    ArchiveStreamWriter fileWriter(file);
+    std::string tableData = table.str();
+    fileWriter.write<uint64_t>(tableData.length());
+    fileWriter.writeFixedLengthBytes(tableData.c_str(), tableData.length());
+
+    std::string padding(ROUND_UP(sizeof(uint64_t) + tableData.length())
+        - (sizeof(uint64_t) + tableData.length()), '\0');
+    fileWriter.writeFixedLengthBytes(padding.c_str(), padding.length());
+    regions.push_back(tlsImageRegion);
+    for(const auto &region : regions) {
+        fileWriter.writeFixedLengthBytes(
+            reinterpret_cast<const char *>(region.address), region.size);
+        padding.assign(ROUND_UP(region.size) - region.size, '\0');
+        fileWriter.writeFixedLengthBytes(padding.c_str(), padding.length());
+    }
+    file.close();
+
+    if(!file || std::rename(temporary.c_str(), filename) != 0) {
+        LOG(0, "WARNING: unable to write snapshot " << filename);
+        unlink(temporary.c_str());
+        return false;
+    }
+    LOG(0, "saved snapshot " << filename << " (" << regions.size()
+        << " regions, " << inputs.size() << " input files)");
+    return true;
+}
+
+void LoaderSnapshot::launch(const char *filename, int argc, char *argv[]) {
+    std::ifstream file(filename, std::ios::binary);
+    if(!file) return;  // not taken yet
+    ArchiveStreamReader reader(file);
+
+    auto tableSize = reader.read<uint64_t>();
+    if(reader.readFixedLengthBytes(8) != std::string(SNAPSHOT_MAGIC, 8)) {
+        LOG(0, "WARNING: " << filename << " is not a loader snapshot");
+        return;
+    }
+    if(reader.read<uint64_t>() != hashSettings()) {
+        LOG(0, "snapshot is stale: EGALITO_* settings changed");
+        return;
+    }
+    auto inputCount = reader.read<uint32_t>();
+    for(uint32_t i = 0; i < inputCount && reader.stillGood(); i ++) {
+        auto input = reader.readBytes();
+        auto hash = reader.read<uint64_t>();
+        const char *current = (i == 0 ? argv[1] : input.c_str());
+        if(hashFile(current) != hash) {
+            LOG(0, "snapshot is stale: " << current << " changed");
+            return;
+        }
+    }
+
+    auto entry = reader.read<address_t>();
+    auto start2 = reader.read<address_t>();
+    auto mainThreadPointer = reader.read<address_t>();
+    auto rtldGlobalRO = reader.read<address_t>();
+    address_t stackLinks[3];
+    for(auto &location : stackLinks) {
+        location = reader.read<address_t>();
+    }
+
+    std::vector<address_t> initFunctions(reader.read<uint32_t>());
+    for(auto &function : initFunctions) {
+        function = reader.read<address_t>();
+    }
+
+    std::vector<std::pair<address_t, address_t>> ifuncs(
+        reader.read<uint32_t>());
+    for(auto &ifunc : ifuncs) {
+        ifunc.first = reader.read<address_t>();
+        ifunc.second = reader.read<address_t>();
+    }
+
+    std::vector<SnapshotRegion> regions(reader.read<uint32_t>());
+    for(auto &region : regions) {
+        region.address = reader.read<address_t>();
+        region.size = reader.read<uint64_t>();
+        region.prot = reader.read<uint32_t>();
+        region.offset = reader.read<uint64_t>();
+    }
+    auto tlsImageOffset = reader.read<uint64_t>();
+    auto tlsImageSize = reader.read<uint64_t>();
+    auto tlsImageFileOffset = reader.read<uint64_t>();
+    if(!reader.stillGood()) {
+        LOG(0, "WARNING: snapshot " << filename << " is truncated");
+        return;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) return;
+    uint64_t dataStart = ROUND_UP(sizeof(uint64_t) + tableSize);
+    for(size_t i = 0; i < regions.size(); i ++) {
+        const auto &region = regions[i];
+        void *mem = mmap(reinterpret_cast<void *>(region.address),
+            region.size, region.prot, MAP_PRIVATE, fd,
+            dataStart + region.offset);
+        if(mem != reinterpret_cast<void *>(region.address)) {
+            LOG(0, "WARNING: snapshot region at 0x" << std::hex
+                << region.address << " overlaps with other regions");
+            if(mem != MAP_FAILED) munmap(mem, region.size);
+            while(i--) munmap(reinterpret_cast<void *>(regions[i].address),
+                regions[i].size);
+            close(fd);
+            return;
+        }
+    }
+    void *tlsImage = nullptr;
+    if(tlsImageSize) {
+        tlsImage = mmap(nullptr, tlsImageSize, PROT_READ, MAP_PRIVATE, fd,
+            dataStart + tlsImageFileOffset);
+    }
+    close(fd);
+
+    LOG(0, "launching from snapshot " << filename);
+
+    // same as EgalitoLoader::setupEnvironment()
+    adjustAuxiliaryVector(argv, new ElfMap(argv[1]), nullptr);
+    auto adjust = removeLoaderFromArgv(argv);
+    egalito_initial_stack += adjust;
+    argv = (char **)((char *)argv + adjust);
+
+    char **envp = argv;
+    while(*envp) envp ++;
+    envp ++;
+
+    // same as LoaderEmulator::setStackLinks()
+    address_t stackValues[3] = {
+        reinterpret_cast<address_t>(argv), reinterpret_cast<address_t>(envp),
+        reinterpret_cast<address_t>(argv)
+    };
+    for(size_t i = 0; i < 3; i ++) {
+        if(!stackLinks[i]) continue;
+        *reinterpret_cast<address_t *>(stackLinks[i]) = stackValues[i];
+    }
+
+    // the saved values came from the auxiliary vector of the first run.
+    // The stack canary and pointer guard are copied from the loader's own
+    // TCB by PrepareTLS::prepare() below, so they are fresh already.
+    LoaderEmulator::setAuxiliaryValues(rtldGlobalRO, argv);
+
+    auto ifuncList = new IFuncList();
+    for(const auto &ifunc : ifuncs) {
+        ifuncList->addIFuncFor(ifunc.first, ifunc.second);
+    }
+    ::egalito_ifuncList = ifuncList;
+
+    if(tlsImage && tlsImage != MAP_FAILED) {
+        ::egalito_tls_image = static_cast<const char *>(tlsImage);
+        ::egalito_tls_image_size = tlsImageSize;
+        ::egalito_tls_image_offset = tlsImageOffset;
+    }
+
+    CallInit::setInitFunctions(initFunctions, argc, argv, envp);
+    ::egalito_entry = entry;
+
+    std::cout.flush();
+    std::fflush(stdout);
+
+    // --- last point accesses to loader TLS work
+    PrepareTLS::prepare(mainThreadPointer);
+
+    // jump to the target program (never returns)
+    reinterpret_cast<CallInit::Start2Type>(start2)();
+}
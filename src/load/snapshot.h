@@ -0,0 +1,35 @@
+#ifndef EGALITO_LOAD_SNAPSHOT_H
+#define EGALITO_LOAD_SNAPSHOT_H
+
+#include "types.h"
+
+class ConductorSetup;
+class Sandbox;
+
+/** Fully laid-out image of a loaded program (EGALITO_SNAPSHOT=file).
+
+    The first run saves the generated code, every data region after data
+    section fixups, the TLS area and the values the loader hands to
+    _start2. Later runs map the file at the same addresses and jump to the
+    entry point, skipping parsing and code generation entirely. Values
+    taken from the auxiliary vector are re-read on each launch, and data
+    regions are mapped with their ELF permissions.
+
+    A snapshot is only used if the loader, the executable and every
+    library still hash to the recorded values, and the EGALITO_* settings
+    are unchanged. JIT GS mode and the logging passes keep loader data
+    structures alive at runtime, so they are never snapshotted.
+*/
+class LoaderSnapshot {
+public:
+    /** Returns false if nothing was written. */
+    static bool save(const char *filename, ConductorSetup *setup,
+        Sandbox *sandbox);
+
+    /** Never returns if the snapshot is valid. Otherwise returns with
+        nothing changed, so the caller can load the program normally.
+    */
+    static void launch(const char *filename, int argc, char *argv[]);
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <capstone/x86.h>
 #include "addinline.h"
 #include "analysis/frametype.h"
+#include "analysis/localliveness.h"
 #include "disasm/disassemble.h"
 #include "instr/register.h"
 #include "instr/semantic.h"
@@ -18,17 +19,45 @@ ChunkAddInline::ChunkAddInline(std::vector<Register> regList,
     modification = new ModificationImpl(regList, generator);
 }
 
-std::vector<Instruction *> ChunkAddInline::getFullCode(Instruction *point) {
+ChunkAddInline::ChunkAddInline(size_t scratchCount, bool clobbersFlags,
+    std::function<std::vector<Instruction *> (unsigned int,
+        const RegList &)> generator) {
+
+    modification = new ScratchModification(scratchCount, clobbersFlags,
+        generator);
+}
+
+ChunkAddInline::RegList ChunkAddInline::ScratchModification
+    ::getClobberedRegisters() {
+
+    auto list = scratch;
+    if(flags) list.push_back(X86_REG_EFLAGS);
+    return list;
+}
+
+std::vector<Instruction *> ChunkAddInline::getFullCode(Instruction *point,
+    Instruction *liveFrom) {
+
     auto function = dynamic_cast<Function *>(point->getParent()->getParent());
     assert(function != nullptr);
 
     bool redzone = !FrameType::hasStackFrame(function);
     SaveRestoreRegisters saveRestore(point, redzone);
 
-    auto regList = modification->getClobberedRegisters();
+    RegList regList;
+    if(auto scratchModification
+        = dynamic_cast<ScratchModification *>(modification)) {
+
+        regList = chooseScratch(scratchModification, liveFrom);
+    }
+    else {
+        regList = modification->getClobberedRegisters();
+    }
+
+    // the red zone is only skipped over if something is pushed
     unsigned int stackBytesAdded = 0;
     stackBytesAdded += regList.size() * 8;  // for pushes
-    if(redzone) stackBytesAdded += 0x80;
+    if(redzone && regList.size() > 0) stackBytesAdded += 0x80;
 
     std::vector<Instruction *> instrList;
     extendList(instrList, saveRestore.getRegSaveCode(regList));
@@ -38,14 +67,55 @@ std::vector<Instruction *> ChunkAddInline::getFullCode(Instruction *point) {
     return std::move(instrList);
 }
 
+ChunkAddInline::RegList ChunkAddInline::chooseScratch(
+    ScratchModification *scratchModification, Instruction *liveFrom) {
+
+    // caller-saved, and usable as a base register without a SIB byte
+    static const Register candidates[] = {
+        X86_REG_R11, X86_REG_R10, X86_REG_R9, X86_REG_R8,
+        X86_REG_RAX, X86_REG_RCX, X86_REG_RDX, X86_REG_RSI, X86_REG_RDI
+    };
+    auto count = scratchModification->getScratchCount();
+
+    RegList scratch, saveList;
+#ifdef ARCH_X86_64
+    for(auto reg : candidates) {
+        if(scratch.size() == count) break;
+        if(LocalLiveness::isDead(liveFrom,
+            X86Register::convertToPhysical(reg))) {
+
+            scratch.push_back(reg);
+        }
+    }
+#endif
+    LOG(10, "inline code has " << scratch.size() << " of " << count
+        << " scratch registers free");
+    for(auto reg : candidates) {
+        if(scratch.size() == count) break;
+        if(std::find(scratch.begin(), scratch.end(), reg) == scratch.end()) {
+            scratch.push_back(reg);
+            saveList.push_back(reg);
+        }
+    }
+    if(scratchModification->clobbersFlags()
+        && !LocalLiveness::flagsDead(liveFrom)) {
+
+        saveList.insert(saveList.begin(), X86_REG_EFLAGS);
+    }
+
+    scratchModification->setScratch(scratch);
+    return saveList;
+}
+
 void ChunkAddInline::insertBefore(Instruction *point, bool beforeJumpTo) {
-    auto newCode = getFullCode(point);
+    auto newCode = getFullCode(point, point);
     auto block = dynamic_cast<Block *>(point->getParent());
     ChunkMutator(block, true).insertBefore(point, newCode, beforeJumpTo);
 }
 
 void ChunkAddInline::insertAfter(Instruction *point) {
-    auto newCode = getFullCode(point);
+    auto newCode = getFullCode(point,
+        static_cast<Instruction *>(point->getNextSibling()));
     auto block = dynamic_cast<Block *>(point->getParent());
     ChunkMutator(block, true).insertAfter(point, newCode);
 }
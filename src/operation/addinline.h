@@ -39,6 +39,31 @@ public:
             { return makeCodeCallback(stackBytesAdded); }
         virtual RegList getClobberedRegisters() { return regList; }
     };
+
+    /** A snippet written against scratch registers chosen at each
+        insertion point: dead ones if LocalLiveness finds enough, else
+        others that are saved and restored. The flags are likewise only
+        saved if they are live.
+    */
+    class ScratchModification : public Modification {
+    private:
+        size_t scratchCount;
+        bool flags;
+        std::function<InstrList (unsigned int, const RegList &)> makeCodeCallback;
+        RegList scratch;
+    public:
+        ScratchModification(size_t scratchCount, bool clobbersFlags,
+            std::function<InstrList (unsigned int, const RegList &)> callback)
+            : scratchCount(scratchCount), flags(clobbersFlags),
+            makeCodeCallback(callback) {}
+        virtual InstrList getNewCode(unsigned int stackBytesAdded)
+            { return makeCodeCallback(stackBytesAdded, scratch); }
+        virtual RegList getClobberedRegisters();
+
+        size_t getScratchCount() const { return scratchCount; }
+        bool clobbersFlags() const { return flags; }
+        void setScratch(const RegList &scratch) { this->scratch = scratch; }
+    };
 private:
     class SaveRestoreRegisters {
     private:
@@ -65,12 +90,18 @@ public:
     ChunkAddInline(Modification *modification);
     ChunkAddInline(std::vector<Register> regList,
         std::function<std::vector<Instruction *> (unsigned int)> generator);
+    ChunkAddInline(size_t scratchCount, bool clobbersFlags,
+        std::function<std::vector<Instruction *> (unsigned int,
+            const RegList &)> generator);
     ~ChunkAddInline() { delete modification; }
 
     void insertBefore(Instruction *point, bool beforeJumpTo);
     void insertAfter(Instruction *point);
 private:
-    std::vector<Instruction *> getFullCode(Instruction *point);
+    std::vector<Instruction *> getFullCode(Instruction *point,
+        Instruction *liveFrom);
+    RegList chooseScratch(ScratchModification *scratchModification,
+        Instruction *liveFrom);
     void extendList(std::vector<Instruction *> &list,
         const std::vector<Instruction *> &additions);
 };
@@ -223,6 +223,7 @@ void ChunkMutator::remove(Chunk *child) {
 
     // remove from parent
     chunk->getChildren()->genericRemove(child);
+    markFunctionDirty();
 
     // update sizes of parents and grandparents
     for(Chunk *c = chunk; c && !dynamic_cast<Module *>(c); c = c->getParent()) {
@@ -248,6 +249,7 @@ void ChunkMutator::removeLast(int n) {
 
         chunk->getChildren()->genericRemoveLast();
     }
+    markFunctionDirty();
 
     // update sizes of parents and grandparents
     for(Chunk *c = chunk; c && !dynamic_cast<Module *>(c); c = c->getParent()) {
@@ -386,6 +388,8 @@ void ChunkMutator::splitFunctionBefore(Block *point) {
 }
 
 void ChunkMutator::modifiedChildSize(Chunk *child, int added) {
+    markFunctionDirty();
+
     // update sizes of parents and grandparents
     for(Chunk *c = chunk; c && !dynamic_cast<Module *>(c); c = c->getParent()) {
         c->addToSize(added);
@@ -416,7 +420,18 @@ void ChunkMutator::setNextSibling(Chunk *c, Chunk *next) {
     }
 }
 
+void ChunkMutator::markFunctionDirty() {
+    for(Chunk *c = chunk; c && !dynamic_cast<Module *>(c); c = c->getParent()) {
+        if(auto function = dynamic_cast<Function *>(c)) {
+            function->setDirty(true);
+            break;
+        }
+    }
+}
+
 void ChunkMutator::updateSizesAndAuthorities(Chunk *child) {
+    markFunctionDirty();
+
     // update sizes of parents and grandparents
     for(Chunk *c = chunk; c && !dynamic_cast<Module *>(c); c = c->getParent()) {
         c->addToSize(child->getSize());
@@ -88,6 +88,12 @@ public:
 
     void setPreviousSibling(Chunk *c, Chunk *prev);
     void setNextSibling(Chunk *c, Chunk *next);
+
+    /** Marks the Function containing this chunk as changed since the last
+        code generation. Instruction::setSemantic() and the linked semantics'
+        setLink() already do this; call it after other in-place edits.
+    */
+    void markFunctionDirty();
 private:
     void updateSizesAndAuthorities(Chunk *child);
     void updateGenerationCounts(Chunk *child);
@@ -1,6 +1,8 @@
 #include <vector>
 #include <cassert>
 #include "aflcoverage.h"
+#include "analysis/blockexit.h"
+#include "analysis/controlflow.h"
 #include "disasm/disassemble.h"
 #include "instr/register.h"
 #include "instr/concrete.h"
@@ -9,6 +11,7 @@
 #include "operation/find2.h"
 #include "pass/switchcontext.h"
 #include "types.h"
+#include "log/log.h"
 
 void AFLCoveragePass::visit(Program *program) {
     auto allocateFunc = ChunkFind2(program).findFunction(
@@ -43,6 +46,11 @@ void AFLCoveragePass::visit(Program *program) {
     }
 
     recurse(program);
+
+    if(mode == MODE_EDGE) {
+        LOG(1, "AFL edge coverage in " << instrumented << " blocks, "
+            << skipped << " implied by their predecessor");
+    }
 }
 
 void AFLCoveragePass::visit(Module *module) {
@@ -91,11 +99,112 @@ void AFLCoveragePass::visit(Function *function) {
     // sphinx3, function does tail recursion to itself
     if(function->getName() == "mdef_phone_id") return;
 
+    if(mode == MODE_EDGE) implied = findImpliedBlocks(function);
     recurse(function);
 }
 
 void AFLCoveragePass::visit(Block *block) {
-    addCoverageCode(block);
+    if(mode == MODE_EDGE) {
+        if(implied.count(block)) {
+            skipped ++;
+            return;
+        }
+        addEdgeCoverageCode(block);
+        instrumented ++;
+    }
+    else addCoverageCode(block);
+}
+
+/** The block in function containing the target of link, if any. */
+static Block *findTargetBlock(Link *link, Function *function) {
+    if(!link) return nullptr;
+    auto instr = dynamic_cast<Instruction *>(&*link->getTarget());
+    auto block = instr ? dynamic_cast<Block *>(instr->getParent())
+        : dynamic_cast<Block *>(&*link->getTarget());
+    return (block && block->getParent() == function) ? block : nullptr;
+}
+
+static void addJumpTableTargets(JumpTable *jumpTable, Function *function,
+    std::set<Block *> &targets) {
+
+    for(auto entry : CIter::children(jumpTable)) {
+        if(auto block = findTargetBlock(entry->getLink(), function)) {
+            targets.insert(block);
+        }
+    }
+}
+
+std::set<Block *> AFLCoveragePass::findImpliedBlocks(Function *function) {
+    std::set<Block *> implied;
+
+    // blocks that may be entered other than through a direct branch or a
+    // fallthrough; the CFG may not know about all of these
+    std::set<Block *> indirectTargets;
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            auto semantic = instr->getSemantic();
+            if(auto ij = dynamic_cast<IndirectJumpInstruction *>(semantic)) {
+                if(ij->getMnemonic() == "callq") continue;
+
+                // an unknown target could be any block
+                if(!ij->isForJumpTable()) return implied;
+                for(auto jumpTable : ij->getJumpTables()) {
+                    addJumpTableTargets(jumpTable, function, indirectTargets);
+                }
+            }
+            else if(!dynamic_cast<ControlFlowInstruction *>(semantic)) {
+                // a code address taken, e.g. for a computed goto
+                if(auto target = findTargetBlock(semantic->getLink(),
+                    function)) {
+
+                    indirectTargets.insert(target);
+                }
+            }
+        }
+    }
+    // including tables that were not attached to their jump
+    auto module = function->getParent()
+        ? dynamic_cast<Module *>(function->getParent()->getParent())
+        : nullptr;
+    if(module && module->getJumpTableList()) {
+        for(auto jumpTable : CIter::children(module->getJumpTableList())) {
+            if(!jumpTable->getDescriptor()
+                || jumpTable->getFunction() != function) continue;
+            addJumpTableTargets(jumpTable, function, indirectTargets);
+        }
+    }
+
+    ControlFlowGraph cfg(function);
+    auto entry = function->getChildren()->getIterable()->get(0);
+    for(size_t id = 0; id < cfg.getCount(); id ++) {
+        auto node = cfg.get(id);
+        auto block = node->getBlock();
+
+        // only known, direct ways out of the block
+        auto kind = BlockExit(block).getKind();
+        if(kind != BlockExit::EXIT_FALLTHROUGH
+            && kind != BlockExit::EXIT_JUMP) continue;
+
+        size_t succCount = 0;
+        ControlFlowLink *succ = nullptr;
+        for(auto link : node->forwardLinks()) {
+            succ = static_cast<ControlFlowLink *>(&*link);
+            succCount ++;
+        }
+        if(succCount != 1 || succ->getOffset() != 0) continue;
+
+        auto target = cfg.get(succ->getTargetID());
+        if(target == node || target->getBlock() == entry) continue;
+        if(indirectTargets.count(target->getBlock())) continue;
+
+        size_t predCount = 0;
+        for(auto link : target->backwardLinks()) {
+            (void)link;
+            predCount ++;
+        }
+        if(predCount == 1) implied.insert(target->getBlock());
+    }
+    return implied;
 }
 
 #define GET_BYTE(x, shift) static_cast<unsigned char>(((x) >> (shift*8)) & 0xff)
@@ -104,11 +213,19 @@ void AFLCoveragePass::visit(Block *block) {
 #define SHM_REGION 0x50000000
 #define SHM_REGION_SIZE 0x10000
 #define SHM_QUEUE_PTR (SHM_REGION - 0x1000)
+#define SHM_PREV_LOC 0x8  // %gs-relative, gs base is SHM_QUEUE_PTR
 
 void AFLCoveragePass::addCoverageCode(Block *block) {
     blockID = std::rand(); //% SHM_REGION_SIZE;
 
-    ChunkAddInline ai({X86_REG_R10, X86_REG_EFLAGS}, [this] (unsigned int stackBytesAdded) {
+    // one scratch register, preferably a dead one; the listings use %r10
+    ChunkAddInline ai(1, true, [this] (unsigned int stackBytesAdded,
+        const ChunkAddInline::RegList &scratch) {
+
+        int reg = X86Register::convertToPhysical(scratch[0]);
+        unsigned char rexR = (reg >= 8 ? 0x04 : 0x00);  // reg in ModRM.reg
+        unsigned char rexB = (reg >= 8 ? 0x01 : 0x00);  // reg in ModRM.rm
+        unsigned char low = reg & 7;
 #if 1
 		//   0:   41 52                   push   %r10
 		//   2:   4c 8b 15 cc cc 0c 00    mov    0xccccc(%rip),%r10        # 0xcccd5
@@ -126,36 +243,51 @@ void AFLCoveragePass::addCoverageCode(Block *block) {
         auto mov1Instr = new Instruction();
         auto mov1Sem = new LinkedInstruction(mov1Instr);
         mov1Sem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
-            std::vector<unsigned char>{0x4c, 0x8b, 0x15, 0x00, 0x00, 0x00, 0x00}));
+            std::vector<unsigned char>{static_cast<unsigned char>(0x48 | rexR),
+                0x8b, static_cast<unsigned char>(0x05 | (low << 3)),
+                0x00, 0x00, 0x00, 0x00}));
         mov1Sem->setLink(new UnresolvedRelativeLink(SHM_QUEUE_PTR));
         mov1Sem->setIndex(0);
         mov1Instr->setSemantic(mov1Sem);
 
 		//  17:   49 d1 ea                shr    %r10
-        auto shrInstr = Disassemble::instruction({0x49, 0xd1, 0xea});
+        auto shrInstr = Disassemble::instruction({
+            static_cast<unsigned char>(0x48 | rexB), 0xd1,
+            static_cast<unsigned char>(0xe8 | low)});
 
 
 		//   c:   49 81 f2 11 11 11 11    xor    $0x11111111,%r10
-        auto xorInstr = Disassemble::instruction({0x49, 0x81, 0xf2, GET_BYTES(blockID)});
+        auto xorInstr = Disassemble::instruction({
+            static_cast<unsigned char>(0x48 | rexB), 0x81,
+            static_cast<unsigned char>(0xf0 | low), GET_BYTES(blockID)});
 
 
         //  14:   4c 89 15 cc cc cc 00    mov    %r10,0xccccc(%rip)        # 0xddf8
         auto mov2Instr = new Instruction();
         auto mov2Sem = new LinkedInstruction(mov2Instr);
         mov2Sem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
-            std::vector<unsigned char>{0x4c, 0x89, 0x15, 0x00, 0x00, 0x00, 0x00}));
+            std::vector<unsigned char>{static_cast<unsigned char>(0x48 | rexR),
+                0x89, static_cast<unsigned char>(0x05 | (low << 3)),
+                0x00, 0x00, 0x00, 0x00}));
         mov2Sem->setLink(new UnresolvedRelativeLink(SHM_QUEUE_PTR));
         mov2Sem->setIndex(1);
         mov2Instr->setSemantic(mov2Sem);
 
 		//  1a:   49 81 e2 ff ff 00 00    and    $0xffff,%r10
-        auto andInstr = Disassemble::instruction({0x49, 0x81, 0xe2, GET_BYTES(SHM_REGION_SIZE - 1)});
+        auto andInstr = Disassemble::instruction({
+            static_cast<unsigned char>(0x48 | rexB), 0x81,
+            static_cast<unsigned char>(0xe0 | low),
+            GET_BYTES(SHM_REGION_SIZE - 1)});
 
 		//  10:   41 fe 82 00 00 00 50    incb   0x50000000(%r10)
-        auto incInstr = Disassemble::instruction({0x41, 0xfe, 0x82, GET_BYTES(SHM_REGION)});
+        std::vector<unsigned char> incBytes;
+        if(rexB) incBytes.push_back(0x40 | rexB);
+        incBytes.insert(incBytes.end(), {0xfe,
+            static_cast<unsigned char>(0x80 | low), GET_BYTES(SHM_REGION)});
+        auto incInstr = Disassemble::instruction(incBytes);
 
         return std::vector<Instruction *>{ mov1Instr, shrInstr, xorInstr, mov2Instr, andInstr, incInstr };
-#else  // 16-bit history version
+#else  // 16-bit history version, still assuming scratch[0] is %r10
 		//   0:   41 52                   push   %r10
 		//   2:   49 c7 c2 01 00 00 00    mov    $0x0001,%r10
 		//   9:   4c 33 15 cc cc 0c 00    xor    0xccccc(%rip),%r10        # 0xcccdc
@@ -202,5 +334,59 @@ void AFLCoveragePass::addCoverageCode(Block *block) {
     ai.insertBefore(instr1, true);
 }
 
+void AFLCoveragePass::addEdgeCoverageCode(Block *block) {
+    blockID = std::rand() % SHM_REGION_SIZE;
+
+    // no call and no pushf/popf unless the flags are live; gs is set up by
+    // egalito_allocate_afl_shm in libcoverage
+    ChunkAddInline ai(1, true, [this] (unsigned int stackBytesAdded,
+        const ChunkAddInline::RegList &scratch) {
+
+        return makeEdgeCoverageCode(
+            X86Register::convertToPhysical(scratch[0]), blockID);
+    });
+    auto instr1 = block->getChildren()->getIterable()->get(0);
+    ai.insertBefore(instr1, true);
+}
+
+std::vector<Instruction *> AFLCoveragePass::makeEdgeCoverageCode(int reg,
+    unsigned long blockID) {
+
+    unsigned char rexR = (reg >= 8 ? 0x04 : 0x00);  // reg in ModRM.reg
+    unsigned char rexB = (reg >= 8 ? 0x01 : 0x00);  // reg in ModRM.rm
+    unsigned char low = reg & 7;
+
+    //   0:   41 ba 11 11 00 00                mov    $0x1111,%r10d
+    //   6:   65 44 33 14 25 08 00 00 00       xor    %gs:0x8,%r10d
+    //   f:   41 fe 82 00 00 00 50             incb   0x50000000(%r10)
+    //  16:   65 c7 04 25 08 00 00 00 88 08 00 00
+    //                                         movl   $0x888,%gs:0x8
+
+    std::vector<unsigned char> movBytes;
+    if(rexB) movBytes.push_back(0x40 | rexB);
+    movBytes.insert(movBytes.end(), {
+        static_cast<unsigned char>(0xb8 | low), GET_BYTES(blockID)});
+    auto movInstr = Disassemble::instruction(movBytes);
+
+    std::vector<unsigned char> xorBytes{0x65};
+    if(rexR) xorBytes.push_back(0x40 | rexR);
+    xorBytes.insert(xorBytes.end(), {0x33,
+        static_cast<unsigned char>(0x04 | (low << 3)), 0x25,
+        GET_BYTES(SHM_PREV_LOC)});
+    auto xorInstr = Disassemble::instruction(xorBytes);
+
+    std::vector<unsigned char> incBytes;
+    if(rexB) incBytes.push_back(0x40 | rexB);
+    incBytes.insert(incBytes.end(), {0xfe,
+        static_cast<unsigned char>(0x80 | low), GET_BYTES(SHM_REGION)});
+    auto incInstr = Disassemble::instruction(incBytes);
+
+    auto storeInstr = Disassemble::instruction({0x65, 0xc7, 0x04, 0x25,
+        GET_BYTES(SHM_PREV_LOC), GET_BYTES(blockID >> 1)});
+
+    return std::vector<Instruction *>{
+        movInstr, xorInstr, incInstr, storeInstr };
+}
+
 #undef GET_BYTE
 #undef GET_BYTES
@@ -1,20 +1,45 @@
 #ifndef EGALITO_PASS_AFL_COVERAGE_H
 #define EGALITO_PASS_AFL_COVERAGE_H
 
+#include <set>
+#include <vector>
 #include "chunkpass.h"
 
 class AFLCoveragePass : public ChunkPass {
+public:
+    enum Mode {
+        MODE_QUEUE,     // shifted history of block IDs in the control page
+        MODE_EDGE       // afl-gcc style cur ^ prev edges, prev at %gs:0x8
+    };
 private:
+    Mode mode;
     Function *entryPoint;
     unsigned long blockID;
+    std::set<Block *> implied;
+    unsigned long instrumented, skipped;
 public:
-    AFLCoveragePass() : blockID(1) {}
+    AFLCoveragePass(Mode mode = MODE_QUEUE) : mode(mode), blockID(1),
+        instrumented(0), skipped(0) {}
     virtual void visit(Program *program);
     virtual void visit(Module *module);
     virtual void visit(Function *function);
     virtual void visit(Block *block);
+
+    /** Blocks whose only predecessor always continues into them, so that
+        the predecessor's counter already records that they ran. Jump table
+        targets and blocks whose address is taken are never implied, and
+        neither is any block of a function with an unresolved indirect jump.
+    */
+    static std::set<Block *> findImpliedBlocks(Function *function);
+
+    /** The MODE_EDGE counter for blockID, clobbering the physical register
+        reg (see X86Register) and the flags.
+    */
+    static std::vector<Instruction *> makeEdgeCoverageCode(int reg,
+        unsigned long blockID);
 private:
     void addCoverageCode(Block *block);
+    void addEdgeCoverageCode(Block *block);
 };
 
 
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <map>
+#include <capstone/capstone.h>
+#include "blockreorder.h"
+#include "analysis/blockexit.h"
+#include "analysis/edgeprofile.h"
+#include "operation/mutator.h"
+#include "instr/concrete.h"
+#include "log/log.h"
+
+void BlockReorderPass::visit(Module *module) {
+    reordered = 0;
+    recurse(module);
+    LOG(1, "reordered blocks in " << reordered << " functions of ["
+        << module->getName() << "]");
+}
+
+void BlockReorderPass::visit(Function *function) {
+#ifdef ARCH_X86_64
+    auto counts = profile->getCounts(function);
+    if(!counts) return;
+
+    std::vector<Block *> blocks;
+    for(auto block : CIter::children(function)) blocks.push_back(block);
+    if(blocks.size() < 2) return;
+
+    // indices would not match; the profile is from a different build
+    if(counts->block.size() != blocks.size()) {
+        LOG(1, "edge profile for [" << function->getName()
+            << "] does not match its blocks, skipping");
+        return;
+    }
+
+    std::vector<BlockExit> exits;
+    for(auto block : blocks) {
+        if(block->getChildren()->getIterable()->getCount() == 0) return;
+        exits.emplace_back(block);
+        // its target could move out of reach
+        if(exits.back().isShortOnly()) return;
+    }
+    if(exits.back().fallsOutOfFunction()) return;
+
+    auto order = computeLayout(function, blocks, exits);
+    bool changed = false;
+    for(size_t i = 0; i < order.size(); i ++) {
+        if(order[i] != i) changed = true;
+    }
+    if(!changed) return;
+
+    std::vector<Block *> layout;
+    for(auto i : order) layout.push_back(blocks[i]);
+
+    auto added = relayout(function, layout);
+    reordered ++;
+    LOG(10, "reordered " << blocks.size() << " blocks of ["
+        << function->getName() << "], " << added << " jumps added");
+#endif
+}
+
+std::vector<size_t> BlockReorderPass::computeLayout(Function *function,
+    const std::vector<Block *> &blocks, const std::vector<BlockExit> &exits) {
+
+    auto counts = profile->getCounts(function);
+    std::map<Block *, size_t> indexOf;
+    for(size_t i = 0; i < blocks.size(); i ++) indexOf[blocks[i]] = i;
+
+    struct Edge {
+        size_t from, to;
+        unsigned long weight;
+    };
+    std::vector<Edge> edges;
+    for(size_t i = 0; i < blocks.size(); i ++) {
+        auto count = counts->block[i];
+        auto taken = (i < counts->taken.size() ? counts->taken[i] : 0);
+        if(taken > count) taken = count;
+
+        auto target = exits[i].getTarget();
+        auto fallThrough = exits[i].getFallThrough();
+        switch(exits[i].getKind()) {
+        case BlockExit::EXIT_FALLTHROUGH:
+            if(fallThrough) edges.push_back({i, indexOf[fallThrough], count});
+            break;
+        case BlockExit::EXIT_JUMP:
+            if(target) edges.push_back({i, indexOf[target], count});
+            break;
+        case BlockExit::EXIT_CONDITIONAL:
+            if(target) edges.push_back({i, indexOf[target], taken});
+            if(fallThrough) {
+                edges.push_back({i, indexOf[fallThrough], count - taken});
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    std::stable_sort(edges.begin(), edges.end(),
+        [] (const Edge &a, const Edge &b) { return a.weight > b.weight; });
+
+    // every block starts as its own chain
+    std::vector<std::vector<size_t>> chains(blocks.size());
+    std::vector<size_t> chainOf(blocks.size());
+    for(size_t i = 0; i < blocks.size(); i ++) {
+        chains[i].push_back(i);
+        chainOf[i] = i;
+    }
+    for(auto &edge : edges) {
+        if(edge.weight == 0) break;
+        if(edge.to == 0) continue;  // the entry block stays first
+
+        auto a = chainOf[edge.from];
+        auto b = chainOf[edge.to];
+        if(a == b) continue;
+        if(chains[a].back() != edge.from) continue;
+        if(chains[b].front() != edge.to) continue;
+
+        for(auto i : chains[b]) {
+            chains[a].push_back(i);
+            chainOf[i] = a;
+        }
+        chains[b].clear();
+    }
+
+    // entry chain first, then hot chains, then cold ones in original order
+    std::vector<std::pair<double, size_t>> rest;
+    for(size_t c = 0; c < chains.size(); c ++) {
+        if(chains[c].empty() || c == chainOf[0]) continue;
+
+        double heat = 0;
+        for(auto i : chains[c]) heat += counts->block[i];
+        rest.push_back({heat / chains[c].size(), c});
+    }
+    std::stable_sort(rest.begin(), rest.end(),
+        [&chains] (const std::pair<double, size_t> &a,
+            const std::pair<double, size_t> &b) {
+
+            if(a.first != b.first) return a.first > b.first;
+            return chains[a.second].front() < chains[b.second].front();
+        });
+
+    std::vector<size_t> order = chains[chainOf[0]];
+    for(auto &r : rest) {
+        order.insert(order.end(), chains[r.second].begin(),
+            chains[r.second].end());
+    }
+    return order;
+}
+
+size_t BlockReorderPass::relayout(Function *function,
+    const std::vector<Block *> &layout, size_t boundary) {
+
+    // repair control flow that relied on the old order
+    std::vector<Block *> withJumps;
+    for(size_t k = 0; k < layout.size(); k ++) {
+        auto block = layout[k];
+        auto next = (k + 1 < layout.size() && k + 1 != boundary
+            ? layout[k + 1] : nullptr);
+        BlockExit exit(block);
+        withJumps.push_back(block);
+
+        switch(exit.getKind()) {
+        case BlockExit::EXIT_CONDITIONAL:
+            if(next == exit.getFallThrough()) break;
+            if(exit.getTarget() && next == exit.getTarget()
+                && invertBranch(exit.getBranch(), exit.getFallThrough())) {
+
+                break;
+            }
+            withJumps.push_back(makeJumpBlock(exit.getFallThrough()));
+            break;
+        case BlockExit::EXIT_FALLTHROUGH:
+            if(next != exit.getFallThrough()) {
+                withJumps.push_back(makeJumpBlock(exit.getFallThrough()));
+            }
+            break;
+        case BlockExit::EXIT_JUMP:
+            if(next && next == exit.getTarget()
+                && block->getChildren()->getIterable()->getCount() > 1) {
+
+                ChunkMutator(block).remove(exit.getBranch());
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    applyLayout(function, withJumps);
+    return withJumps.size() - layout.size();
+}
+
+void BlockReorderPass::applyLayout(Function *function,
+    const std::vector<Block *> &layout) {
+
+    ChunkMutator m(function, true);
+    std::vector<Block *> old;
+    for(auto block : CIter::children(function)) old.push_back(block);
+    for(auto block : old) m.remove(block);
+
+    for(auto block : layout) {
+        delete block->getPosition();
+        block->setPosition(nullptr);
+        m.append(block);
+
+        // the first instruction was positioned after the old previous block
+        auto first = block->getChildren()->getIterable()->get(0);
+        delete first->getPosition();
+        first->setPosition(nullptr);
+        ChunkMutator(block, false).makePositionFor(first);
+    }
+}
+
+#ifdef ARCH_X86_64
+static const struct {
+    int id;
+    const char *mnemonic;
+} conditionCodes[16] = {
+    {X86_INS_JO,  "jo"},  {X86_INS_JNO, "jno"},
+    {X86_INS_JB,  "jb"},  {X86_INS_JAE, "jae"},
+    {X86_INS_JE,  "je"},  {X86_INS_JNE, "jne"},
+    {X86_INS_JBE, "jbe"}, {X86_INS_JA,  "ja"},
+    {X86_INS_JS,  "js"},  {X86_INS_JNS, "jns"},
+    {X86_INS_JP,  "jp"},  {X86_INS_JNP, "jnp"},
+    {X86_INS_JL,  "jl"},  {X86_INS_JGE, "jge"},
+    {X86_INS_JLE, "jle"}, {X86_INS_JG,  "jg"},
+};
+#endif
+
+bool BlockReorderPass::invertBranch(Instruction *branch, Block *newTarget) {
+#ifdef ARCH_X86_64
+    auto cfi = dynamic_cast<ControlFlowInstruction *>(branch->getSemantic());
+    if(!cfi || !newTarget) return false;
+
+    // condition codes come in pairs; the low bit negates
+    int cc = -1;
+    for(int i = 0; i < 16; i ++) {
+        if(conditionCodes[i].id == cfi->getId()) cc = i ^ 1;
+    }
+    if(cc < 0) return false;  // e.g. jrcxz
+
+    std::string opcode;
+    if(cfi->getDisplacementSize() == 1) {
+        opcode += static_cast<char>(0x70 | cc);
+    }
+    else {
+        opcode += '\x0f';
+        opcode += static_cast<char>(0x80 | cc);
+    }
+
+    auto newSem = new ControlFlowInstruction(conditionCodes[cc].id, branch,
+        opcode, conditionCodes[cc].mnemonic, cfi->getDisplacementSize());
+    newSem->setLink(new NormalLink(
+        newTarget->getChildren()->getIterable()->get(0),
+        Link::SCOPE_INTERNAL_JUMP));
+    branch->setSemantic(newSem);
+    delete cfi;
+    return true;
+#else
+    return false;
+#endif
+}
+
+Block *BlockReorderPass::makeJumpBlock(Block *target) {
+    auto jump = new Instruction();
+#ifdef ARCH_X86_64
+    auto semantic = new ControlFlowInstruction(
+        X86_INS_JMP, jump, "\xe9", "jmp", 4);
+    semantic->setLink(new NormalLink(
+        target->getChildren()->getIterable()->get(0),
+        Link::SCOPE_INTERNAL_JUMP));
+    jump->setSemantic(semantic);
+#endif
+
+    auto block = new Block();
+    ChunkMutator(block).append(jump);
+    return block;
+}
@@ -0,0 +1,51 @@
+#ifndef EGALITO_PASS_BLOCK_REORDER_H
+#define EGALITO_PASS_BLOCK_REORDER_H
+
+#include <vector>
+#include "chunkpass.h"
+
+class EdgeProfile;
+class BlockExit;
+
+/** Reorders the blocks of each profiled function (Pettis-Hansen). Hot
+    edges are turned into fallthroughs greedily, heaviest first; the
+    resulting chains are laid out entry first, then by decreasing heat.
+
+    Fallthroughs broken by the new order are repaired by inverting the
+    conditional jump or by inserting a jump block, and jumps that now
+    target the next block are removed.
+*/
+class BlockReorderPass : public ChunkPass {
+private:
+    EdgeProfile *profile;
+    size_t reordered;
+public:
+    BlockReorderPass(EdgeProfile *profile) : profile(profile), reordered(0) {}
+
+    virtual void visit(Module *module);
+    virtual void visit(Function *function);
+
+    /** Returns the new order of blocks (as indices), entry block first.
+        Blocks must be nonempty, with exits[i] describing blocks[i].
+    */
+    std::vector<size_t> computeLayout(Function *function,
+        const std::vector<Block *> &blocks,
+        const std::vector<BlockExit> &exits);
+
+    /** Puts the blocks of function in the given order, which must contain
+        each block exactly once. If boundary is nonzero, control never falls
+        from layout[boundary - 1] into layout[boundary], so that the layout
+        can be split there. Returns the number of jump blocks added.
+    */
+    static size_t relayout(Function *function,
+        const std::vector<Block *> &layout, size_t boundary = 0);
+
+    /** Replaces the blocks of function with layout, as is. */
+    static void applyLayout(Function *function,
+        const std::vector<Block *> &layout);
+private:
+    static bool invertBranch(Instruction *branch, Block *newTarget);
+    static Block *makeJumpBlock(Block *target);
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include <capstone/capstone.h>
+#include "collapsegot.h"
+#include "chunk/concrete.h"
+#include "chunk/link.h"
+#include "disasm/disassemble.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+void CollapseGOTPass::visit(Program *program) {
+    loads = calls = skipped = 0;
+    recurse(program);
+
+    LOG(1, "collapsed .got references: " << loads << " loads made lea, "
+        << calls << " indirect calls and jumps made direct, "
+        << skipped << " left as is");
+}
+
+void CollapseGOTPass::visit(Module *module) {
+    recurse(module->getFunctionList());
+}
+
+void CollapseGOTPass::visit(Instruction *instruction) {
+#ifdef ARCH_X86_64
+    auto semantic = instruction->getSemantic();
+    if(dynamic_cast<DataLinkedControlFlowInstruction *>(semantic)) {
+        collapseCall(instruction);
+    }
+    else if(dynamic_cast<LinkedInstruction *>(semantic)) {
+        collapseLoad(instruction);
+    }
+#endif
+}
+
+Link *CollapseGOTPass::getGOTEntry(Link *link) {
+    auto dol = dynamic_cast<DataOffsetLink *>(link);
+    if(!dol) return nullptr;
+
+    // .got is read-only after relocation, unlike .got.plt with lazy binding
+    auto section = dynamic_cast<DataSection *>(&*dol->getTarget());
+    if(!section || section->getName() != ".got") return nullptr;
+
+    auto var = section->findVariable(dol->getTargetAddress());
+    return var ? var->getDest() : nullptr;
+}
+
+Link *CollapseGOTPass::makeDirectLink(Link *entry, bool isJump) {
+    if(auto normal = dynamic_cast<NormalLinkBase *>(entry)) {
+        auto function = dynamic_cast<Function *>(&*normal->getTarget());
+        if(!function || function->isIFunc()) return nullptr;
+
+        return new NormalLink(function, isJump
+            ? Link::SCOPE_EXTERNAL_JUMP : Link::SCOPE_EXTERNAL_CODE);
+    }
+    if(isJump) return nullptr;
+
+    // may still be bound to another definition at runtime
+    if(dynamic_cast<InternalAndExternalDataLink *>(entry)) return nullptr;
+
+    if(auto data = dynamic_cast<DataOffsetLinkBase *>(entry)) {
+        auto section = dynamic_cast<DataSection *>(&*data->getTarget());
+        if(!section || dynamic_cast<TLSDataRegion *>(section->getParent())) {
+            return nullptr;
+        }
+
+        return new DataOffsetLink(section,
+            data->getTargetAddress() - section->getAddress(),
+            data->getScope());
+    }
+    return nullptr;
+}
+
+void CollapseGOTPass::collapseLoad(Instruction *instruction) {
+#ifdef ARCH_X86_64
+    auto linked = static_cast<LinkedInstruction *>(instruction->getSemantic());
+    auto entry = getGOTEntry(linked->getLink());
+    if(!entry) return;
+
+    // mov disp(%rip), %reg64, in AT&T operand order
+    auto assembly = linked->getAssembly();
+    auto asmOps = assembly ? assembly->getAsmOperands() : nullptr;
+    if(!assembly || assembly->getId() != X86_INS_MOV
+        || asmOps->getOpCount() != 2
+        || asmOps->getOperands()[0].type != X86_OP_MEM
+        || asmOps->getOperands()[0].mem.base != X86_REG_RIP
+        || asmOps->getOperands()[0].mem.segment != X86_REG_INVALID
+        || asmOps->getOperands()[1].type != X86_OP_REG
+        || asmOps->getOperands()[1].size != 8) {
+
+        skipped ++;
+        return;
+    }
+
+    // REX.W 8b /r becomes REX.W 8d /r, with the same ModRM and length
+    std::vector<unsigned char> bytes(linked->getData().begin(),
+        linked->getData().end());
+    if(bytes.size() != 7 || (bytes[0] & 0xf8) != 0x48 || bytes[1] != 0x8b) {
+        skipped ++;
+        return;
+    }
+
+    auto target = makeDirectLink(entry, false);
+    if(!target) {
+        skipped ++;
+        return;
+    }
+
+    bytes[1] = 0x8d;
+    DisasmHandle handle(true);
+    auto lea = new LinkedInstruction(instruction);
+    lea->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(bytes));
+    lea->setIndex(linked->getIndex(), linked->getDispSize(),
+        linked->getDispOffset());
+    lea->setLink(target);
+    instruction->setSemantic(lea);
+
+    LOG(10, "collapsed .got load at 0x" << std::hex
+        << instruction->getAddress() << " to lea of "
+        << target->getTarget()->getName());
+    // the old link is not freed, since it may be shared with other chunks
+    delete linked;
+    loads ++;
+#endif
+}
+
+void CollapseGOTPass::collapseCall(Instruction *instruction) {
+#ifdef ARCH_X86_64
+    auto dl = static_cast<DataLinkedControlFlowInstruction *>(
+        instruction->getSemantic());
+    auto entry = getGOTEntry(dl->getLink());
+    if(!entry) return;
+
+    auto target = makeDirectLink(entry, true);
+    if(!target) {
+        skipped ++;
+        return;
+    }
+
+    auto semantic = dl->isCall()
+        ? new ControlFlowInstruction(X86_INS_CALL, instruction,
+            "\xe8", "callq", 4)
+        : new ControlFlowInstruction(X86_INS_JMP, instruction,
+            "\xe9", "jmp", 4);
+    semantic->setLink(target);
+    auto oldSize = dl->getSize();
+    instruction->setSemantic(semantic);
+    ChunkMutator(instruction->getParent()).modifiedChildSize(instruction,
+        semantic->getSize() - oldSize);
+
+    LOG(10, "collapsed .got call at 0x" << std::hex
+        << instruction->getAddress() << " to "
+        << target->getTarget()->getName());
+    // the old link is not freed, since it may be shared with other chunks
+    delete dl;
+    calls ++;
+#endif
+}
@@ -0,0 +1,38 @@
+#ifndef EGALITO_PASS_COLLAPSE_GOT_H
+#define EGALITO_PASS_COLLAPSE_GOT_H
+
+#include "chunkpass.h"
+
+class Link;
+
+/** Removes loads from .got whose value is known at generation time, for
+    union (whole-program) output where every target is within rel32 reach.
+
+        mov sym@GOTPCREL(%rip), %reg  ->  lea sym(%rip), %reg
+        call *sym@GOTPCREL(%rip)      ->  call sym
+        jmp *sym@GOTPCREL(%rip)       ->  jmp sym
+
+    Run after CollapsePLTPass, which redirects .got entries of known IFUNCs
+    to their implementation; other IFUNCs are left alone. This whole pass
+    is x86_64-specific.
+*/
+class CollapseGOTPass : public ChunkPass {
+private:
+    unsigned long loads, calls, skipped;
+public:
+    CollapseGOTPass() : loads(0), calls(0), skipped(0) {}
+    virtual void visit(Program *program);
+    virtual void visit(Module *module);
+    virtual void visit(Instruction *instruction);
+
+    unsigned long getLoadsRemoved() const { return loads; }
+    unsigned long getCallsRemoved() const { return calls; }
+private:
+    /** Returns the resolved .got entry that link refers to, or null. */
+    static Link *getGOTEntry(Link *link);
+    static Link *makeDirectLink(Link *entry, bool isJump);
+    void collapseLoad(Instruction *instruction);
+    void collapseCall(Instruction *instruction);
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "conductor/conductor.h"
 #include "instr/semantic.h"
 #include "operation/find2.h"
+#include "operation/mutator.h"
 #include "log/log.h"
 #include "log/temp.h"
 
@@ -37,7 +38,7 @@ static Function *findFunction(Conductor *conductor, const char *name) {
 }
 
 CollapsePLTPass::CollapsePLTPass(Conductor *conductor)
-    : conductor(conductor) {
+    : conductor(conductor), direct(0), ifuncs(0), unresolved(0) {
 
     //TemporaryLogLevel tll("pass", 20);
     Function *function = nullptr;
@@ -64,8 +65,13 @@ CollapsePLTPass::CollapsePLTPass(Conductor *conductor)
 void CollapsePLTPass::visit(Module *module) {
     //TemporaryLogLevel tll("pass", 20);
 
+    direct = ifuncs = unresolved = 0;
     recurse(module);
     recurse(module->getDataRegionList());
+
+    LOG(1, "collapsed PLT calls in [" << module->getName() << "]: "
+        << direct << " made direct, " << ifuncs << " IFuncs resolved, "
+        << unresolved << " left as is");
 }
 
 void CollapsePLTPass::visit(Instruction *instr) {
@@ -83,9 +89,12 @@ void CollapsePLTPass::visit(Instruction *instr) {
                 instr->getSemantic()->setLink(
                     new NormalLink(it->second, Link::SCOPE_EXTERNAL_JUMP));
                 delete pltLink;
+                ChunkMutator(instr, false).markFunctionDirty();
+                ifuncs ++;
             }
             else {
                 LOG(10, "IFunc " << name << " will be resolved at runtime");
+                unresolved ++;
             }
             return;  // we don't handle this yet
         }
@@ -94,8 +103,11 @@ void CollapsePLTPass::visit(Instruction *instr) {
             instr->getSemantic()->setLink(
                 new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
             delete pltLink;
+            ChunkMutator(instr, false).markFunctionDirty();
+            direct ++;
         }
         else {
+            unresolved ++;
             assert(trampoline->getExternalSymbol());
             LOG(9, "Unresolved PLT entry from " << instr->getName()
                 << " to [" << trampoline->getExternalSymbol()->getName() << "]");
@@ -11,6 +11,7 @@ class CollapsePLTPass : public ChunkPass {
 private:
     Conductor *conductor;
     std::map<std::string, Function*> ifuncMap;
+    unsigned long direct, ifuncs, unresolved;
 public:
     CollapsePLTPass(Conductor *conductor);
     virtual void visit(Module *module);
@@ -0,0 +1,216 @@
+#include <cstring>  // for std::strcpy
+#include <capstone/capstone.h>
+#include "edgeprofileinstrument.h"
+#include "analysis/blockexit.h"
+#include "operation/addinline.h"
+#include "operation/mutator.h"
+#include "disasm/disassemble.h"
+#include "chunk/module.h"
+#include "instr/concrete.h"
+#include "log/log.h"
+
+#define DATA_REGION_ADDRESS 0x32000000
+#define DATA_NAMEREGION_ADDRESS 0x33000000
+
+const char *const EdgeProfileInstrumentPass::EDGE_SECTION_NAME
+    = ".profiling.edges";
+const char *const EdgeProfileInstrumentPass::EDGE_NAMESECTION_NAME
+    = ".profiling.edges.names";
+const char *const EdgeProfileInstrumentPass::EDGE_DATA_FILENAME
+    = "edges.data";
+
+void EdgeProfileInstrumentPass::visit(Function *function) {
+#ifdef ARCH_X86_64
+    if(!shouldInstrument(function)) return;
+
+    std::vector<Block *> blocks;
+    for(auto block : CIter::children(function)) blocks.push_back(block);
+
+    // the trampolines go after the last block, which must not fall out
+    bool canAppend = !BlockExit(blocks.back()).fallsOutOfFunction();
+
+    counters.clear();
+    std::vector<std::pair<Instruction *, size_t>> takenPoints;
+    for(size_t i = 0; canAppend && i < blocks.size(); i ++) {
+        BlockExit exit(blocks[i]);
+        if(exit.getKind() != BlockExit::EXIT_CONDITIONAL) continue;
+        if(!exit.getTarget()) continue;
+        if(exit.isShortOnly()) continue;  // the trampoline may be too far
+
+        auto trampoline = makeTakenTrampoline(function, exit.getBranch(),
+            exit.getTarget());
+        takenPoints.emplace_back(
+            trampoline->getChildren()->getIterable()->get(0), i);
+    }
+
+    for(size_t i = 0; i < blocks.size(); i ++) {
+        auto first = blocks[i]->getChildren()->getIterable()->get(0);
+        addCounter(first, function, i, "block");
+    }
+    for(auto point : takenPoints) {
+        addCounter(point.first, function, point.second, "taken");
+    }
+
+    {
+        ChunkMutator(function, true);
+    }
+    for(auto sem : counters) sem->regenerateAssembly();
+
+    LOG(1, "adding edge profiling to function [" << function->getName()
+        << "], " << blocks.size() << " blocks, "
+        << takenPoints.size() << " branches");
+#endif
+}
+
+bool EdgeProfileInstrumentPass::shouldInstrument(Function *function) {
+    if(function->getName() == "_init") return false;
+    if(function->getName() == "_fini") return false;
+    if(function->getName() == "__libc_csu_init") return false;
+    if(function->getName() == "__libc_csu_fini") return false;
+
+    for(auto block : CIter::children(function)) {
+        if(block->getChildren()->getIterable()->getCount() == 0) return false;
+    }
+    return function->getChildren()->getIterable()->getCount() > 0;
+}
+
+Block *EdgeProfileInstrumentPass::makeTakenTrampoline(Function *function,
+    Instruction *branch, Block *target) {
+
+    auto jump = new Instruction();
+#ifdef ARCH_X86_64
+    auto jumpSem = new ControlFlowInstruction(
+        X86_INS_JMP, jump, "\xe9", "jmp", 4);
+    jumpSem->setLink(new NormalLink(
+        target->getChildren()->getIterable()->get(0),
+        Link::SCOPE_INTERNAL_JUMP));
+    jump->setSemantic(jumpSem);
+#endif
+
+    auto trampoline = new Block();
+    {
+        ChunkMutator(trampoline).append(jump);
+        ChunkMutator(function).append(trampoline);
+    }
+
+    // PromoteJumpsPass widens the branch later if needed
+    auto cfi = static_cast<ControlFlowInstruction *>(branch->getSemantic());
+    delete cfi->getLink();
+    cfi->setLink(new NormalLink(jump, Link::SCOPE_INTERNAL_JUMP));
+    return trampoline;
+}
+
+void EdgeProfileInstrumentPass::addCounter(Instruction *point,
+    Function *function, size_t index, const char *kind) {
+
+    auto module = static_cast<Module *>(function->getParent()->getParent());
+    auto sectionPair = createDataSection(module);
+    std::string name = function->getName() + " " + std::to_string(index)
+        + " " + kind;
+    // the same function name may occur in several modules
+    std::string fullName = name + " " + module->getName();
+
+    // block boundaries may be crossed by live flags
+    ChunkAddInline ai({X86_REG_EFLAGS}, [this, sectionPair, name, fullName]
+        (unsigned int stackBytesAdded) {
+
+        //  48 ff 05 00 00 00 00    incq   0x0(%rip)
+        DisasmHandle handle(true);
+        auto instr = new Instruction();
+        auto sem = new LinkedInstruction(instr);
+        sem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
+            std::vector<unsigned char>{0x48, 0xff, 0x05, 0x00, 0x00, 0x00, 0x00}));
+        sem->setLink(addVariable(sectionPair.first, name));
+        sem->setIndex(0);
+        instr->setSemantic(sem);
+        appendName(sectionPair.second, fullName);
+        counters.push_back(sem);
+
+        return std::vector<Instruction *>{ instr };
+    });
+    ai.insertBefore(point, true);
+}
+
+std::pair<DataSection *, DataSection *> EdgeProfileInstrumentPass
+    ::createDataSection(Module *module) {
+
+    auto regionList = module->getDataRegionList();
+    if(auto section = regionList->findDataSection(EDGE_SECTION_NAME)) {
+        if(auto nameSection
+            = regionList->findDataSection(EDGE_NAMESECTION_NAME)) {
+
+            return std::make_pair(section, nameSection);
+        }
+    }
+
+    auto region = new DataRegion(DATA_REGION_ADDRESS);
+    region->setPosition(new AbsolutePosition(DATA_REGION_ADDRESS));
+    regionList->getChildren()->add(region);
+    region->setParent(regionList);
+
+    auto section = new DataSection();
+    section->setName(EDGE_SECTION_NAME);
+    section->setAlignment(0x8);
+    section->setPermissions(SHF_WRITE | SHF_ALLOC);
+    section->setPosition(new AbsoluteOffsetPosition(section, 0));
+    section->setType(DataSection::TYPE_DATA);
+    region->getChildren()->add(section);
+    section->setParent(region);
+
+    auto nameRegion = new DataRegion(DATA_NAMEREGION_ADDRESS);
+    nameRegion->setPosition(new AbsolutePosition(DATA_NAMEREGION_ADDRESS));
+    regionList->getChildren()->add(nameRegion);
+    nameRegion->setParent(regionList);
+
+    auto nameSection = new DataSection();
+    nameSection->setName(EDGE_NAMESECTION_NAME);
+    nameSection->setAlignment(0x1);
+    nameSection->setPermissions(SHF_ALLOC);
+    nameSection->setPosition(new AbsoluteOffsetPosition(nameSection, 0));
+    nameSection->setType(DataSection::TYPE_DATA);
+    nameRegion->getChildren()->add(nameSection);
+    nameSection->setParent(nameRegion);
+
+    return std::make_pair(section, nameSection);
+}
+
+Link *EdgeProfileInstrumentPass::addVariable(DataSection *section,
+    const std::string &name) {
+
+    auto region = static_cast<DataRegion *>(section->getParent());
+    auto offset = section->getSize();
+
+    const size_t VAR_SIZE = 8;
+
+    std::string varName = "__edge_" + name;
+    for(auto &c : varName) if(c == ' ') c = '_';
+    auto var = new GlobalVariable(varName);
+    var->setPosition(new AbsolutePosition(section->getAddress()+section->getSize()));
+
+    char *symbolName = new char[varName.length() + 1];
+    std::strcpy(symbolName, varName.c_str());
+
+    auto nsymbol = new Symbol(
+        var->getAddress(), VAR_SIZE, symbolName,
+        Symbol::TYPE_OBJECT, Symbol::BIND_LOCAL, 0, 0);
+    var->setSymbol(nsymbol);
+
+    section->addGlobalVariable(var);
+
+    section->setSize(section->getSize() + VAR_SIZE);
+    region->setSize(region->getSize() + VAR_SIZE);
+
+    return new DataOffsetLink(section, offset, Link::SCOPE_INTERNAL_DATA);
+}
+
+void EdgeProfileInstrumentPass::appendName(DataSection *nameSection,
+    const std::string &name) {
+
+    auto region = static_cast<DataRegion *>(nameSection->getParent());
+    region->setSize(region->getSize() + name.length() + 1);
+    nameSection->setSize(nameSection->getSize() + name.length() + 1);
+
+    auto bytes = region->getDataBytes();
+    bytes.append(name.c_str(), name.length() + 1);
+    region->saveDataBytes(bytes);
+}
@@ -0,0 +1,38 @@
+#ifndef EGALITO_PASS_EDGE_PROFILE_INSTRUMENT_H
+#define EGALITO_PASS_EDGE_PROFILE_INSTRUMENT_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "chunkpass.h"
+#include "chunk/dataregion.h"
+
+class LinkedInstruction;
+
+/** Adds a counter to the start of every block, and one to the taken side
+    of every conditional jump within a function, in the style of
+    ProfileInstrumentPass. Fallthrough counts are block count minus taken
+    count. Use ProfileSavePass with EDGE_SECTION_NAME etc. to write the
+    counters out at exit; etprofile -e converts them to an EdgeProfile.
+*/
+class EdgeProfileInstrumentPass : public ChunkPass {
+public:
+    static const char *const EDGE_SECTION_NAME;
+    static const char *const EDGE_NAMESECTION_NAME;
+    static const char *const EDGE_DATA_FILENAME;
+private:
+    std::vector<LinkedInstruction *> counters;
+public:
+    virtual void visit(Function *function);
+private:
+    bool shouldInstrument(Function *function);
+    Block *makeTakenTrampoline(Function *function, Instruction *branch,
+        Block *target);
+    void addCounter(Instruction *point, Function *function, size_t index,
+        const char *kind);
+    std::pair<DataSection *, DataSection*> createDataSection(Module *module);
+    Link *addVariable(DataSection *section, const std::string &name);
+    void appendName(DataSection *nameSection, const std::string &name);
+};
+
+#endif
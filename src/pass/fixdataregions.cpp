@@ -1,13 +1,36 @@
 #include <typeinfo>
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include "fixdataregions.h"
+#include "chunk/position.h"
 #include "elf/symbol.h"
 #include "log/log.h"
 #include "log/temp.h"
 
+void FixDataRegionsPass::setThreadCount(size_t count) {
+    if(count == 0) count = std::thread::hardware_concurrency();
+    this->threadCount = std::max(count, static_cast<size_t>(1));
+}
+
 void FixDataRegionsPass::visit(Program *program) {
     this->program = program;
-    recurse(program);
+
+    std::vector<Module *> modules;
+    for(auto module : CIter::children(program)) {
+        modules.push_back(module);
+    }
+    // generational positions recalculate (and store) stale addresses on
+    // read, which is not safe to do from several threads at once
+    if(threadCount > 1 && modules.size() > 1
+        && !PositionFactory::getInstance()->needsGenerationTracking()) {
+
+        fixInParallel(modules);
+    }
+    else {
+        recurse(program);
+    }
 }
 
 void FixDataRegionsPass::visit(Module *module) {
@@ -27,27 +50,79 @@ void FixDataRegionsPass::visit(DataRegion *dataRegion) {
 #endif
 
     for(auto dsec : CIter::children(dataRegion)) {
-        for(auto var : CIter::children(dsec)) {
-            if(!var->getDest()) continue;
-            if(var->getIsCopy()) continue;
-            if(isForIFuncJumpSlot(var)) continue;
-
-            auto target = var->getDest()->getTargetAddress();
-            address_t address = var->getAddress();
-            LOG(8, "set variable " << std::hex << address << " => " << target << " (size " << var->getSize() << ")");
-            if(var->getSize() == sizeof(address_t)) {
-                *reinterpret_cast<address_t *>(address) = target;
-            }
-            else if(var->getSize() == 4) {
-                *reinterpret_cast<uint32_t *>(address) = target;
-            }
-            else if(var->getSize() == 2) {
-                *reinterpret_cast<uint16_t *>(address) = target;
-            }
-            else {
-                assert(var->getSize() == 1);
-                *reinterpret_cast<uint8_t *>(address) = target;
+        fixSection(makeRelocations(dsec));
+    }
+}
+
+void FixDataRegionsPass::fixInParallel(const std::vector<Module *> &modules) {
+    // Modules own disjoint data pages, so they can be written concurrently.
+    // Library sizes vary a lot; threads pull the next module from a queue.
+    const size_t count = std::min(threadCount, modules.size());
+    LOG(1, "fixing data regions of " << std::dec << modules.size()
+        << " modules on " << count << " threads");
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < count; t ++) {
+        threads.emplace_back([&modules, &next] () {
+            for(size_t i = next++; i < modules.size(); i = next++) {
+                fixModule(modules[i]);
             }
+        });
+    }
+    for(auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void FixDataRegionsPass::fixModule(Module *module) {
+    for(auto region : CIter::regions(module)) {
+        for(auto dsec : CIter::children(region)) {
+            fixSection(makeRelocations(dsec));
+        }
+    }
+}
+
+auto FixDataRegionsPass::makeRelocations(DataSection *section)
+    -> std::vector<Relocation> {
+
+    const auto &variables = section->getVariablesInOrder();
+    std::vector<Relocation> list;
+    list.reserve(variables.size());
+    for(auto var : variables) {
+        if(!var->getDest()) continue;
+        if(var->getIsCopy()) continue;
+        if(isForIFuncJumpSlot(var)) continue;
+
+        list.push_back({var->getAddress(), var->getDest()->getTargetAddress(),
+            var->getSize()});
+    }
+    return list;
+}
+
+void FixDataRegionsPass::fixSection(const std::vector<Relocation> &list) {
+    const size_t PREFETCH_DISTANCE = 8;
+    for(size_t i = 0; i < list.size(); i ++) {
+        if(i + PREFETCH_DISTANCE < list.size()) {
+            __builtin_prefetch(reinterpret_cast<void *>(
+                list[i + PREFETCH_DISTANCE].address), 1);
+        }
+
+        const auto &reloc = list[i];
+        LOG(8, "set variable " << std::hex << reloc.address << " => "
+            << reloc.value << " (size " << reloc.size << ")");
+        if(reloc.size == sizeof(address_t)) {
+            *reinterpret_cast<address_t *>(reloc.address) = reloc.value;
+        }
+        else if(reloc.size == 4) {
+            *reinterpret_cast<uint32_t *>(reloc.address) = reloc.value;
+        }
+        else if(reloc.size == 2) {
+            *reinterpret_cast<uint16_t *>(reloc.address) = reloc.value;
+        }
+        else {
+            assert(reloc.size == 1);
+            *reinterpret_cast<uint8_t *>(reloc.address) = reloc.value;
         }
     }
 }
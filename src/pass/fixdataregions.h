@@ -1,21 +1,48 @@
 #ifndef EGALITO_PASS_FIX_DATA_REGIONS_H
 #define EGALITO_PASS_FIX_DATA_REGIONS_H
 
+#include <vector>
 #include "chunkpass.h"
 
 class DataVariable;
 
+/** Writes the current target of every DataVariable into mapped memory.
+
+    Each DataSection is first flattened into an array of (address, value,
+    size), in the address order the section keeps for its variables, so the
+    writes are a tight loop that moves through the section page by page.
+    Modules are independent, and with setThreadCount() they are fixed on
+    several threads. Link::getTargetAddress() is then called concurrently;
+    it only reads the Chunk tree, except with generational positions (which
+    update stale addresses lazily), so those are always fixed on one thread.
+*/
 class FixDataRegionsPass : public ChunkPass {
 private:
+    struct Relocation {
+        address_t address;
+        address_t value;
+        size_t size;
+    };
+
     Program *program;
     Module *module;
+    size_t threadCount;
 public:
+    FixDataRegionsPass() : program(nullptr), module(nullptr), threadCount(1) {}
+
+    /** 0 = one thread per core. */
+    void setThreadCount(size_t count);
+
     virtual void visit(Program *program);
     virtual void visit(Module *module);
     virtual void visit(DataRegionList *dataRegionList);
     virtual void visit(DataRegion *dataRegion);
 private:
-    bool isForIFuncJumpSlot(DataVariable *var);
+    void fixInParallel(const std::vector<Module *> &modules);
+    static void fixModule(Module *module);
+    static std::vector<Relocation> makeRelocations(DataSection *section);
+    static void fixSection(const std::vector<Relocation> &list);
+    static bool isForIFuncJumpSlot(DataVariable *var);
 };
 
 #endif
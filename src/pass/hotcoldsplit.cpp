@@ -0,0 +1,138 @@
+#include "hotcoldsplit.h"
+#include "blockreorder.h"
+#include "analysis/blockexit.h"
+#include "analysis/edgeprofile.h"
+#include "chunk/link.h"
+#include "chunk/position.h"
+#include "operation/mutator.h"
+#include "instr/semantic.h"
+#include "log/log.h"
+
+void HotColdSplitPass::visit(Module *module) {
+    splitList.clear();
+    coldFunctions = 0;
+    recurse(module);
+
+    // adds to the function list, so not done while iterating over it
+    for(auto function : splitList) split(function);
+
+    LOG(1, "split " << splitList.size() << " functions of ["
+        << module->getName() << "], " << coldFunctions
+        << " never executed");
+}
+
+void HotColdSplitPass::visit(Function *function) {
+#ifdef ARCH_X86_64
+    auto counts = profile->getCounts(function);
+    if(!counts || counts->block.empty()) return;
+
+    if(counts->block[0] == 0) {
+        function->setCold(true);
+        coldFunctions ++;
+        return;
+    }
+
+    size_t blockCount = function->getChildren()->getIterable()->getCount();
+    if(counts->block.size() != blockCount) {
+        LOG(1, "edge profile for [" << function->getName()
+            << "] does not match its blocks, skipping");
+        return;
+    }
+
+    for(size_t i = 1; i < blockCount; i ++) {
+        if(counts->block[i] == 0) {
+            splitList.push_back(function);
+            return;
+        }
+    }
+    if(reorderBlocks) BlockReorderPass(profile).visit(function);
+#endif
+}
+
+void HotColdSplitPass::split(Function *function) {
+    auto counts = profile->getCounts(function);
+
+    std::vector<Block *> blocks;
+    std::vector<BlockExit> exits;
+    for(auto block : CIter::children(function)) {
+        if(block->getChildren()->getIterable()->getCount() == 0) return;
+        blocks.push_back(block);
+        exits.emplace_back(block);
+        // its target could move out of reach
+        if(exits.back().isShortOnly()) return;
+    }
+    if(exits.back().fallsOutOfFunction()) return;
+
+    std::vector<size_t> order;
+    if(reorderBlocks) {
+        order = BlockReorderPass(profile).computeLayout(
+            function, blocks, exits);
+    }
+    else {
+        for(size_t i = 0; i < blocks.size(); i ++) order.push_back(i);
+    }
+
+    // hot blocks first, then the cold ones in their original order
+    std::vector<Block *> layout, cold;
+    for(auto i : order) {
+        if(i == 0 || counts->block[i]) layout.push_back(blocks[i]);
+    }
+    for(size_t i = 1; i < blocks.size(); i ++) {
+        if(!counts->block[i]) cold.push_back(blocks[i]);
+    }
+    auto boundary = layout.size();
+    layout.insert(layout.end(), cold.begin(), cold.end());
+
+    auto added = BlockReorderPass::relayout(function, layout, boundary);
+    auto coldFunction = makeColdFunction(function, cold.front());
+    fixLinkScopes(function);
+    fixLinkScopes(coldFunction);
+
+    LOG(10, "moved " << cold.size() << " of " << blocks.size()
+        << " blocks of [" << function->getName() << "] to ["
+        << coldFunction->getName() << "], " << added << " jumps added");
+}
+
+Function *HotColdSplitPass::makeColdFunction(Function *function,
+    Block *point) {
+
+    std::vector<Block *> moved;
+    for(auto block : CIter::children(function)) {
+        if(block == point || !moved.empty()) moved.push_back(block);
+    }
+    {
+        ChunkMutator m(function, true);
+        for(auto block : moved) m.remove(block);
+    }
+
+    auto coldFunction = new Function(function->getName() + ".cold");
+    coldFunction->setPosition(new AbsolutePosition(
+        function->getAddress() + function->getSize()));
+    coldFunction->setCold(true);
+
+    auto functionList = static_cast<FunctionList *>(function->getParent());
+    ChunkMutator(functionList).append(coldFunction);
+
+    BlockReorderPass::applyLayout(coldFunction, moved);
+    return coldFunction;
+}
+
+void HotColdSplitPass::fixLinkScopes(Function *function) {
+    // jumps between the two halves no longer stay within one function
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            auto link = dynamic_cast<LinkImpl *>(
+                instr->getSemantic()->getLink());
+            if(!link || link->getScope() != Link::SCOPE_INTERNAL_JUMP) {
+                continue;
+            }
+
+            auto target = dynamic_cast<Instruction *>(link->getTarget());
+            if(target && target->getParent()
+                && target->getParent()->getParent() != function) {
+
+                link->setScope(Link::SCOPE_EXTERNAL_JUMP);
+            }
+        }
+    }
+}
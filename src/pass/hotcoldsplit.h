@@ -0,0 +1,39 @@
+#ifndef EGALITO_PASS_HOT_COLD_SPLIT_H
+#define EGALITO_PASS_HOT_COLD_SPLIT_H
+
+#include <vector>
+#include "chunkpass.h"
+
+class EdgeProfile;
+
+/** Moves code that never ran according to an edge profile out of the way.
+
+    Profiled functions that were never entered are marked cold as a whole.
+    In the others, blocks that were never reached are moved to the end and
+    split off into a new function "name.cold", like GCC does. Branches
+    between the two parts become external jumps, so PromoteJumpsPass
+    widens them. The generator places all cold functions after the rest of
+    the code, in a separate .text.cold section of the output ELF.
+
+    With reorderBlocks, hot blocks are also laid out as by BlockReorderPass
+    (which cannot run afterwards, since block indices no longer match).
+*/
+class HotColdSplitPass : public ChunkPass {
+private:
+    EdgeProfile *profile;
+    bool reorderBlocks;
+    std::vector<Function *> splitList;
+    size_t coldFunctions;
+public:
+    HotColdSplitPass(EdgeProfile *profile, bool reorderBlocks = false)
+        : profile(profile), reorderBlocks(reorderBlocks), coldFunctions(0) {}
+
+    virtual void visit(Module *module);
+    virtual void visit(Function *function);
+private:
+    void split(Function *function);
+    Function *makeColdFunction(Function *function, Block *point);
+    void fixLinkScopes(Function *function);
+};
+
+#endif
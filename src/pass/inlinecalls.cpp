@@ -0,0 +1,281 @@
+#include <capstone/capstone.h>
+#include "inlinecalls.h"
+#include "analysis/blockexit.h"
+#include "analysis/edgeprofile.h"
+#include "chunk/link.h"
+#include "disasm/disassemble.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+void InlineCallsPass::visit(Module *module) {
+    callSites.clear();
+    inlinable.clear();
+    recurse(module);
+
+    // call sites are collected first, since inlining changes the blocks
+    // that the profile's indices refer to
+    for(auto call : callSites) {
+        inlineAt(call, getCallee(call));
+    }
+    LOG(1, "inlined " << callSites.size() << " call sites in ["
+        << module->getName() << "]");
+}
+
+void InlineCallsPass::visit(Function *function) {
+#ifdef ARCH_X86_64
+    auto counts = profile->getCounts(function);
+    if(!counts || counts->block.size()
+        != function->getChildren()->getIterable()->getCount()) return;
+
+    size_t i = 0;
+    for(auto block : CIter::children(function)) {
+        if(counts->block[i ++] < minCount) continue;
+
+        for(auto instr : CIter::children(block)) {
+            auto callee = getCallee(instr);
+            if(!callee || callee == function) continue;
+            if(callee->getParent() != function->getParent()) continue;
+
+            // the continuation must exist, i.e. the call can return
+            if(!instr->getNextSibling() && !block->getNextSibling()) continue;
+
+            if(canInline(callee)) {
+                LOG(10, "inlining [" << callee->getName() << "] into ["
+                    << function->getName() << "] at 0x" << std::hex
+                    << instr->getAddress());
+                callSites.push_back(instr);
+            }
+        }
+    }
+#endif
+}
+
+Function *InlineCallsPass::getCallee(Instruction *call) {
+#ifdef ARCH_X86_64
+    auto cfi = dynamic_cast<ControlFlowInstruction *>(call->getSemantic());
+    if(!cfi || cfi->getId() != X86_INS_CALL || !cfi->returns()) {
+        return nullptr;
+    }
+    if(!cfi->getLink()) return nullptr;
+    return dynamic_cast<Function *>(cfi->getLink()->getTarget());
+#else
+    return nullptr;
+#endif
+}
+
+bool InlineCallsPass::canInline(Function *callee) {
+    auto it = inlinable.find(callee);
+    if(it != inlinable.end()) return (*it).second;
+
+    bool ok = !callee->isCold() && !callee->isIFunc()
+        && callee->getSize() > 0 && callee->getSize() <= maxCalleeSize;
+    if(ok) {
+        for(auto block : CIter::children(callee)) {
+            for(auto instr : CIter::children(block)) {
+                if(!canCopy(instr, callee)) ok = false;
+            }
+            if(block->getChildren()->getIterable()->getCount() == 0) {
+                ok = false;
+            }
+        }
+    }
+    if(ok) {
+        auto last = callee->getChildren()->getIterable()->getLast();
+        if(BlockExit(last).fallsOutOfFunction()) ok = false;
+    }
+
+    inlinable[callee] = ok;
+    return ok;
+}
+
+/** Returns a new Link equal to link, or nullptr for kinds that own other
+    objects or carry state we do not know how to copy.
+*/
+static Link *copyLink(Link *link) {
+#define COPY_LINK(Type) \
+    if(auto l = dynamic_cast<Type *>(link)) return new Type(*l)
+
+    // derived types before their bases
+    COPY_LINK(InternalAndExternalDataLink);
+    COPY_LINK(AbsoluteDataLink);
+    COPY_LINK(DataOffsetLink);
+    COPY_LINK(TLSDataOffsetLink);
+    COPY_LINK(NormalLink);
+    COPY_LINK(AbsoluteNormalLink);
+    COPY_LINK(OffsetLink);
+    COPY_LINK(PLTLink);
+    COPY_LINK(MarkerLink);
+    COPY_LINK(AbsoluteMarkerLink);
+    COPY_LINK(GSTableLink);
+    COPY_LINK(ExternalSymbolLink);
+    COPY_LINK(CopyRelocLink);
+    COPY_LINK(SymbolOnlyLink);
+    COPY_LINK(UnresolvedLink);
+    COPY_LINK(UnresolvedRelativeLink);
+#undef COPY_LINK
+    return nullptr;
+}
+
+bool InlineCallsPass::canCopy(Instruction *instr, Function *callee) {
+#ifdef ARCH_X86_64
+    auto semantic = instr->getSemantic();
+    if(auto ret = dynamic_cast<ReturnInstruction *>(semantic)) {
+        // not "ret imm16", which also pops arguments
+        return ret->getData() == "\xc3" || ret->getData() == "\xf3\xc3";
+    }
+    if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+        // only jumps within the callee
+        if(cfi->getId() == X86_INS_CALL || !cfi->getLink()) return false;
+        auto target = dynamic_cast<Instruction *>(cfi->getLink()->getTarget());
+        return target && target->getParent()
+            && target->getParent()->getParent() == callee;
+    }
+    if(dynamic_cast<IndirectControlFlowInstructionBase *>(semantic)
+        || dynamic_cast<BreakInstruction *>(semantic)) {
+
+        return false;
+    }
+    if(auto linked = dynamic_cast<LinkedInstruction *>(semantic)) {
+        auto link = linked->getLink();
+        if(!link || dynamic_cast<JumpTableLink *>(link)) return false;
+
+        // every copy needs a Link of its own
+        auto copy = copyLink(link);
+        if(!copy) return false;
+        delete copy;
+
+        // a copy would still refer to the original instruction
+        auto target = dynamic_cast<Instruction *>(link->getTarget());
+        return !(target && target->getParent()
+            && target->getParent()->getParent() == callee);
+    }
+    return dynamic_cast<IsolatedInstruction *>(semantic) != nullptr;
+#else
+    return false;
+#endif
+}
+
+#ifdef ARCH_X86_64
+static Instruction *makeJump(Instruction *target) {
+    auto jump = new Instruction();
+    auto semantic = new ControlFlowInstruction(
+        X86_INS_JMP, jump, "\xe9", "jmp", 4);
+    semantic->setLink(new NormalLink(target, Link::SCOPE_INTERNAL_JUMP));
+    jump->setSemantic(semantic);
+    return jump;
+}
+#endif
+
+void InlineCallsPass::inlineAt(Instruction *call, Function *callee) {
+#ifdef ARCH_X86_64
+    auto block = static_cast<Block *>(call->getParent());
+    auto function = static_cast<Function *>(block->getParent());
+
+    // the callee's returns jump to the instruction after the call, which
+    // must start a block
+    auto next = static_cast<Instruction *>(call->getNextSibling());
+    if(next) {
+        ChunkMutator(function).splitBlockBefore(next);
+    }
+    else {
+        auto nextBlock = static_cast<Block *>(block->getNextSibling());
+        next = nextBlock->getChildren()->getIterable()->get(0);
+    }
+
+    DisasmHandle handle(true);
+    std::map<Instruction *, Instruction *> copies;
+    std::vector<std::pair<ControlFlowInstruction *, Instruction *>> jumps;
+    std::vector<Block *> newBlocks;
+    auto lastBlock = callee->getChildren()->getIterable()->getLast();
+    for(auto b : CIter::children(callee)) {
+        auto newBlock = new Block();
+        ChunkMutator m(newBlock);
+        for(auto instr : CIter::children(b)) {
+            auto semantic = instr->getSemantic();
+            Instruction *copy = nullptr;
+            if(dynamic_cast<ReturnInstruction *>(semantic)) {
+                // lea 0x8(%rsp), %rsp (unlike add, keeps the flags)
+                copy = Disassemble::instruction(handle,
+                    std::vector<unsigned char>{0x48, 0x8d, 0x64, 0x24, 0x08});
+                m.append(copy);
+                if(b != lastBlock
+                    || instr != b->getChildren()->getIterable()->getLast()) {
+
+                    m.append(makeJump(next));
+                }
+            }
+            else if(auto cfi = dynamic_cast<ControlFlowInstruction *>(
+                semantic)) {
+
+                copy = new Instruction();
+                auto newSem = new ControlFlowInstruction(cfi->getId(), copy,
+                    cfi->getOpcode(), cfi->getMnemonic(),
+                    cfi->getDisplacementSize());
+                copy->setSemantic(newSem);
+                jumps.push_back({newSem, static_cast<Instruction *>(
+                    cfi->getLink()->getTarget())});
+                m.append(copy);
+            }
+            else {
+                copy = copyInstruction(handle, instr);
+                m.append(copy);
+            }
+            copies[instr] = copy;
+        }
+        newBlocks.push_back(newBlock);
+    }
+    for(auto &jump : jumps) {
+        jump.first->setLink(new NormalLink(copies[jump.second],
+            Link::SCOPE_INTERNAL_JUMP));
+    }
+
+    // the return address is still pushed, since the callee may read it
+    // (e.g. __builtin_return_address). lea next(%rip), %r11 takes the
+    // place of the call instruction itself, so that jumps to the call
+    // still work; %r11 is not preserved across calls anyway.
+    auto oldSemantic = call->getSemantic();
+    auto enter = new LinkedInstruction(call);
+    enter->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
+        std::vector<unsigned char>{0x4c, 0x8d, 0x1d, 0x00, 0x00, 0x00, 0x00}));
+    enter->setLink(new NormalLink(next, Link::SCOPE_INTERNAL_JUMP));
+    enter->setIndex(0);
+    call->setSemantic(enter);
+    ChunkMutator(block).modifiedChildSize(call,
+        enter->getSize() - oldSemantic->getSize());
+    delete oldSemantic;
+
+    // push %r11
+    ChunkMutator(block).insertAfter(call, Disassemble::instruction(handle,
+        std::vector<unsigned char>{0x41, 0x53}));
+
+    ChunkMutator m(function);
+    Chunk *prev = block;
+    for(auto newBlock : newBlocks) {
+        m.insertAfter(prev, newBlock);
+        prev = newBlock;
+    }
+#endif
+}
+
+Instruction *InlineCallsPass::copyInstruction(DisasmHandle &handle,
+    Instruction *instr) {
+
+    auto copy = new Instruction();
+    auto semantic = instr->getSemantic();
+#ifdef ARCH_X86_64
+    if(auto linked = dynamic_cast<LinkedInstruction *>(semantic)) {
+        auto newSem = new LinkedInstruction(copy);
+        newSem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
+            linked->getData()));
+        newSem->setIndex(linked->getIndex(), linked->getDispSize(),
+            linked->getDispOffset());
+        newSem->setLink(copyLink(linked->getLink()));
+        copy->setSemantic(newSem);
+        return copy;
+    }
+#endif
+    copy->setSemantic(DisassembleInstruction(handle).instructionSemantic(
+        copy, semantic->getData()));
+    return copy;
+}
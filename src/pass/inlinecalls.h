@@ -0,0 +1,47 @@
+#ifndef EGALITO_PASS_INLINE_CALLS_H
+#define EGALITO_PASS_INLINE_CALLS_H
+
+#include <map>
+#include <vector>
+#include "chunkpass.h"
+
+class EdgeProfile;
+class DisasmHandle;
+
+/** Inlines small leaf functions at hot direct call sites, according to an
+    edge profile (a call runs as often as its block).
+
+    The call becomes "lea next(%rip), %r11; push %r11", so the callee's
+    stack offsets stay valid without rewriting them and its return address
+    slot holds the address after the call site, and is followed by a copy
+    of the callee's blocks. Each ret becomes "lea 8(%rsp), %rsp" and a jump to the
+    instruction after the call. Only callees in the caller's module whose
+    instructions can all be copied are inlined: no calls, indirect or
+    external jumps, or references into the callee itself.
+
+    Callers gain blocks, so later passes using the same edge profile see a
+    block count mismatch and leave them alone.
+*/
+class InlineCallsPass : public ChunkPass {
+private:
+    EdgeProfile *profile;
+    size_t maxCalleeSize;
+    unsigned long minCount;
+    std::vector<Instruction *> callSites;
+    std::map<Function *, bool> inlinable;
+public:
+    InlineCallsPass(EdgeProfile *profile, size_t maxCalleeSize = 64,
+        unsigned long minCount = 1000) : profile(profile),
+        maxCalleeSize(maxCalleeSize), minCount(minCount) {}
+
+    virtual void visit(Module *module);
+    virtual void visit(Function *function);
+private:
+    Function *getCallee(Instruction *call);
+    bool canInline(Function *callee);
+    bool canCopy(Instruction *instr, Function *callee);
+    void inlineAt(Instruction *call, Function *callee);
+    Instruction *copyInstruction(DisasmHandle &handle, Instruction *instr);
+};
+
+#endif
@@ -1,6 +1,10 @@
 #include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <chrono>
 #include <cstring>
 #include <cassert>
+#include "config.h"
 #include "jitgsfixup.h"
 #include "chunk/concrete.h"
 #include "chunk/tls.h"
@@ -14,19 +18,151 @@
 #include "cminus/print.h"
 #include "snippet/hook.h"
 #include "runtime/managegs.h"
+#include "runtime/jitbackground.h"
+#include "runtime/directcall.h"
+#include "runtime/jitstats.h"
 #include "transform/generator.h"
 #include "transform/sandbox.h"
-#include "util/explicit_bzero.h"
 #include "util/feature.h"
 #include "util/timing.h"
 #include "log/log.h"
 
 Chunk *egalito_gsCallback __attribute__((weak));
+bool egalito_jit_measure_reset = false;
+bool egalito_jit_background = false;
+Sandbox *egalito_jit_shared_sandbox = nullptr;
+int egalito_jit_record_fd = -1;
+size_t egalito_jit_direct_calls = 0;    // threshold, 0 if disabled
+JITStatsSegment *egalito_jit_stats = nullptr;
+
+/** Appends the first call of a GS entry's target to the profile read by
+    JitGSSetup. Several processes may share the file, so each records a
+    target once. This runs in the fixup hook on any thread, so instead of
+    a lock and a growing set, each entry owns a preallocated flag that is
+    claimed with an atomic exchange.
+*/
+static void recordFixup(GSTable *gsTable, size_t index) {
+    static bool recorded[JIT_TABLE_SIZE / sizeof(address_t)];
+    if(index >= sizeof(recorded)) return;
+
+    auto target = gsTable->getAtIndex(index)->getTarget();
+    if(!dynamic_cast<Function *>(target)
+        && !dynamic_cast<PLTTrampoline *>(target)) return;
+
+    if(__atomic_exchange_n(&recorded[index], true, __ATOMIC_RELAXED)) return;
+
+    auto module = target->getParent()->getParent();
+    std::string line = module->getName() + " " + target->getName() + "\n";
+    write(egalito_jit_record_fd, line.c_str(), line.length());
+}
+
+// marks a JIT address table entry whose code is being generated
+#define JIT_CLAIMED     1
+
+/** Fixup for the shared-code JIT mode, where all threads use the same GS
+    table, JIT address table and sandbox. The first thread to claim an
+    entry generates its code; any others racing on the same entry wait
+    until it is published. Different entries are generated concurrently.
+*/
+static void fixupShared(GSTable *gsTable, size_t index) {
+    auto array = static_cast<address_t *>(gsTable->getTableAddress());
+    auto claims = static_cast<address_t *>(EgalitoTLS::getJITAddressTable());
+    auto callbackAddress
+        = array[gsTable->getEntryFor(egalito_gsCallback)->getIndex()];
+
+    auto target = gsTable->getAtIndex(index)->getTarget();
+    Function *targetFunction = dynamic_cast<Function *>(target);
+    PLTTrampoline *targetTrampoline = dynamic_cast<PLTTrampoline *>(target);
+
+    address_t address;
+    if(targetFunction || targetTrampoline) {
+        address_t unclaimed = 0;
+        if(!__atomic_compare_exchange_n(&claims[index], &unclaimed,
+            JIT_CLAIMED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+
+            while(__atomic_load_n(&array[index], __ATOMIC_ACQUIRE)
+                == callbackAddress) {
+
+#ifdef ARCH_X86_64
+                __builtin_ia32_pause();
+#endif
+            }
+            return;
+        }
+
+        // the generated address stays in claims[index] from now on
+        Generator generator(egalito_jit_shared_sandbox, true);
+        if(targetFunction) {
+            generator.assignAndGenerate(targetFunction);
+        }
+        else {
+            generator.assignAndGenerate(targetTrampoline);
+        }
+        address = target->getAddress();
+    }
+    else if(dynamic_cast<Instruction *>(target)) {
+        // The function's address is only valid once it is published; until
+        // then its entry holds the callback and its claim JIT_CLAIMED.
+        // Resolve it first (or wait for whoever claimed it).
+        auto function = target->getParent()->getParent();
+        auto entry = gsTable->getEntryFor(function);
+        auto functionAddress
+            = __atomic_load_n(&array[entry->getIndex()], __ATOMIC_ACQUIRE);
+        if(functionAddress == callbackAddress) {
+            fixupShared(gsTable, entry->getIndex());
+            functionAddress = __atomic_load_n(&array[entry->getIndex()],
+                __ATOMIC_ACQUIRE);
+        }
+
+        // every racing thread computes the same value
+        address = target->getAddress() - function->getAddress()
+            + functionAddress;
+    }
+    else {
+        //egalito_printf("JIT error, target not known!\n");
+        while(1);
+    }
+
+    __atomic_store_n(&array[index], address, __ATOMIC_RELEASE);
+}
+
+static Sandbox *getJITSandbox() {
+    if(auto sandbox = EgalitoTLS::getRecyclingSandbox()) return sandbox;
+    return EgalitoTLS::getSandbox();
+}
+
+/** This thread's block in the EGALITO_JIT_STATS segment, if any. */
+static JITStats *getJITStats() {
+    if(!egalito_jit_stats) return nullptr;
+
+    auto stats = EgalitoTLS::getJITStats();
+    if(!stats) {
+        stats = egalito_jit_stats->claim();
+        if(stats) stats->set(stats->tid, syscall(SYS_gettid));
+        EgalitoTLS::setJITStats(stats ? stats : JITStatsSegment::noSlot());
+    }
+    return (stats == JITStatsSegment::noSlot() ? nullptr : stats);
+}
+
+static uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
 
 extern "C"
 size_t egalito_jit_gs_fixup(size_t offset) {
     auto gsTable = EgalitoTLS::getGSTable();
     size_t index = gsTable->offsetToIndex(offset);
+    if(egalito_jit_record_fd >= 0) {
+        recordFixup(gsTable, index);
+    }
+    if(egalito_jit_shared_sandbox) {
+        fixupShared(gsTable, index);
+        return offset;
+    }
+    auto stats = getJITStats();
+    std::chrono::steady_clock::time_point startTime;
+    if(stats) startTime = std::chrono::steady_clock::now();
     //egalito_printf("index=%d\n", (int)index);
     //egalito_printf("(JIT-fixup index=%d ", (int)index);
 
@@ -36,13 +172,17 @@ size_t egalito_jit_gs_fixup(size_t offset) {
     Function *targetFunction = dynamic_cast<Function *>(target);
     PLTTrampoline *targetTrampoline = dynamic_cast<PLTTrampoline *>(target);
 
+    // set up along with the thread, since the hook must not allocate
+    auto patcher = EgalitoTLS::getJITDirectCalls();
+
     address_t address;
     if(targetFunction || targetTrampoline) {
-        auto sandbox = EgalitoTLS::getSandbox();
+        auto sandbox = getJITSandbox();
         sandbox->reopen();
         Generator generator(sandbox, true);
         if(targetFunction) {
             generator.assignAndGenerate(targetFunction);
+            if(patcher) patcher->scan(targetFunction);
         }
         else {
             generator.assignAndGenerate(targetTrampoline);
@@ -50,6 +190,12 @@ size_t egalito_jit_gs_fixup(size_t offset) {
         sandbox->finalize();
         address = target->getAddress();
         PositionManager::setAddress(target, 0);
+
+        if(stats) {
+            stats->add(stats->bytesGenerated, target->getSize());
+            stats->add(stats->sandboxUsed, target->getSize());
+            stats->set(stats->sandboxSize, sandbox->getBacking()->getSize());
+        }
     }
     else {
         if(dynamic_cast<Instruction *>(target)) {
@@ -67,11 +213,21 @@ size_t egalito_jit_gs_fixup(size_t offset) {
 
     //egalito_printf("%lx\n", address);
     ManageGS::setEntry(gsTable, index, address);
+    if(patcher && (targetFunction || targetTrampoline)) {
+        patcher->resolved(index, address);
+    }
+    if(stats) {
+        stats->add(stats->fixups, 1);
+        stats->add(stats->fixupNanos, nanosSince(startTime));
+    }
     return offset;
 }
 
 extern "C"
 void egalito_jit_gs_init(ShufflingSandbox *sandbox, GSTable *gsTable) {
+    auto stats = getJITStats();
+    auto startTime = std::chrono::steady_clock::now();
+
     sandbox->reopen();
     sandbox->recreate();
     Generator generator(sandbox, true);
@@ -88,11 +244,138 @@ void egalito_jit_gs_init(ShufflingSandbox *sandbox, GSTable *gsTable) {
     }
     sandbox->finalize();
     ManageGS::resetEntries(gsTable, egalito_gsCallback);
-    explicit_bzero(EgalitoTLS::getJITAddressTable(), JIT_TABLE_SIZE);
+    ManageGS::clearAddressTable(gsTable, EgalitoTLS::getJITAddressTable());
     sandbox->flip();
     sandbox->reopen();
     sandbox->recreate();
     sandbox->finalize();
+
+    if(stats && !stats->initNanos) {
+        stats->set(stats->initNanos, nanosSince(startTime));
+    }
+}
+
+/** Replaces egalito_jit_gs_init() when a RecyclingSandbox is in use. Every
+    copy generated during the last period is released to the allocator, and
+    the reserved entries are regenerated into recycled slots.
+*/
+extern "C"
+void egalito_jit_gs_recycle(RecyclingSandbox *sandbox, GSTable *gsTable) {
+    auto allocator = sandbox->getAllocator();
+    auto base = sandbox->getBacking()->getBase();
+    auto end = base + sandbox->getBacking()->getSize();
+    auto array = static_cast<address_t *>(gsTable->getTableAddress());
+
+    // unresolved JIT entries all point at the callback
+    auto callbackEntry = gsTable->getEntryFor(egalito_gsCallback);
+    auto callbackAddress = array[callbackEntry->getIndex()];
+
+    for(auto gsEntry : CIter::children(gsTable)) {
+        auto target = gsEntry->getTarget();
+        if(!dynamic_cast<Function *>(target)
+            && !dynamic_cast<PLTTrampoline *>(target)) continue;
+
+        auto address = array[gsEntry->getIndex()];
+        if(address < base || address >= end) continue;
+        if(address == callbackAddress && gsEntry != callbackEntry) continue;
+
+        allocator->release(Slot(address, target->getSize()));
+    }
+    allocator->advanceEpoch();
+
+    sandbox->reopen();
+    Generator generator(sandbox, true);
+    for(auto gsEntry : CIter::children(gsTable)) {
+        if(gsEntry->getIndex() == gsTable->getJITStartIndex()) break;
+
+        auto target = gsEntry->getTarget();
+        if(auto f = dynamic_cast<Function *>(target)) {
+            generator.assignAndGenerate(f);
+        }
+        else if(auto trampoline = dynamic_cast<PLTTrampoline *>(target)) {
+            generator.assignAndGenerate(trampoline);
+        }
+    }
+    sandbox->finalize();
+    ManageGS::resetEntries(gsTable, egalito_gsCallback);
+    ManageGS::clearAddressTable(gsTable, EgalitoTLS::getJITAddressTable());
+}
+
+/** Replaces egalito_jit_gs_init() when code is regenerated in the
+    background. The first reset on each thread regenerates the current
+    half in place (the other half still holds the initial code) and starts
+    the worker; later resets only publish what the worker prepared.
+*/
+extern "C"
+void egalito_jit_gs_background_reset(ShufflingSandbox *sandbox,
+    GSTable *gsTable) {
+
+    if(auto background = EgalitoTLS::getJITBackground()) {
+        background->publish(egalito_gsCallback);
+        ManageGS::clearAddressTable(gsTable, EgalitoTLS::getJITAddressTable());
+        return;
+    }
+
+    sandbox->reopen();
+    sandbox->recreate();
+    Generator generator(sandbox, true);
+    for(auto gsEntry : CIter::children(gsTable)) {
+        if(gsEntry->getIndex() == gsTable->getJITStartIndex()) break;
+
+        auto target = gsEntry->getTarget();
+        if(auto f = dynamic_cast<Function *>(target)) {
+            generator.assignAndGenerate(f);
+        }
+        else if(auto trampoline = dynamic_cast<PLTTrampoline *>(target)) {
+            generator.assignAndGenerate(trampoline);
+        }
+    }
+    sandbox->finalize();
+    ManageGS::resetEntries(gsTable, egalito_gsCallback);
+    ManageGS::clearAddressTable(gsTable, EgalitoTLS::getJITAddressTable());
+
+    EgalitoTLS::setJITBackground(JITBackground::spawn(sandbox, gsTable));
+}
+
+/** Size of the code every reset regenerates. */
+static size_t getReservedBytes(GSTable *gsTable) {
+    size_t bytes = 0;
+    for(auto gsEntry : CIter::children(gsTable)) {
+        if(gsEntry->getIndex() == gsTable->getJITStartIndex()) break;
+
+        auto target = gsEntry->getTarget();
+        if(dynamic_cast<Function *>(target)
+            || dynamic_cast<PLTTrampoline *>(target)) {
+
+            bytes += target->getSize();
+        }
+    }
+    return bytes;
+}
+
+static void printResetStatistics(unsigned long us) {
+    if(auto sandbox = EgalitoTLS::getRecyclingSandbox()) {
+        auto allocator = sandbox->getAllocator();
+        egalito_printf("JIT reset %d: %d us, footprint %d kB"
+            " (live %d, retired %d, free %d)\n",
+            (int)allocator->getEpoch(), (int)us,
+            (int)(allocator->getFootprint() / 1024),
+            (int)(allocator->getLiveBytes() / 1024),
+            (int)(allocator->getRetiredBytes() / 1024),
+            (int)(allocator->getFreeBytes() / 1024));
+    }
+    else if(auto background = EgalitoTLS::getJITBackground()) {
+        egalito_printf("JIT reset %d: %d us (waited for worker %d times)\n",
+            (int)background->getPublishCount(), (int)us,
+            (int)background->getWaitCount());
+    }
+    else {
+        egalito_printf("JIT reset: %d us\n", (int)us);
+    }
+    if(auto patcher = EgalitoTLS::getJITDirectCalls()) {
+        egalito_printf("    %d GS call sites patched into direct jumps\n",
+            (int)patcher->getPatchCount());
+    }
 }
 
 extern "C"
@@ -105,6 +388,11 @@ void egalito_jit_gs_reset(void) {
     }
     t = new EgalitoTiming("from previous reset");
 #endif
+    // the previous generation is no longer in use by now
+    if(auto background = EgalitoTLS::getJITBackground()) {
+        background->noteQuiescent();
+    }
+
     auto counter = EgalitoTLS::getJITResetCounter();
     auto threshold = EgalitoTLS::getJITResetThreshold();
     counter++;
@@ -114,15 +402,48 @@ void egalito_jit_gs_reset(void) {
     }
     EgalitoTLS::setJITResetCounter(0);
     //egalito_printf("resetting...\n");
-    auto sandbox = EgalitoTLS::getSandbox();
+    auto startTime = std::chrono::high_resolution_clock::now();
     auto gsTable = EgalitoTLS::getGSTable();
+    auto stats = getJITStats();
 
-    egalito_jit_gs_init(sandbox, gsTable);
+    if(auto sandbox = EgalitoTLS::getRecyclingSandbox()) {
+        egalito_jit_gs_recycle(sandbox, gsTable);
+    }
+    else if(egalito_jit_background) {
+        egalito_jit_gs_background_reset(EgalitoTLS::getSandbox(), gsTable);
+    }
+    else {
+        egalito_jit_gs_init(EgalitoTLS::getSandbox(), gsTable);
+    }
+
+    if(stats) {
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+        auto regenerated = getReservedBytes(gsTable);
+        stats->add(stats->resets, 1);
+        stats->add(stats->resetNanos, nanos);
+        stats->set(stats->lastResetNanos, nanos);
+        stats->set(stats->bytesRegenerated, regenerated);
+        stats->set(stats->sandboxUsed, regenerated);
+    }
+
+    if(egalito_jit_measure_reset) {
+        auto endTime = std::chrono::high_resolution_clock::now();
+        printResetStatistics(std::chrono::duration_cast<
+            std::chrono::microseconds>(endTime - startTime).count());
+    }
 }
 
 extern "C"
 void egalito_jit_gs_setup_thread(void) {
     ManageGS::setGS(EgalitoTLS::getGSTable());
+
+    // a block claimed for this thread by egalito_pthread_create
+    auto stats = EgalitoTLS::getJITStats();
+    if(stats && stats != JITStatsSegment::noSlot()) {
+        stats->set(stats->tid, syscall(SYS_gettid));
+    }
+
     volatile size_t *barrier = EgalitoTLS::getBarrier();
     *barrier = 1;
     EgalitoTLS::setBarrier(nullptr);
@@ -153,8 +474,24 @@ void JitGSFixup::visit(Program *program) {
         "egalito_hook_jit_fixup", lib);
     assert(callback);
     ::egalito_gsCallback = callback;
+    ::egalito_jit_measure_reset = isFeatureEnabled("EGALITO_MEASURE_RESET");
+    ::egalito_jit_background = isFeatureEnabled("EGALITO_JIT_BACKGROUND");
+    if(isFeatureEnabled("EGALITO_JIT_STATS")) {
+        ::egalito_jit_stats = JITStatsSegment::create(getpid());
+        if(!egalito_jit_stats) {
+            LOG(0, "WARNING: unable to create the JIT statistics segment");
+        }
+    }
+    if(!isFeatureEnabled("EGALITO_JIT_SHARED")) {
+        if(auto threshold = getenv("EGALITO_JIT_DIRECT_CALLS")) {
+            ::egalito_jit_direct_calls = std::strtoul(threshold, nullptr, 0);
+        }
+    }
+
+    // code is never regenerated once it is shared between threads
+    if(isFeatureEnabled("EGALITO_USE_SHUFFLING")
+        && !isFeatureEnabled("EGALITO_JIT_SHARED")) {
 
-    if(isFeatureEnabled("EGALITO_USE_SHUFFLING")) {
         addResetCalls();
     }
 
@@ -2,6 +2,7 @@
 #include <cctype>
 #include <cstring>
 #include <cassert>
+#include <fstream>
 #include "config.h"
 #include "jitgssetup.h"
 #include "analysis/jumptable.h"
@@ -41,6 +42,9 @@ void JitGSSetup::visit(Program *program) {
 
     makeRequiredEntries();
 
+    // after the closure above: these are never called during a JIT fixup
+    if(profile) makeProfiledEntries(program);
+
     gsTable->finishReservation();
 }
 
@@ -520,6 +524,41 @@ void JitGSSetup::makeResolvedEntryForPLT(PLTTrampoline *plt) {
     }
 }
 
+void JitGSSetup::makeProfiledEntries(Program *program) {
+    std::ifstream file(profile);
+    if(!file) {
+        LOG(0, "WARNING: unable to open JIT profile [" << profile << "]");
+        return;
+    }
+
+    auto before = gsTable->getChildren()->getIterable()->getCount();
+    size_t missing = 0;
+    std::string moduleName, name;
+    while(file >> moduleName >> name) {
+        auto module = CIter::findChild(program, moduleName.c_str());
+        if(!module) {
+            missing ++;
+            continue;
+        }
+
+        if(name.size() > 4 && name.compare(name.size() - 4, 4, "@plt") == 0) {
+            auto plt = CIter::findChild(module->getPLTList(), name.c_str());
+            if(plt) makeResolvedEntryForPLT(plt);
+            else missing ++;
+        }
+        else {
+            auto function = CIter::named(module->getFunctionList())
+                ->find(name);
+            if(function) makeResolvedEntryForFunction(function);
+            else missing ++;
+        }
+    }
+
+    LOG(1, "JIT profile: "
+        << (gsTable->getChildren()->getIterable()->getCount() - before)
+        << " entries start resolved, " << missing << " not found");
+}
+
 void JitGSSetup::makeRequiredEntries() {
     //TemporaryLogLevel tll("pass", 10);
 
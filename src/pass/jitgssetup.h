@@ -11,9 +11,13 @@ class JitGSSetup : public ChunkPass {
 private:
     Conductor *conductor;
     GSTable *gsTable;
+    const char *profile;
 public:
-    JitGSSetup(Conductor *conductor, GSTable *gsTable)
-        : conductor(conductor), gsTable(gsTable) {}
+    /** profile optionally names a file recorded with EGALITO_JIT_RECORD;
+        the functions listed there start out resolved. */
+    JitGSSetup(Conductor *conductor, GSTable *gsTable,
+        const char *profile = nullptr)
+        : conductor(conductor), gsTable(gsTable), profile(profile) {}
     virtual void visit(Program *program);
 private:
     void makeHardwiredGSEntries(Module *egalito);
@@ -27,6 +31,7 @@ private:
 
     void makeRequiredEntries();
     void makeRequiredEntriesFor(Chunk *chunk);
+    void makeProfiledEntries(Program *program);
 };
 
 #endif
@@ -1,13 +1,37 @@
 #include "makecache.h"
+#include "chunk/cache.h"
+#include "log/log.h"
 
 void MakeCachePass::visit(Function *function) {
-#ifdef ARCH_X86_64
-    function->makeCache();
-#endif
+    // kept from the last emission, if still valid (see Function::setDirty)
+    if(!function->getCache()) function->makeCache();
+    record(function->getCache());
 }
 
 void MakeCachePass::visit(PLTTrampoline *trampoline) {
 #ifdef ARCH_X86_64
+    // other architectures write PLT entries directly, not from Blocks
     trampoline->makeCache();
+    record(trampoline->getCache());
 #endif
 }
+
+void MakeCachePass::record(ChunkCache *cache) {
+    chunkCount ++;
+    instructionCount += cache->getInstructionCount();
+    fixupCount += cache->getFixupCount();
+    rewriteCount += cache->getRewriteCount();
+}
+
+void MakeCachePass::dumpStatistics() const {
+    LOG(1, "ChunkCache: " << std::dec << chunkCount << " chunks, "
+        << instructionCount << " instructions, "
+        << fixupCount << " patched displacements, "
+        << rewriteCount << " re-encoded instructions");
+    if(instructionCount) {
+        LOG(1, "ChunkCache: "
+            << (100 * (instructionCount - fixupCount - rewriteCount)
+                / instructionCount)
+            << "% of instructions copied without fixups");
+    }
+}
@@ -3,10 +3,24 @@
 
 #include "pass/chunkpass.h"
 
+class ChunkCache;
+
 class MakeCachePass : public ChunkPass {
+private:
+    size_t chunkCount;
+    size_t instructionCount;
+    size_t fixupCount;
+    size_t rewriteCount;
 public:
+    MakeCachePass() : chunkCount(0), instructionCount(0), fixupCount(0),
+        rewriteCount(0) {}
     virtual void visit(Function *function);
     virtual void visit(PLTTrampoline *trampoline);
+
+    /** Log how much of the cached code can be copied without fixups. */
+    void dumpStatistics() const;
+private:
+    void record(ChunkCache *cache);
 };
 
 #endif
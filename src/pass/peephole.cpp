@@ -0,0 +1,173 @@
+#include <capstone/capstone.h>
+#include "peephole.h"
+#include "analysis/localliveness.h"
+#include "disasm/disassemble.h"
+#include "instr/register.h"
+#include "instr/semantic.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+#ifdef ARCH_X86_64
+// which general-purpose register a push or pop of 64 bits acts on
+static int getPushPopRegister(Instruction *instruction, unsigned int id) {
+    auto assembly = instruction->getSemantic()->getAssembly();
+    if(!assembly || assembly->getId() != id) return X86Register::INVALID;
+
+    auto asmOps = assembly->getAsmOperands();
+    if(asmOps->getOpCount() != 1) return X86Register::INVALID;
+    auto &op = asmOps->getOperands()[0];
+    if(op.type != X86_OP_REG || op.size != 8) return X86Register::INVALID;
+
+    int reg = X86Register::convertToPhysical(op.reg);
+    return reg == X86Register::SP ? X86Register::INVALID : reg;
+}
+
+static bool isInstruction(Instruction *instruction, unsigned int id) {
+    auto assembly = instruction->getSemantic()->getAssembly();
+    return assembly && assembly->getId() == id;
+}
+
+// lea disp(%rsp), %rsp
+static bool getStackAdjustment(Instruction *instruction, long *disp) {
+    auto assembly = instruction->getSemantic()->getAssembly();
+    if(!assembly || assembly->getId() != X86_INS_LEA) return false;
+
+    auto asmOps = assembly->getAsmOperands();
+    if(asmOps->getOpCount() != 2) return false;
+    // AT&T order
+    auto &src = asmOps->getOperands()[0];
+    auto &dest = asmOps->getOperands()[1];
+    if(dest.type != X86_OP_REG || dest.reg != X86_REG_RSP) return false;
+    if(src.type != X86_OP_MEM || src.mem.base != X86_REG_RSP
+        || src.mem.index != X86_REG_INVALID
+        || src.mem.segment != X86_REG_INVALID) {
+
+        return false;
+    }
+    *disp = src.mem.disp;
+    return true;
+}
+#endif
+
+void PeepholePass::visit(Module *module) {
+    pairsRemoved = stackMerged = bytesSaved = 0;
+    recurse(module);
+
+    LOG(1, "peephole" << (after.empty() ? "" : " after " + after)
+        << " in [" << module->getName() << "]: " << pairsRemoved
+        << " save/restore pairs removed, " << stackMerged
+        << " stack adjustments merged, " << bytesSaved << " bytes saved");
+}
+
+void PeepholePass::visit(Function *function) {
+    auto oldSize = function->getSize();
+    recurse(function);
+    if(function->getSize() < oldSize) {
+        bytesSaved += oldSize - function->getSize();
+    }
+}
+
+void PeepholePass::visit(Block *block) {
+#ifdef ARCH_X86_64
+    bool changed = true;
+    while(changed) {
+        changed = false;
+
+        std::vector<Instruction *> list;
+        for(auto instr : CIter::children(block)) list.push_back(instr);
+        for(size_t i = 0; i + 1 < list.size(); i ++) {
+            if(simplify(block, list, i)) {
+                changed = true;
+                break;
+            }
+        }
+    }
+#endif
+}
+
+bool PeepholePass::simplify(Block *block,
+    const std::vector<Instruction *> &list, size_t i) {
+
+#ifdef ARCH_X86_64
+    auto first = list[i];
+    auto second = list[i + 1];
+
+    long a, b;
+    if(getStackAdjustment(first, &a) && getStackAdjustment(second, &b)) {
+        auto disp = a + b;
+        if(disp == 0 && i > 0) {
+            remove(block, first);
+            remove(block, second);
+            stackMerged ++;
+            return true;
+        }
+        if(disp == 0) return false;
+
+        std::vector<unsigned char> bytes{0x48, 0x8d};
+        if(disp >= -0x80 && disp < 0x80) {
+            bytes.insert(bytes.end(), {0x64, 0x24,
+                static_cast<unsigned char>(disp)});
+        }
+        else {
+            bytes.insert(bytes.end(), {0xa4, 0x24});
+            for(int k = 0; k < 4; k ++) {
+                bytes.push_back(static_cast<unsigned char>(disp >> (k * 8)));
+            }
+        }
+
+        // keep the first instruction, which may be a jump target
+        DisasmHandle handle(true);
+        auto oldSemantic = first->getSemantic();
+        auto newSemantic = DisassembleInstruction(handle)
+            .instructionSemantic(first, bytes);
+        first->setSemantic(newSemantic);
+        ChunkMutator(block).modifiedChildSize(first,
+            static_cast<int>(newSemantic->getSize())
+            - static_cast<int>(oldSemantic->getSize()));
+        delete oldSemantic;
+        remove(block, second);
+        stackMerged ++;
+        return true;
+    }
+
+    if(i == 0) return false;
+
+    int reg = getPushPopRegister(first, X86_INS_PUSH);
+    if(reg != X86Register::INVALID
+        && getPushPopRegister(second, X86_INS_POP) == reg) {
+
+        remove(block, first);
+        remove(block, second);
+        pairsRemoved ++;
+        return true;
+    }
+
+    // the stack slot keeps the saved value, so a later pop still restores it
+    reg = getPushPopRegister(first, X86_INS_POP);
+    if(reg != X86Register::INVALID
+        && getPushPopRegister(second, X86_INS_PUSH) == reg
+        && LocalLiveness::isDead(list, i + 2, reg)) {
+
+        remove(block, first);
+        remove(block, second);
+        pairsRemoved ++;
+        return true;
+    }
+
+    if(isInstruction(first, X86_INS_POPFQ)
+        && isInstruction(second, X86_INS_PUSHFQ)
+        && LocalLiveness::flagsDead(list, i + 2)) {
+
+        remove(block, first);
+        remove(block, second);
+        pairsRemoved ++;
+        return true;
+    }
+#endif
+    return false;
+}
+
+void PeepholePass::remove(Block *block, Instruction *instruction) {
+    LOG(10, "peephole: remove " << instruction->getName());
+    ChunkMutator(block).remove(instruction);
+}
@@ -0,0 +1,45 @@
+#ifndef EGALITO_PASS_PEEPHOLE_H
+#define EGALITO_PASS_PEEPHOLE_H
+
+#include <string>
+#include <vector>
+#include "chunkpass.h"
+
+/** Cleans up the save/restore code that instrumentation (ChunkAddInline
+    in particular) leaves between adjacent insertion points, within each
+    block and until nothing changes:
+
+        push %r; pop %r         removed
+        pop %r; push %r         removed if %r is overwritten before use
+        popfq; pushfq           removed if the flags are, likewise
+        lea a(%rsp),%rsp; lea b(%rsp),%rsp
+                                merged, or removed if a + b == 0
+
+    The first instruction of a block is never removed, since jumps may
+    target it. Liveness comes from LocalLiveness, so only reaches to the
+    end of the block.
+    This whole pass is x86_64-specific.
+*/
+class PeepholePass : public ChunkPass {
+private:
+    std::string after;
+    size_t pairsRemoved;
+    size_t stackMerged;
+    size_t bytesSaved;
+public:
+    /** after names the instrumentation being cleaned up, for the log. */
+    PeepholePass(const std::string &after = "") : after(after),
+        pairsRemoved(0), stackMerged(0), bytesSaved(0) {}
+
+    virtual void visit(Module *module);
+    virtual void visit(Function *function);
+    virtual void visit(Block *block);
+
+    size_t getBytesSaved() const { return bytesSaved; }
+private:
+    bool simplify(Block *block, const std::vector<Instruction *> &list,
+        size_t i);
+    void remove(Block *block, Instruction *instruction);
+};
+
+#endif
@@ -1,8 +1,12 @@
+#include <algorithm>
 #include <cassert>
 #include <typeinfo>
 
+#include <capstone/capstone.h>
+#include "analysis/edgeprofile.h"
 #include "chunk/concrete.h"
 #include "instr/linked.h"
+#include "operation/mutator.h"
 
 #include "permutedata.h"
 
@@ -141,17 +145,12 @@ void PermuteDataPass::visit(Module *module) {
         ranges.push_back(Range::fromEndpoints(prev, ds->getSize()));
     }
 
-    // generate random new layout
+    // generate new layout
     newlayout.clear();
-    std::vector<Range> shuffle = ranges;
-    std::random_shuffle(shuffle.begin(), shuffle.end());
-    address_t lastend = 0;
-
-    for(auto nr : shuffle) {
-        address_t newend = lastend + nr.getSize();
-        newlayout[nr.getStart()] = Range::fromEndpoints(lastend, newend);
-        lastend = newend;
-    }
+    address_t newSize = (mode == MODE_HOT)
+        ? makeHotLayout(module, ds, ranges) : makeRandomLayout(ranges);
+    nds->setSize(newSize);
+    ndr->setSize(newSize);
 
     // step 5a: re-create all globalvariables in new datasection
     std::map<address_t, GlobalVariable *> newglobals;
@@ -192,7 +191,7 @@ void PermuteDataPass::visit(Module *module) {
 
         dvmap[dv] = ndv;
     }
-    for(auto kv : newvars) nds->getChildren()->add(kv.second);
+    for(auto kv : newvars) nds->addVariable(kv.second);
 
     // update all datavariables that reference ds
     for(auto region : CIter::regions(module)) {
@@ -251,21 +250,17 @@ void PermuteDataPass::visit(Module *module) {
     // NOTE: this only needs to be done for .data, not for (eventually) .bss
     auto dr = (DataRegion *)ds->getParent();
     const std::string &old_data = dr->getDataBytes();
-    std::string new_data(ds->getSize(), '\x00');
+    std::string new_data(newSize, '\x00');
 
-    lastend = 0;
-
-    for(auto nr : shuffle) {
-        address_t newend = lastend + nr.getSize();
+    for(auto kv : newlayout) {
+        auto nr = Range(kv.first, kv.second.getSize());
 
-        LOG(1, "Moving data block " << nr << " to 0x" << std::hex << lastend);
+        LOG(1, "Moving data block " << nr << " to 0x" << std::hex
+            << kv.second.getStart());
         std::copy(
             old_data.begin() + ds->getOriginalOffset() + nr.getStart(),
             old_data.begin() + ds->getOriginalOffset() + nr.getEnd(),
-            new_data.begin() + lastend);
-
-        // newlayout[nr.getStart()] = Range::fromEndpoints(lastend, newend);
-        lastend = newend;
+            new_data.begin() + kv.second.getStart());
     }
 
     ndr->saveDataBytes(new_data);
@@ -274,12 +269,148 @@ void PermuteDataPass::visit(Module *module) {
     curModule = nullptr;
 }
 
+address_t PermuteDataPass::makeRandomLayout(const std::vector<Range> &ranges) {
+    std::vector<Range> shuffle = ranges;
+    std::random_shuffle(shuffle.begin(), shuffle.end());
+    address_t lastend = 0;
+
+    for(auto nr : shuffle) {
+        // an empty range would hide the one starting at the same offset
+        if(!nr.getSize()) continue;
+        address_t newend = lastend + nr.getSize();
+        newlayout[nr.getStart()] = Range::fromEndpoints(lastend, newend);
+        lastend = newend;
+    }
+    return lastend;
+}
+
+#ifdef ARCH_X86_64
+// whether the instruction stores to its memory operand (AT&T order)
+static bool isMemoryWrite(Instruction *instr) {
+    auto assembly = instr->getSemantic()->getAssembly();
+    if(!assembly) return false;
+    switch(assembly->getId()) {
+    case X86_INS_CMP:
+    case X86_INS_TEST:
+    case X86_INS_PUSH:
+    case X86_INS_LEA:
+        return false;
+    default:
+        break;
+    }
+
+    auto asmOps = assembly->getAsmOperands();
+    size_t count = asmOps->getOpCount();
+    return count > 0 && asmOps->getOperands()[count - 1].type == X86_OP_MEM;
+}
+#endif
+
+address_t PermuteDataPass::makeHotLayout(Module *module,
+    DataSection *section, const std::vector<Range> &ranges) {
+
+    struct Access {
+        unsigned long reads, writes;
+        Access() : reads(0), writes(0) {}
+        unsigned long total() const { return reads + writes; }
+    };
+    std::map<address_t, size_t> index;  // range start -> range
+    for(size_t i = 0; i < ranges.size(); i ++) index[ranges[i].getStart()] = i;
+    std::vector<Access> access(ranges.size());
+
+    for(auto func : CIter::children(module->getFunctionList())) {
+        const EdgeProfile::Counts *counts = nullptr;
+        if(profile) {
+            counts = profile->getCounts(func);
+            if(counts && counts->block.size()
+                != func->getChildren()->getIterable()->getCount()) {
+
+                counts = nullptr;
+            }
+        }
+
+        size_t b = 0;
+        for(auto block : CIter::children(func)) {
+            unsigned long weight = counts ? counts->block[b] : 1;
+            b ++;
+            if(!weight) continue;
+
+            for(auto instr : CIter::children(block)) {
+                auto li = dynamic_cast<LinkedInstructionBase *>(
+                    instr->getSemantic());
+                if(!li) continue;
+                auto dol = dynamic_cast<DataOffsetLink *>(li->getLink());
+                if(!dol || dol->getTarget() != section) continue;
+
+                auto it = index.upper_bound(
+                    dol->getTargetAddress() - section->getAddress());
+                if(it == index.begin()) continue;
+                auto &a = access[(*--it).second];
+#ifdef ARCH_X86_64
+                if(isMemoryWrite(instr)) a.writes += weight;
+                else a.reads += weight;
+#else
+                a.reads += weight;
+#endif
+            }
+        }
+    }
+
+    // frequently written first, then read-mostly, then never accessed
+    std::vector<size_t> written, readMostly, cold;
+    for(size_t i = 0; i < ranges.size(); i ++) {
+        if(!access[i].total()) cold.push_back(i);
+        else if(access[i].writes * 8 >= access[i].total()) written.push_back(i);
+        else readMostly.push_back(i);
+    }
+    auto hotter = [&access] (size_t a, size_t b) {
+        return access[a].total() > access[b].total();
+    };
+    std::stable_sort(written.begin(), written.end(), hotter);
+    std::stable_sort(readMostly.begin(), readMostly.end(), hotter);
+
+    // the new section is page-aligned, so any alignment up to that of the
+    // old section (and at least a cache line) can be kept
+    const address_t CACHE_LINE = 64;
+    address_t maxAlign = std::max(address_t(section->getAlignment()),
+        CACHE_LINE);
+    address_t lastend = 0;
+    auto place = [&] (const std::vector<size_t> &group) {
+        for(auto i : group) {
+            auto nr = ranges[i];
+            if(!nr.getSize()) continue;
+            address_t original = section->getAddress() + nr.getStart();
+            address_t align = original ? (original & -original) : maxAlign;
+            if(align > maxAlign) align = maxAlign;
+            lastend = (lastend + align - 1) & ~(align - 1);
+
+            newlayout[nr.getStart()] = Range(lastend, nr.getSize());
+            lastend += nr.getSize();
+        }
+        lastend = (lastend + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+    };
+    place(written);
+    address_t writtenEnd = lastend;
+    place(readMostly);
+    LOG(1, "packed " << written.size() << " written and " << readMostly.size()
+        << " read-mostly variables into " << std::dec
+        << (lastend / CACHE_LINE) << " cache lines ("
+        << (writtenEnd / CACHE_LINE) << " written), "
+        << cold.size() << " never accessed");
+    place(cold);
+
+    return lastend;
+}
+
 void PermuteDataPass::visit(Instruction *instr) {
     auto semantic = instr->getSemantic();
     auto li = dynamic_cast<LinkedInstructionBase *>(semantic);
     if(!li) return;
 
-    li->setLink(updatedLink(li->getLink()));
+    auto link = updatedLink(li->getLink());
+    if(link != li->getLink()) {
+        li->setLink(link);
+        ChunkMutator(instr, false).markFunctionDirty();
+    }
 }
 
 Link *PermuteDataPass::updatedLink(Link *link) {
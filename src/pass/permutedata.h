@@ -4,8 +4,25 @@
 #include "chunk/module.h"
 #include "chunkpass.h"
 
+class EdgeProfile;
+
+/** Moves the variables of .data into a new section.
+
+    MODE_RANDOM shuffles them, for hardening. MODE_HOT packs the variables
+    that are accessed most often (by instructions with DataOffsetLinks,
+    weighted by block counts if a profile is given) into as few cache lines
+    as possible, with the frequently written ones on cache lines apart from
+    the read-mostly ones to avoid false sharing between threads.
+*/
 class PermuteDataPass : public ChunkPass {
+public:
+    enum Mode {
+        MODE_RANDOM,
+        MODE_HOT
+    };
 private:
+    Mode mode;
+    EdgeProfile *profile;
     // old data section, new data section
     DataSection *ds, *nds;
     // stores map of datavariables (in ds) to dvs (in nds)
@@ -17,8 +34,20 @@ private:
     Module *curModule;
     GlobalVariable *lastVariable;
 public:
+    PermuteDataPass(Mode mode = MODE_RANDOM, EdgeProfile *profile = nullptr)
+        : mode(mode), profile(profile) {}
     virtual void visit(Module *module);
     virtual void visit(Instruction *instr);
+
+    /** Maps the start of each range in the old section to its place in
+        the new one. */
+    const std::map<address_t, Range> &getLayout() const { return newlayout; }
+
+    // both fill in newlayout and return the size of the new section
+    address_t makeRandomLayout(const std::vector<Range> &ranges);
+    /** Counts the accesses of module's code to the ranges of section. */
+    address_t makeHotLayout(Module *module, DataSection *section,
+        const std::vector<Range> &ranges);
 private:
     Link *updatedLink(Link *link);
 private:
@@ -7,12 +7,6 @@
 #include "instr/concrete.h"
 #include "log/log.h"
 
-#define DATA_REGION_ADDRESS 0x30000000
-#define DATA_NAMEREGION_ADDRESS 0x31000000
-#define DATA_REGION_NAME ("region-" #DATA_REGION_ADDRESS)
-#define DATA_SECTION_NAME ".profiling"
-#define DATA_NAMESECTION_NAME ".profiling.names"
-
 /*
 	0000000000000000 <profiling_save_bytes>:
 	   0:   53                      push   %rbx
@@ -48,7 +42,7 @@ void ProfileSavePass::visit(Module *module) {
     }
 
     auto function = new Function();
-    function->setName("egalito_profiling_save_bytes");
+    function->setName(functionName);
     function->setPosition(new AbsolutePosition(0x0));
 
     auto block = new Block();
@@ -67,7 +61,7 @@ void ProfileSavePass::visit(Module *module) {
         auto leaSem = new LinkedInstruction(leaInstr);
         leaSem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
             std::vector<unsigned char>{0x48, 0x8d, 0x3d, 0x00, 0x00, 0x00, 0x00}));
-        leaSem->setLink(appendString(nameSection, "profile.data"));
+        leaSem->setLink(appendString(nameSection, filename));
         leaSem->setIndex(0);
         leaInstr->setSemantic(leaSem);
         m.append(leaInstr);
@@ -113,8 +107,8 @@ std::pair<DataSection *, DataSection *> ProfileSavePass
     ::getDataSections(Module *module) {
 
     auto regionList = module->getDataRegionList();
-    if(auto section = regionList->findDataSection(DATA_SECTION_NAME)) {
-        if(auto nameSection = regionList->findDataSection(DATA_NAMESECTION_NAME)) {
+    if(auto section = regionList->findDataSection(sectionName)) {
+        if(auto nameSection = regionList->findDataSection(nameSectionName)) {
             return std::make_pair(section, nameSection);
         }
     }
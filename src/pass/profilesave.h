@@ -5,7 +5,19 @@
 #include "chunk/dataregion.h"
 
 class ProfileSavePass : public ChunkPass {
+private:
+    const char *sectionName;
+    const char *nameSectionName;
+    const char *filename;
+    const char *functionName;
 public:
+    ProfileSavePass(const char *sectionName = ".profiling",
+        const char *nameSectionName = ".profiling.names",
+        const char *filename = "profile.data",
+        const char *functionName = "egalito_profiling_save_bytes")
+        : sectionName(sectionName), nameSectionName(nameSectionName),
+        filename(filename), functionName(functionName) {}
+
     virtual void visit(Module *module);
 private:
     std::pair<DataSection *, DataSection*> getDataSections(Module *module);
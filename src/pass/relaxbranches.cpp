@@ -0,0 +1,192 @@
+#include <set>
+#include <capstone/capstone.h>
+#include "relaxbranches.h"
+#include "promotejumps.h"
+#include "chunk/link.h"
+#include "operation/mutator.h"
+#include "instr/concrete.h"
+#include "log/log.h"
+
+void RelaxBranchesPass::visit(Module *module) {
+    threaded = removed = shrunk = bytesSaved = 0;
+    recurse(module->getFunctionList());
+
+    LOG(1, "relaxed branches in [" << module->getName() << "]: "
+        << threaded << " threaded, " << removed << " removed, "
+        << shrunk << " shrunk, " << bytesSaved << " bytes saved");
+}
+
+void RelaxBranchesPass::visit(Function *function) {
+#ifdef ARCH_X86_64
+    auto oldSize = function->getSize();
+
+    bool changed = true;
+    while(changed) {
+        changed = false;
+
+        std::vector<Block *> blocks;
+        for(auto block : CIter::children(function)) {
+            if(block->getChildren()->getIterable()->getCount() == 0) continue;
+            blocks.push_back(block);
+        }
+        for(size_t i = 0; i < blocks.size(); i ++) {
+            auto last = blocks[i]->getChildren()->getIterable()->getLast();
+            if(thread(last, function)) changed = true;
+            if(i + 1 < blocks.size()
+                && removeJumpToNext(blocks[i], blocks[i + 1], function)) {
+
+                changed = true;
+            }
+        }
+
+        // only ever makes code smaller, so earlier shrinks stay valid
+        for(auto block : blocks) {
+            auto last = block->getChildren()->getIterable()->getLast();
+            if(shrink(last, function)) changed = true;
+        }
+    }
+
+    // a threaded rel8 jump may now be out of reach
+    PromoteJumpsPass promoteJumps;
+    function->accept(&promoteJumps);
+
+    if(function->getSize() < oldSize) {
+        LOG(10, "relaxed [" << function->getName() << "] from " << oldSize
+            << " to " << function->getSize() << " bytes");
+        bytesSaved += oldSize - function->getSize();
+    }
+#endif
+}
+
+bool RelaxBranchesPass::thread(Instruction *instruction, Function *function) {
+#ifdef ARCH_X86_64
+    auto target = getInternalTarget(instruction, function);
+    if(!target) return false;
+
+    // follow unconditional jumps, giving up on cycles
+    std::set<Instruction *> seen{instruction};
+    auto final = target;
+    for(;;) {
+        if(!seen.insert(final).second) return false;
+
+        auto cfi = dynamic_cast<ControlFlowInstruction *>(
+            final->getSemantic());
+        if(!cfi || cfi->getId() != X86_INS_JMP) break;
+        auto next = getInternalTarget(final, function);
+        if(!next) break;
+        final = next;
+    }
+    if(final == target) return false;
+
+    LOG(11, "thread " << instruction->getName() << " to "
+        << final->getName());
+    auto cfi = static_cast<ControlFlowInstruction *>(
+        instruction->getSemantic());
+    auto oldLink = cfi->getLink();
+    cfi->setLink(new NormalLink(final, Link::SCOPE_INTERNAL_JUMP));
+    delete oldLink;
+    ChunkMutator(instruction, false).markFunctionDirty();
+    threaded ++;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool RelaxBranchesPass::removeJumpToNext(Block *block, Block *next,
+    Function *function) {
+
+    auto last = block->getChildren()->getIterable()->getLast();
+    if(getInternalTarget(last, function)
+        != next->getChildren()->getIterable()->get(0)) {
+
+        return false;
+    }
+
+    // a block can't be empty, and other jumps may target its start
+    if(block->getChildren()->getIterable()->getCount() < 2) return false;
+
+    LOG(11, "remove jump to next block " << last->getName());
+    ChunkMutator(block).remove(last);
+    removed ++;
+    return true;
+}
+
+bool RelaxBranchesPass::shrink(Instruction *instruction, Function *function) {
+#ifdef ARCH_X86_64
+    if(!getInternalTarget(instruction, function)) return false;
+
+    auto cfi = static_cast<ControlFlowInstruction *>(
+        instruction->getSemantic());
+    if(cfi->getDisplacementSize() != 4) return false;
+
+    // forward targets move back along with the end of the jump
+    auto oldSize = cfi->getSize();
+    size_t newSize = 1 + 1;  // rel8 jumps all have a one-byte opcode
+    address_t target = cfi->getLink()->getTargetAddress();
+    if(target > instruction->getAddress()) target -= oldSize - newSize;
+    address_t disp = target - (instruction->getAddress() + newSize);
+    if(!PromoteJumpsPass::fitsIn<signed char>(disp)) return false;
+
+    LOG(11, "shrink jump instruction " << instruction->getName());
+    cfi->setOpcode(getNarrowerOpcode(cfi->getId()));
+    cfi->setDisplacementSize(1);
+    ChunkMutator(instruction->getParent())
+        .modifiedChildSize(instruction, -static_cast<int>(oldSize - newSize));
+    shrunk ++;
+    return true;
+#else
+    return false;
+#endif
+}
+
+Instruction *RelaxBranchesPass::getInternalTarget(Instruction *instruction,
+    Function *function) {
+#ifdef ARCH_X86_64
+    // direct jumps that have both a rel8 and a rel32 form
+    auto cfi = dynamic_cast<ControlFlowInstruction *>(
+        instruction->getSemantic());
+    if(!cfi || !cfi->getLink() || cfi->getLink()->isExternalJump()) {
+        return nullptr;
+    }
+    if(getNarrowerOpcode(cfi->getId()).empty()) return nullptr;
+
+    auto target = dynamic_cast<Instruction *>(cfi->getLink()->getTarget());
+    if(!target || !target->getParent()
+        || target->getParent()->getParent() != function) {
+
+        return nullptr;
+    }
+    return target;
+#else
+    return nullptr;
+#endif
+}
+
+std::string RelaxBranchesPass::getNarrowerOpcode(unsigned int id) {
+    std::string opcode;
+#define WRITE_BYTE(b) opcode += static_cast<unsigned char>(b)
+    switch(id) {
+    case X86_INS_JMP:     WRITE_BYTE(0xeb); break;
+    case X86_INS_JO:      WRITE_BYTE(0x70); break;
+    case X86_INS_JNO:     WRITE_BYTE(0x71); break;
+    case X86_INS_JB:      WRITE_BYTE(0x72); break;
+    case X86_INS_JAE:     WRITE_BYTE(0x73); break;
+    case X86_INS_JE:      WRITE_BYTE(0x74); break;
+    case X86_INS_JNE:     WRITE_BYTE(0x75); break;
+    case X86_INS_JBE:     WRITE_BYTE(0x76); break;
+    case X86_INS_JA:      WRITE_BYTE(0x77); break;
+    case X86_INS_JS:      WRITE_BYTE(0x78); break;
+    case X86_INS_JNS:     WRITE_BYTE(0x79); break;
+    case X86_INS_JP:      WRITE_BYTE(0x7a); break;
+    case X86_INS_JNP:     WRITE_BYTE(0x7b); break;
+    case X86_INS_JL:      WRITE_BYTE(0x7c); break;
+    case X86_INS_JGE:     WRITE_BYTE(0x7d); break;
+    case X86_INS_JLE:     WRITE_BYTE(0x7e); break;
+    case X86_INS_JG:      WRITE_BYTE(0x7f); break;
+    default:
+        break;
+    }
+#undef WRITE_BYTE
+    return opcode;
+}
@@ -0,0 +1,38 @@
+#ifndef EGALITO_PASS_RELAX_BRANCHES_H
+#define EGALITO_PASS_RELAX_BRANCHES_H
+
+#include <string>
+#include "chunkpass.h"
+
+/** Removes redundant branches within functions, repeating until nothing
+    changes: jumps to jumps are threaded to the final target, jumps to the
+    next block are deleted, and rel32 jumps that fit are shrunk to rel8.
+
+    Only jumps to the same function are touched; their displacements do
+    not depend on where the function is placed, so this runs before
+    addresses are assigned and the smaller functions get smaller slots.
+    This whole pass is x86_64-specific.
+*/
+class RelaxBranchesPass : public ChunkPass {
+private:
+    size_t threaded;
+    size_t removed;
+    size_t shrunk;
+    size_t bytesSaved;
+public:
+    RelaxBranchesPass() : threaded(0), removed(0), shrunk(0), bytesSaved(0) {}
+
+    virtual void visit(Module *module);
+    virtual void visit(Function *function);
+
+    size_t getBytesSaved() const { return bytesSaved; }
+private:
+    bool thread(Instruction *instruction, Function *function);
+    bool removeJumpToNext(Block *block, Block *next, Function *function);
+    bool shrink(Instruction *instruction, Function *function);
+    static Instruction *getInternalTarget(Instruction *instruction,
+        Function *function);
+    static std::string getNarrowerOpcode(unsigned int id);
+};
+
+#endif
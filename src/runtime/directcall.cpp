@@ -0,0 +1,150 @@
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include "config.h"
+#include "directcall.h"
+#include "chunk/concrete.h"
+#include "chunk/link.h"
+#include "instr/semantic.h"
+
+extern Chunk *egalito_gsCallback;
+
+DirectCallPatcher::DirectCallPatcher(GSTable *gsTable, size_t threshold)
+    : gsTable(gsTable), threshold(threshold),
+    entryCount(JIT_TABLE_SIZE / sizeof(address_t)),
+    pendingCount(0), patchedCount(0), patchCount(0) {
+
+    size_t size = 2 * entryCount * sizeof(uint32_t)
+        + MAX_SITES * sizeof(PendingSite) + MAX_SITES * sizeof(PatchedSite);
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED) throw std::bad_alloc();
+
+    // zero-filled, and ordered so that every array stays aligned
+    auto p = static_cast<char *>(mem);
+    this->pending = reinterpret_cast<PendingSite *>(p);
+    p += MAX_SITES * sizeof(PendingSite);
+    this->patched = reinterpret_cast<PatchedSite *>(p);
+    p += MAX_SITES * sizeof(PatchedSite);
+    this->resolveCount = reinterpret_cast<uint32_t *>(p);
+    p += entryCount * sizeof(uint32_t);
+    this->pendingHead = reinterpret_cast<uint32_t *>(p);
+}
+
+void DirectCallPatcher::scan(Chunk *chunk) {
+    auto array = static_cast<address_t *>(gsTable->getTableAddress());
+    auto callbackAddress
+        = array[gsTable->getEntryFor(egalito_gsCallback)->getIndex()];
+
+    for(auto b : chunk->getChildren()->genericIterable()) {
+        auto block = static_cast<Block *>(b);
+        for(auto i : CIter::children(block)) {
+            auto link = dynamic_cast<GSTableLink *>(
+                i->getSemantic()->getLink());
+            if(!link) continue;
+
+            auto target = link->getTarget();
+            if(!dynamic_cast<Function *>(target)
+                && !dynamic_cast<PLTTrampoline *>(target)) continue;
+
+            auto site = i->getAddress();
+            if(!isGSJump(site)) continue;
+
+            // the entry being resolved right now temporarily holds 0
+            auto index = link->getEntry()->getIndex();
+            if(index >= entryCount) continue;
+            if(array[index] != callbackAddress && array[index] != 0) {
+                // code is still writable, no need to mprotect
+                if(isHot(index)) patch(site, array[index]);
+            }
+            else {
+                addPending(index, site);
+            }
+        }
+    }
+}
+
+void DirectCallPatcher::resolved(size_t index, address_t address) {
+    if(index >= entryCount) return;
+    resolveCount[index] ++;
+
+    auto next = pendingHead[index];
+    if(!next) return;
+
+    if(isHot(index)) {
+        for(; next; next = pending[next - 1].next) {
+            // patched code is already finalized
+            auto site = pending[next - 1].site;
+            setWritable(site, true);
+            patch(site, address);
+            setWritable(site, false);
+        }
+    }
+    pendingHead[index] = 0;
+}
+
+void DirectCallPatcher::reset() {
+    for(size_t i = 0; i < patchedCount; i ++) {
+        // the site may have been regenerated (or cleared) since
+        auto &record = patched[i];
+        auto site = reinterpret_cast<void *>(record.site);
+        if(std::memcmp(site, record.patched, PATCH_SIZE) != 0) continue;
+
+        setWritable(record.site, true);
+        std::memcpy(site, record.original, PATCH_SIZE);
+        setWritable(record.site, false);
+    }
+    patchedCount = 0;
+
+    for(size_t i = 0; i < pendingCount; i ++) {
+        pendingHead[pending[i].index] = 0;
+    }
+    pendingCount = 0;
+}
+
+bool DirectCallPatcher::isHot(size_t index) const {
+    return index < entryCount && resolveCount[index] >= threshold;
+}
+
+bool DirectCallPatcher::isGSJump(address_t site) {
+    // jmpq *%gs:offset
+    auto bytes = reinterpret_cast<const unsigned char *>(site);
+    return bytes[0] == 0x65 && bytes[1] == 0xff
+        && bytes[2] == 0x24 && bytes[3] == 0x25;
+}
+
+void DirectCallPatcher::addPending(size_t index, address_t site) {
+    if(pendingCount == MAX_SITES) return;
+
+    auto &record = pending[pendingCount ++];
+    record.site = site;
+    record.index = index;
+    record.next = pendingHead[index];
+    pendingHead[index] = pendingCount;
+}
+
+void DirectCallPatcher::patch(address_t site, address_t target) {
+    diff_t disp = target - (site + 5);
+    if(disp != static_cast<int32_t>(disp)) return;
+    if(patchedCount == MAX_SITES) return;   // could not undo it
+
+    // jmp rel32; nopl (%rax)
+    auto &record = patched[patchedCount ++];
+    unsigned char bytes[PATCH_SIZE] = {0xe9, 0, 0, 0, 0, 0x0f, 0x1f, 0x00};
+    int32_t disp32 = disp;
+    std::memcpy(&bytes[1], &disp32, 4);
+    record.site = site;
+    std::memcpy(record.original, reinterpret_cast<void *>(site), PATCH_SIZE);
+    std::memcpy(record.patched, bytes, PATCH_SIZE);
+
+    // only this thread runs this code, and it is inside the fixup now
+    std::memcpy(reinterpret_cast<void *>(site), bytes, PATCH_SIZE);
+    patchCount ++;
+}
+
+void DirectCallPatcher::setWritable(address_t site, bool writable) {
+    auto page = site & ~0xfff;
+    auto length = ((site + PATCH_SIZE + 0xfff) & ~0xfff) - page;
+    mprotect((void *)page, length, PROT_READ
+        | (writable ? PROT_WRITE | PROT_EXEC : PROT_EXEC));
+}
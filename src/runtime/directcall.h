@@ -0,0 +1,74 @@
+#ifndef EGALITO_RUNTIME_DIRECT_CALL_H
+#define EGALITO_RUNTIME_DIRECT_CALL_H
+
+#include <cstdint>
+#include "types.h"
+
+class Chunk;
+class GSTable;
+
+/** Back-patches jmpq *%gs:offset call sites in JIT'd code into direct
+    jumps, once the GS entry they go through is resolved and hot.
+
+    An entry resolves at most once per shuffling period, so the number of
+    resolutions counts the periods in which its target was needed; entries
+    resolved in at least threshold periods are considered hot and stable.
+
+    Every patch is undone on reset (see ManageGS::resetEntries), since it
+    jumps straight to a copy that belongs to the ending period. All records
+    live in fixed-size arrays mapped up front: the patcher is used from the
+    fixup hook, which must not allocate. Sites beyond their capacity are
+    simply left alone.
+*/
+class DirectCallPatcher {
+public:
+    enum {
+        MAX_SITES = 0x1000,     // pending and patched sites, each
+        PATCH_SIZE = 8
+    };
+private:
+    struct PendingSite {
+        address_t site;
+        uint32_t index;
+        uint32_t next;          // 1-based into pending, 0 ends the list
+    };
+    struct PatchedSite {
+        address_t site;
+        unsigned char original[PATCH_SIZE];
+        unsigned char patched[PATCH_SIZE];
+    };
+
+    GSTable *gsTable;
+    size_t threshold;
+    size_t entryCount;
+    uint32_t *resolveCount;     // per GS entry
+    uint32_t *pendingHead;      // per GS entry, 1-based into pending
+    PendingSite *pending;
+    size_t pendingCount;
+    PatchedSite *patched;
+    size_t patchedCount;
+    size_t patchCount;
+public:
+    /** May throw std::bad_alloc. Not to be called from the fixup hook. */
+    DirectCallPatcher(GSTable *gsTable, size_t threshold);
+
+    GSTable *getGSTable() const { return gsTable; }
+
+    /** Called on freshly generated code, while it is still writable. */
+    void scan(Chunk *chunk);
+    /** Called once the GS entry at index points at address. */
+    void resolved(size_t index, address_t address);
+    /** Restores every patched site that still holds its patch, and drops
+        the pending sites. Called when the GS table is reset. */
+    void reset();
+
+    size_t getPatchCount() const { return patchCount; }
+private:
+    bool isHot(size_t index) const;
+    static bool isGSJump(address_t site);
+    void addPending(size_t index, address_t site);
+    void patch(address_t site, address_t target);
+    static void setWritable(address_t site, bool writable);
+};
+
+#endif
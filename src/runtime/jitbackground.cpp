@@ -0,0 +1,119 @@
+#include <sys/mman.h>
+#include "config.h"
+#include "jitbackground.h"
+#include "managegs.h"
+#include "chunk/concrete.h"
+#include "chunk/tls.h"
+#include "transform/generator.h"
+
+JITBackground *JITBackground::spawn(ShufflingSandbox *sandbox,
+    GSTable *gsTable) {
+
+    auto addressTable = mmap(NULL, JIT_TABLE_SIZE, PROT_READ|PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    auto background = new JITBackground(sandbox, gsTable, addressTable);
+
+    // the worker shares our GS table, but has its own JIT address table
+    volatile size_t barrier = 0;
+    EgalitoTLS child(&barrier, gsTable, sandbox, addressTable);
+    EgalitoTLS::setChild(&child);
+
+    pthread_t thread;
+    int status = pthread_create(&thread, nullptr,
+        &JITBackground::threadMain, background);
+
+    EgalitoTLS::setChild(nullptr);
+
+    if(status != 0) {
+        munmap(addressTable, JIT_TABLE_SIZE);
+        delete background;
+        return nullptr;
+    }
+    while(!barrier);    // careful: no memory fence here
+    return background;
+}
+
+JITBackground::JITBackground(ShufflingSandbox *sandbox, GSTable *gsTable,
+    void *addressTable) : sandbox(sandbox), gsTable(gsTable),
+    addressTable(addressTable), state(STATE_RETIRING),
+    publishCount(0), waitCount(0) {
+
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&cond, nullptr);
+}
+
+void JITBackground::publish(Chunk *callback) {
+    pthread_mutex_lock(&mutex);
+    if(state != STATE_READY) {
+        waitCount ++;
+        if(state == STATE_RETIRING) {
+            // we are inside the reset hook, so the other half is idle
+            state = STATE_PREPARING;
+            pthread_cond_broadcast(&cond);
+        }
+        while(state != STATE_READY) {
+            pthread_cond_wait(&cond, &mutex);
+        }
+    }
+
+    sandbox->flip();
+    ManageGS::publishEntries(gsTable,
+        static_cast<address_t *>(addressTable), callback);
+    state = STATE_RETIRING;
+    publishCount ++;
+    pthread_mutex_unlock(&mutex);
+}
+
+void JITBackground::startPreparing() {
+    pthread_mutex_lock(&mutex);
+    if(state == STATE_RETIRING) {
+        state = STATE_PREPARING;
+        pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void JITBackground::run() {
+    for(;;) {
+        pthread_mutex_lock(&mutex);
+        while(state != STATE_PREPARING) {
+            pthread_cond_wait(&cond, &mutex);
+        }
+        pthread_mutex_unlock(&mutex);
+
+        prepare();
+
+        pthread_mutex_lock(&mutex);
+        state = STATE_READY;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+void JITBackground::prepare() {
+    // the application thread does not flip while we are preparing
+    auto half = sandbox->getOther();
+    half->reopen();
+    half->recreate();
+    ManageGS::clearAddressTable(gsTable, addressTable);
+
+    // addresses go into this thread's JIT address table
+    Generator generator(half, true);
+    for(auto gsEntry : CIter::children(gsTable)) {
+        if(gsEntry->getIndex() == gsTable->getJITStartIndex()) break;
+
+        auto target = gsEntry->getTarget();
+        if(auto f = dynamic_cast<Function *>(target)) {
+            generator.assignAndGenerate(f);
+        }
+        else if(auto trampoline = dynamic_cast<PLTTrampoline *>(target)) {
+            generator.assignAndGenerate(trampoline);
+        }
+    }
+    half->finalize();
+}
+
+void *JITBackground::threadMain(void *arg) {
+    static_cast<JITBackground *>(arg)->run();
+    return nullptr;
+}
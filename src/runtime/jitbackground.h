@@ -0,0 +1,69 @@
+#ifndef EGALITO_RUNTIME_JIT_BACKGROUND_H
+#define EGALITO_RUNTIME_JIT_BACKGROUND_H
+
+#include <pthread.h>
+#include "transform/sandbox.h"
+
+class Chunk;
+class GSTable;
+
+/** Prepares the next JIT-shuffling generation on a dedicated thread.
+
+    Each generation lives in one half of the DualSandbox: the reserved GS
+    entries first, then whatever is JIT'd during the period. While the
+    application runs out of the current half, the worker regenerates the
+    reserved entries into the other half, recording their addresses in its
+    own JIT address table. A reset then only has to flip the sandbox and
+    publish those addresses into the GS table.
+
+    The other half is only recreated once the application has passed
+    through the reset hook again after the last publish. Like a reset
+    itself, that is a quiescent point: no frame executes or returns into
+    the half retired by the publish any more. (A JIT fixup is not; it may
+    be taken from code still running in the old half.)
+
+    Reserved entries were emitted once on the application thread before
+    the worker starts, so the worker only copies their caches; any
+    Assembly it needs is built under the AssemblyFactory lock.
+*/
+class JITBackground {
+public:
+    enum State {
+        STATE_RETIRING,     // other half may still be executing
+        STATE_PREPARING,    // worker is generating into the other half
+        STATE_READY,        // next generation can be published
+    };
+private:
+    ShufflingSandbox *sandbox;
+    GSTable *gsTable;
+    void *addressTable;
+    volatile State state;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    size_t publishCount;
+    size_t waitCount;
+public:
+    /** Starts a worker for the calling thread's sandbox and GS table. */
+    static JITBackground *spawn(ShufflingSandbox *sandbox, GSTable *gsTable);
+
+    /** Called on the application thread on every pass through the reset
+        hook, including those below the reset threshold. */
+    void noteQuiescent()
+        { if(state == STATE_RETIRING) startPreparing(); }
+
+    /** Called on the application thread on reset. Waits if the worker has
+        not finished preparing the next generation yet. */
+    void publish(Chunk *callback);
+
+    size_t getPublishCount() const { return publishCount; }
+    size_t getWaitCount() const { return waitCount; }
+private:
+    JITBackground(ShufflingSandbox *sandbox, GSTable *gsTable,
+        void *addressTable);
+    void startPreparing();
+    void run();
+    void prepare();
+    static void *threadMain(void *arg);
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include <cstdio>  // for std::snprintf
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "jitstats.h"
+
+JITStatsSegment *JITStatsSegment::create(int pid) {
+    char path[64];
+    getPath(pid, path, sizeof(path));
+
+    // a stale segment may be left from an earlier process with this pid;
+    // O_EXCL never follows a file planted in its place
+    unlink(path);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0) return nullptr;
+    if(ftruncate(fd, sizeof(JITStatsSegment)) != 0) {
+        close(fd);
+        unlink(path);
+        return nullptr;
+    }
+    void *mem = mmap(nullptr, sizeof(JITStatsSegment),
+        PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) {
+        unlink(path);
+        return nullptr;
+    }
+
+    // the file is zero-filled, so every block starts out empty
+    auto segment = static_cast<JITStatsSegment *>(mem);
+    segment->version = VERSION;
+    segment->maxThreads = MAX_THREADS;
+    __atomic_store_n(&segment->magic, MAGIC, __ATOMIC_RELEASE);
+    return segment;
+}
+
+void JITStatsSegment::getPath(int pid, char *buffer, unsigned long size) {
+    std::snprintf(buffer, size, "/dev/shm/egalito-stats.%d", pid);
+}
+
+JITStats *JITStatsSegment::claim() {
+    // stop counting once full, so threadCount cannot wrap around
+    auto index = __atomic_load_n(&threadCount, __ATOMIC_RELAXED);
+    do {
+        if(index >= maxThreads) return nullptr;
+    } while(!__atomic_compare_exchange_n(&threadCount, &index, index + 1,
+        true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    return &threads[index];
+}
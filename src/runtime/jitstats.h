@@ -0,0 +1,70 @@
+#ifndef EGALITO_RUNTIME_JIT_STATS_H
+#define EGALITO_RUNTIME_JIT_STATS_H
+
+#include <cstdint>
+
+/** Counters for one thread of the JIT-shuffling runtime.
+
+    Only the owning thread writes its block, using relaxed stores, so the
+    fixup path takes no lock and no locked instruction. A reader (etstat)
+    may see a slightly stale block, but never a torn counter.
+*/
+struct JITStats {
+    uint64_t tid;
+    uint64_t fixups;
+    uint64_t fixupNanos;
+    uint64_t bytesGenerated;    // by fixups, over the whole run
+    uint64_t resets;
+    uint64_t resetNanos;
+    uint64_t lastResetNanos;
+    uint64_t bytesRegenerated;  // by the last reset
+    uint64_t initNanos;         // first egalito_jit_gs_init on this thread
+    uint64_t entriesSet;        // GS entries resolved by ManageGS
+    uint64_t sandboxUsed;       // bytes generated in the current period
+    uint64_t sandboxSize;
+    uint64_t tableEntries;      // GS table size, to compare with the next
+    uint64_t tableResetNanos;   // last ManageGS::resetEntries alone
+
+    void add(uint64_t &counter, uint64_t value)
+        { __atomic_store_n(&counter, counter + value, __ATOMIC_RELAXED); }
+    void set(uint64_t &counter, uint64_t value)
+        { __atomic_store_n(&counter, value, __ATOMIC_RELAXED); }
+};
+
+/** Shared memory segment with the JITStats of every thread, created at
+    /dev/shm/egalito-stats.<pid> (mode 0600) when EGALITO_JIT_STATS is set.
+    The process cannot remove the file itself: it exits through the
+    target's libc, which never runs the loader's atexit handlers. Instead
+    etstat unlinks the file as soon as it has mapped it, so the segment
+    can be read once and disappears with the last mapping.
+*/
+struct JITStatsSegment {
+    static const uint64_t MAGIC = 0x5354415453544745ull;  // "EGTSTATS"
+    static const uint32_t VERSION = 2;
+    static const uint32_t MAX_THREADS = 256;
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t maxThreads;
+    uint32_t threadCount;   // never exceeds maxThreads
+    uint32_t reserved;
+    JITStats threads[MAX_THREADS];
+
+    /** Called by the loader; returns nullptr on failure. */
+    static JITStatsSegment *create(int pid);
+    /** Writes the segment path for pid into buffer. */
+    static void getPath(int pid, char *buffer, unsigned long size);
+
+    /** Claims a block, or returns nullptr if all are taken. The owning
+        thread fills in the tid, since the block may be claimed for a child
+        thread before it exists.
+    */
+    JITStats *claim();
+
+    /** Cached in EgalitoTLS by a thread that found the segment full, so
+        that it does not try to claim a block again.
+    */
+    static JITStats *noSlot() { return reinterpret_cast<JITStats *>(1); }
+};
+
+#endif
@@ -2,6 +2,7 @@
     #define _GNU_SOURCE
 #endif
 #include <iomanip>
+#include <chrono>
 
 #ifdef ARCH_X86_64
     #include <asm/prctl.h>
@@ -15,6 +16,9 @@
 #include "managegs.h"
 #include "chunk/concrete.h"
 #include "chunk/tls.h"
+#include "runtime/jitstats.h"
+#include "runtime/directcall.h"
+#include "util/explicit_bzero.h"
 
 #undef DEBUG_GROUP
 #define DEBUG_GROUP load
@@ -25,6 +29,12 @@ extern "C" int arch_prctl(int code, unsigned long addr);
 extern Chunk *egalito_gsCallback;
 extern bool egalito_init_done;
 
+/** This thread's block in the EGALITO_JIT_STATS segment, if it has one. */
+static JITStats *getJITStats() {
+    auto stats = EgalitoTLS::getJITStats();
+    return (stats == JITStatsSegment::noSlot() ? nullptr : stats);
+}
+
 void ManageGS::init(GSTable *gsTable) {
 #ifdef ARCH_X86_64
     assert(egalito_gsCallback);
@@ -45,6 +55,7 @@ void ManageGS::init(GSTable *gsTable) {
     LOG(1, "Signal table at " << std::hex << signalBuffer);
     gsTable->setSignalTableAddress(signalBuffer);
 
+    ManageGS::buildResetImage(gsTable, egalito_gsCallback);
     ManageGS::resetEntries(gsTable, egalito_gsCallback);
     //if(1) { // to debug RELEASE_BUILD
     IF_LOG(1) {
@@ -89,6 +100,10 @@ void ManageGS::setEntry(GSTable *gsTable, GSTableEntry::IndexType index,
     assert(index < JIT_TABLE_SIZE/sizeof(address_t));
     address_t *array = static_cast<address_t *>(gsTable->getTableAddress());
     array[index] = value;
+
+    if(auto stats = getJITStats()) {
+        stats->add(stats->entriesSet, 1);
+    }
 }
 
 address_t ManageGS::getEntry(GSTableEntry::IndexType offset) {
@@ -103,12 +118,75 @@ address_t ManageGS::getEntry(GSTableEntry::IndexType offset) {
     return address;
 }
 
+void ManageGS::buildResetImage(GSTable *gsTable, Chunk *callback) {
+    // as large as the table itself, since JIT entries are still appended
+    // after this; page-aligned, so resets copy whole cache lines
+    const size_t count = JIT_TABLE_SIZE/sizeof(address_t);
+    auto jitStart = gsTable->getJITStartIndex();
+
+    auto image = static_cast<address_t *>(mmap(NULL,
+        JIT_TABLE_SIZE, PROT_READ|PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if(image == MAP_FAILED) return;
+
+    for(auto entry : CIter::children(gsTable)) {
+        auto i = entry->getIndex();
+        if(i == jitStart) break;
+
+        // like egalito_jit_gs_setup, which gives these a JIT address slot
+        auto target = entry->getTarget();
+        if(dynamic_cast<AbsolutePosition *>(target->getPosition())) {
+            image[i] = target->getAddress();
+        }
+        else {
+            image[i] = 0;
+            gsTable->addMovableEntry(entry);
+        }
+    }
+    auto addr = callback->getAddress();
+    for(size_t i = jitStart; i < count; i++) {
+        image[i] = addr;
+    }
+
+    // every thread's copy of the GS table shares the same image
+    mprotect(image, JIT_TABLE_SIZE, PROT_READ);
+    gsTable->setResetImage(image);
+}
+
+/** Direct jumps patched in during the period would keep going to the
+    copies they were patched for, so they are undone with every reset. */
+static void undoDirectCalls(GSTable *gsTable) {
+    if(!egalito_init_done) return;
+
+    auto patcher = EgalitoTLS::getJITDirectCalls();
+    if(patcher && patcher->getGSTable() == gsTable) patcher->reset();
+}
+
 void ManageGS::resetEntries(GSTable *gsTable, Chunk *callback) {
+    auto stats = getJITStats();
+    std::chrono::steady_clock::time_point startTime;
+    if(stats) startTime = std::chrono::steady_clock::now();
+
+    undoDirectCalls(gsTable);
+
     address_t *array = static_cast<address_t *>(gsTable->getTableAddress());
+    address_t *image = gsTable->getResetImage();
     auto jitStart = gsTable->getJITStartIndex();
     auto jitEnd = gsTable->getChildren()->getIterable()->getCount();
 
-    if(egalito_init_done) {
+    if(egalito_init_done && image) {
+        // a branch-free select the compiler can vectorize
+        auto table = static_cast<address_t *>(
+            EgalitoTLS::getJITAddressTable());
+        for(size_t i = 0; i < jitStart; i++) {
+            array[i] = table[i] ? table[i] : image[i];
+        }
+        for(auto entry : gsTable->getMovableEntries()) {
+            auto i = entry->getIndex();
+            if(!table[i]) array[i] = entry->getTarget()->getAddress();
+        }
+    }
+    else if(egalito_init_done) {
         auto table = EgalitoTLS::getJITAddressTable();
         std::memcpy(&array[0], table, jitStart*sizeof(address_t));
         for(auto entry : CIter::children(gsTable)) {
@@ -129,10 +207,58 @@ void ManageGS::resetEntries(GSTable *gsTable, Chunk *callback) {
         }
     }
 
-    // should be < 10us without vector instructions
+    // the callback is only regenerated if it is itself a reserved entry
     auto addr = callback->getAddress();
+    if(image && jitEnd > jitStart && image[jitStart] == addr) {
+        std::memcpy(&array[jitStart], &image[jitStart],
+            (jitEnd - jitStart)*sizeof(address_t));
+    }
+    else {
+        for(size_t i = jitStart; i < jitEnd; i++) {
+            array[i] = addr;
+        }
+    }
+
+    if(stats) {
+        stats->set(stats->tableEntries, jitEnd);
+        stats->set(stats->tableResetNanos,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - startTime).count());
+    }
+}
+
+void ManageGS::clearAddressTable(GSTable *gsTable, void *addressTable) {
+    auto count = gsTable->getChildren()->getIterable()->getCount();
+    explicit_bzero(addressTable, count*sizeof(address_t));
+}
+
+void ManageGS::publishEntries(GSTable *gsTable, const address_t *addressTable,
+    Chunk *callback) {
+
+    undoDirectCalls(gsTable);
+
+    address_t *array = static_cast<address_t *>(gsTable->getTableAddress());
+    auto jitStart = gsTable->getJITStartIndex();
+    auto jitEnd = gsTable->getChildren()->getIterable()->getCount();
+
+    for(auto entry : CIter::children(gsTable)) {
+        auto i = entry->getIndex();
+        if(i == jitStart) break;
+
+        // single aligned stores; no entry is ever seen half-written
+        if(addressTable[i]) {
+            __atomic_store_n(&array[i], addressTable[i], __ATOMIC_RELEASE);
+        }
+        else {
+            __atomic_store_n(&array[i], entry->getTarget()->getAddress(),
+                __ATOMIC_RELEASE);
+        }
+    }
+
+    auto addr = addressTable[gsTable->getEntryFor(callback)->getIndex()];
+    if(!addr) addr = callback->getAddress();
     for(size_t i = jitStart; i < jitEnd; i++) {
-        array[i] = addr;
+        __atomic_store_n(&array[i], addr, __ATOMIC_RELEASE);
     }
 }
 
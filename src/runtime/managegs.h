@@ -14,7 +14,18 @@ public:
 
     static address_t getEntry(GSTableEntry::IndexType offset);
 
+    /** Precomputes the table contents after a reset: fixed addresses for
+        the reserved entries (except movable ones, see GSTable) and the
+        callback for every JIT entry, up to the full table size so that
+        entries added later are covered. */
+    static void buildResetImage(GSTable *gsTable, Chunk *callback);
     static void resetEntries(GSTable *gsTable, Chunk *callback);
+    /** Zeroes only the part of a JIT address table the GS table can use. */
+    static void clearAddressTable(GSTable *gsTable, void *addressTable);
+    /** Like resetEntries, but takes reserved addresses from addressTable
+        (a JIT address table filled on another thread). */
+    static void publishEntries(GSTable *gsTable, const address_t *addressTable,
+        Chunk *callback);
     static Chunk *resolve(GSTable *gsTable, GSTableEntry::IndexType index);
 };
 
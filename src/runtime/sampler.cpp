@@ -0,0 +1,103 @@
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE  // for REG_RIP
+#endif
+#include <cstdlib>  // for std::atoi
+#include <fcntl.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "sampler.h"
+#include "conductor/conductor.h"
+#include "chunk/concrete.h"
+#include "operation/find2.h"
+
+#undef DEBUG_GROUP
+#define DEBUG_GROUP load
+#include "log/log.h"
+
+// 8 MB of samples, about 2.3 hours at the default rate
+#define DEFAULT_SAMPLE_CAPACITY     (1ul << 20)
+// prime, so sampling does not lock step with periodic program behaviour
+#define DEFAULT_SAMPLE_HZ           127
+
+SampleBuffer *egalito_sample_buffer = nullptr;
+
+extern "C"
+void egalito_sample_handler(int signum, siginfo_t *info, void *context) {
+    auto buffer = egalito_sample_buffer;
+    if(!buffer) return;
+
+    auto uc = static_cast<ucontext_t *>(context);
+#ifdef ARCH_X86_64
+    buffer->record(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(ARCH_AARCH64)
+    buffer->record(uc->uc_mcontext.pc);
+#elif defined(ARCH_RISCV)
+    buffer->record(uc->uc_mcontext.__gregs[REG_PC]);
+#endif
+}
+
+SampleBuffer *SampleBuffer::create(const char *filename, uint64_t capacity,
+    uint32_t hz) {
+
+    size_t size = sizeof(SampleBuffer) + capacity * sizeof(uint64_t);
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) return nullptr;
+    if(ftruncate(fd, size) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) return nullptr;
+
+    auto buffer = static_cast<SampleBuffer *>(mem);
+    buffer->version = VERSION;
+    buffer->hz = hz;
+    buffer->capacity = capacity;
+    buffer->magic = MAGIC;
+    return buffer;
+}
+
+bool SamplingProfiler::start(Conductor *conductor, const char *filename) {
+    uint32_t hz = DEFAULT_SAMPLE_HZ;
+    if(auto s = getenv("EGALITO_SAMPLE_HZ")) {
+        if(std::atoi(s) > 0) hz = std::atoi(s);
+    }
+    if(hz > 10000) hz = 10000;
+
+    // the runtime copy of the handler, not the loader's
+    auto handler = ChunkFind2(conductor).findFunctionInModule(
+        "egalito_sample_handler", conductor->getProgram()->getEgalito());
+    if(!handler) {
+        LOG(0, "WARNING: egalito_sample_handler not found, not sampling");
+        return false;
+    }
+
+    auto buffer = SampleBuffer::create(filename, DEFAULT_SAMPLE_CAPACITY, hz);
+    if(!buffer) {
+        LOG(0, "WARNING: unable to create sample file [" << filename << "]");
+        return false;
+    }
+    ::egalito_sample_buffer = buffer;
+
+    struct sigaction action = {};
+    action.sa_sigaction = reinterpret_cast<void (*)(int, siginfo_t *, void *)>(
+        handler->getAddress());
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(sigaction(SIGPROF, &action, nullptr) != 0) return false;
+
+    struct itimerval timer = {};
+    timer.it_interval.tv_sec = 1 / hz;
+    timer.it_interval.tv_usec = (hz > 1 ? 1000000 / hz : 0);
+    timer.it_value = timer.it_interval;
+    if(setitimer(ITIMER_PROF, &timer, nullptr) != 0) return false;
+
+    LOG(1, "sampling at " << hz << " Hz into [" << filename << "]");
+    return true;
+}
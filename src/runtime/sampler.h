@@ -0,0 +1,46 @@
+#ifndef EGALITO_RUNTIME_SAMPLER_H
+#define EGALITO_RUNTIME_SAMPLER_H
+
+#include <cstdint>
+
+class Conductor;
+
+/** File of program counters sampled at SIGPROF (EGALITO_SAMPLE=file).
+
+    The file is mapped shared, so samples reach it without any flush, even
+    if the program exits through _exit or a fatal signal. Once capacity is
+    reached, further samples are only counted.
+*/
+struct SampleBuffer {
+    static const uint64_t MAGIC = 0x454c504d41534745ull;  // "EGSAMPLE"
+    static const uint32_t VERSION = 1;
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t hz;
+    uint64_t capacity;
+    uint64_t count;         // may exceed capacity
+    uint64_t pcs[];
+
+    /** Returns nullptr on failure. */
+    static SampleBuffer *create(const char *filename, uint64_t capacity,
+        uint32_t hz);
+
+    void record(uint64_t pc) {
+        auto index = __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+        if(index < capacity) pcs[index] = pc;
+    }
+};
+
+/** Low-overhead profiler for code in the loader sandbox. Sandbox PCs are
+    mapped back to functions offline with symbols.elf (see etprofile -s).
+*/
+class SamplingProfiler {
+public:
+    /** Must be called after code is moved into its final location. The
+        ITIMER_PROF timer is inherited across exec, so programs that exec
+        other binaries should not be sampled. */
+    static bool start(Conductor *conductor, const char *filename);
+};
+
+#endif
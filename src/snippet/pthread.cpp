@@ -6,30 +6,81 @@
 #include "conductor/conductor.h"
 #include "cminus/print.h"
 #include "runtime/managegs.h"
+#include "runtime/jitstats.h"
+#include "runtime/directcall.h"
 
 extern ConductorSetup *egalito_conductor_setup;
+extern Sandbox *egalito_jit_shared_sandbox;
+extern JITStatsSegment *egalito_jit_stats;
+extern size_t egalito_jit_direct_calls;
 
 extern "C" void egalito_jit_gs_init(ShufflingSandbox *, GSTable *);
+extern "C" void egalito_jit_gs_recycle(RecyclingSandbox *, GSTable *);
+
+// all threads share the GS table, JIT address table and sandbox
+static int egalito_pthread_create_shared(pthread_t *thread,
+    const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg) {
+
+    volatile size_t barrier = 0;
+    EgalitoTLS child(&barrier, EgalitoTLS::getGSTable(), nullptr,
+        EgalitoTLS::getJITAddressTable(), EgalitoTLS::getJITResetThreshold());
+
+    EgalitoTLS::setChild(&child);
+    int status = pthread_create(thread, attr, start_routine, arg);
+    EgalitoTLS::setChild(nullptr);
+
+    if(status == 0) {
+        while(!barrier);    // careful: no memory fence here
+    }
+    return status;
+}
 
 extern "C"
 int egalito_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
     void *(*start_routine)(void *), void *arg) {
 
+    if(egalito_jit_shared_sandbox) {
+        return egalito_pthread_create_shared(thread, attr, start_routine, arg);
+    }
+
+    // the child's table and sandbox are set up here, on the parent thread;
+    // charge that to a block claimed for the child, not to the parent
+    auto parentStats = EgalitoTLS::getJITStats();
+    JITStats *childStats = nullptr;
+    if(egalito_jit_stats) {
+        childStats = egalito_jit_stats->claim();
+        if(!childStats) childStats = JITStatsSegment::noSlot();
+        EgalitoTLS::setJITStats(childStats);
+    }
+
     auto gsTable = new GSTable(*EgalitoTLS::getGSTable());
     ManageGS::allocateBuffer(gsTable);
-    auto sandbox = egalito_conductor_setup->makeShufflingSandbox();
-
-    egalito_jit_gs_init(sandbox, gsTable);
+    ShufflingSandbox *sandbox = nullptr;
+    RecyclingSandbox *recyclingSandbox = nullptr;
+    if(EgalitoTLS::getRecyclingSandbox()) {
+        recyclingSandbox = egalito_conductor_setup->makeRecyclingSandbox();
+        egalito_jit_gs_recycle(recyclingSandbox, gsTable);
+    }
+    else {
+        sandbox = egalito_conductor_setup->makeShufflingSandbox();
+        egalito_jit_gs_init(sandbox, gsTable);
+    }
+    if(egalito_jit_stats) EgalitoTLS::setJITStats(parentStats);
 
     auto JIT_addressTable = mmap(NULL, JIT_TABLE_SIZE, PROT_READ|PROT_WRITE,
         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
     auto JIT_resetThreshold = EgalitoTLS::getJITResetThreshold();
 
+    DirectCallPatcher *directCalls = nullptr;
+    if(egalito_jit_direct_calls) {
+        directCalls = new DirectCallPatcher(gsTable, egalito_jit_direct_calls);
+    }
+
     // will be consumed before the child is spawned
     volatile size_t barrier = 0;
     EgalitoTLS child(&barrier, gsTable, sandbox, JIT_addressTable,
-        JIT_resetThreshold);
+        JIT_resetThreshold, recyclingSandbox, childStats, directCalls);
 
     EgalitoTLS::setChild(&child);
 
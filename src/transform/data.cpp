@@ -16,7 +16,8 @@
 #define ROUND_UP_BY(x, y)   (((x) + (y) - 1) & ~((y) - 1))
 
 #ifdef USE_LOADER
-address_t DataLoader::allocateTLS(address_t base, size_t size, size_t *offset) {
+address_t DataLoader::allocateTLS(address_t base, size_t size, size_t *offset,
+    size_t *mappedSize) {
 #ifdef ARCH_X86_64
     // header is at the end
     size = ROUND_UP_BY(size, 64);
@@ -51,6 +52,7 @@ address_t DataLoader::allocateTLS(address_t base, size_t size, size_t *offset) {
             throw "TLS: Overlapping with other regions?";
         }
     }
+    if(mappedSize) *mappedSize = ROUND_UP(size);
 
     return tp;
 }
@@ -10,8 +10,10 @@ public:
 #ifdef USE_LOADER
     /** Returns thread pointer for this platform's TLS.
         offset will be incremented by the size of the header.
+        If mappedSize is given, it receives the size of the mapping.
     */
-    address_t allocateTLS(address_t base, size_t size, size_t *offset);
+    address_t allocateTLS(address_t base, size_t size, size_t *offset,
+        size_t *mappedSize = nullptr);
 #endif
     void loadRegion(DataRegion *region);
     address_t loadRegionTo(address_t address, DataRegion *region);
@@ -1,9 +1,12 @@
 #include <iostream>  // for std::cout.flush()
+#include <algorithm>
 #include <iomanip>
 #include <cstdio>  // for std::fflush
 #include <cstring>
+#include <thread>
 #include "generator.h"
 #include "chunk/cache.h"
+#include "chunk/link.h"
 #include "operation/mutator.h"
 #include "operation/find2.h"
 #include "pass/clearspatial.h"
@@ -23,8 +26,13 @@ class GeneratorHelper {
 public:
     void assignAddress(ChunkType *chunk, Slot slot);
     void copyToSandbox(ChunkType *chunk, Sandbox *sandbox);
+    void copyToBuffer(ChunkType *chunk, std::string &buffer);
+    void emit(ChunkType *chunk, char *output);
+    static ChunkCache *getCache(ChunkType *chunk);
+    void addPaddingBytes(ChunkType *chunk, char *output);
 private:
     void addPaddingBytes(ChunkType *chunk, Sandbox *sandbox);
+    void addPaddingBytes(ChunkType *chunk, std::string &buffer);
 };
 
 template <typename ChunkType>
@@ -41,38 +49,67 @@ void GeneratorHelper<ChunkType>::assignAddress(ChunkType *chunk, Slot slot) {
 #endif
 }
 
+template <typename ChunkType>
+ChunkCache *GeneratorHelper<ChunkType>::getCache(ChunkType *chunk) {
+    // a cache taken before the chunk changed size is stale
+    auto cache = chunk->getCache();
+    if(cache && cache->getSize() == chunk->getSize()) return cache;
+    return nullptr;
+}
+
+template <>
+ChunkCache *GeneratorHelper<Function>::getCache(Function *function) {
+    // Function::setDirty(true) discards the cache, but don't rely on every
+    // change being followed by it
+    auto cache = function->getCache();
+    if(cache && !function->isDirty()
+        && cache->getSize() == function->getSize()) {
+
+        return cache;
+    }
+    return nullptr;
+}
+
+template <>
+void GeneratorHelper<Function>::emit(Function *function, char *output) {
+    // output is where the code is stored; it always runs at getAddress()
+    if(auto cache = getCache(function)) {
+        cache->copyAndFix(output, function->getAddress());
+        return;
+    }
+
+    // encode once, straight into the output, and cache that copy
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            InstrWriterCString writer(output
+                + (instr->getAddress() - function->getAddress()));
+            instr->getSemantic()->accept(&writer);
+        }
+    }
+    function->makeCache(output);
+    function->setDirty(false);
+}
+
+template <>
+void GeneratorHelper<Function>::copyToBuffer(Function *function,
+    std::string &buffer) {
+
+    auto start = buffer.length();
+    buffer.resize(start + function->getSize());
+    emit(function, &buffer[start]);
+    addPaddingBytes(function, buffer);
+}
+
 template <>
 void GeneratorHelper<Function>::copyToSandbox(Function *function, Sandbox *sandbox) {
     if(sandbox->supportsDirectWrites()) {
-        char *output = reinterpret_cast<char *>(function->getAddress());
-        if(auto cache = function->getCache()) {
-            //LOG(0, "generating with Cache: " << function->getName());
-            cache->copyAndFix(output);
-            return;
-        }
-        for(auto b : CIter::children(function)) {
-            for(auto i : CIter::children(b)) {
-                LOG(10, " at " << std::hex << i->getAddress());
-                if(true /*useDisps*/) {
-                    InstrWriterCString writer(output);
-                    i->getSemantic()->accept(&writer);
-                }
-                else {
-                    InstrWriterForObjectFile writer(output);
-                    i->getSemantic()->accept(&writer);
-                }
-                output += i->getSemantic()->getSize();
-            }
-        }
+        emit(function, sandbox->getBacking()->getWritableAddress(
+            function->getAddress()));
     }
     else {
         auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
-        InstrWriterCppString writer(backing->getBuffer());
-        for(auto b : CIter::children(function)) {
-            for(auto i : CIter::children(b)) {
-                i->getSemantic()->accept(&writer);
-            }
-        }
+        copyToBuffer(function, backing->getBuffer());
+        return;
     }
     addPaddingBytes(function, sandbox);
 }
@@ -80,10 +117,11 @@ void GeneratorHelper<Function>::copyToSandbox(Function *function, Sandbox *sandb
 template <>
 void GeneratorHelper<PLTTrampoline>::copyToSandbox(PLTTrampoline *trampoline, Sandbox *sandbox) {
     if(sandbox->supportsDirectWrites()) {
-        char *output = reinterpret_cast<char *>(trampoline->getAddress());
-        if(auto cache = trampoline->getCache()) {
+        char *output = sandbox->getBacking()->getWritableAddress(
+            trampoline->getAddress());
+        if(auto cache = getCache(trampoline)) {
             //LOG(0, "generating with Cache: " << function->getName());
-            cache->copyAndFix(output);
+            cache->copyAndFix(output, trampoline->getAddress());
             return;
         }
         trampoline->writeTo(output);
@@ -107,28 +145,51 @@ void GeneratorHelper<PLTTrampoline>::copyToSandbox(PLTTrampoline *trampoline, Sa
 
 template <typename ChunkType>
 void GeneratorHelper<ChunkType>::addPaddingBytes(ChunkType *chunk, Sandbox *sandbox) {
+    if(sandbox->supportsDirectWrites()) {
+        addPaddingBytes(chunk, sandbox->getBacking()->getWritableAddress(
+            chunk->getAddress()));
+    }
+    else {
+        auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
+        addPaddingBytes(chunk, backing->getBuffer());
+    }
+}
+
+template <typename ChunkType>
+void GeneratorHelper<ChunkType>::addPaddingBytes(ChunkType *chunk,
+    char *output) {
+
     auto assignedSize = chunk->getAssignedPosition()->getAssignedSize();
     if(assignedSize > chunk->getSize()) {
         // Add appropriate number of NOP bytes
         auto padding = assignedSize - chunk->getSize();
-        if(sandbox->supportsDirectWrites()) {
-            char *output = reinterpret_cast<char *>(chunk->getAddress());
 #ifdef ARCH_X86_64
-            std::memset(output + chunk->getSize(), 0x90, padding);
+        std::memset(output + chunk->getSize(), 0x90, padding);
 #else
-            // Should use platform-specific NOP here
-            std::memset(output + chunk->getSize(), 0x0, padding);
+        // Should use platform-specific NOP here
+        std::memset(output + chunk->getSize(), 0x0, padding);
 #endif
-        }
-        else {
-            auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
+    }
+    else if(assignedSize < chunk->getSize()) {
+        LOG(0, "ERROR: assigned size " << std::dec << assignedSize
+            << " is too small to store chunk ["
+            << chunk->getName() << "] of size " << chunk->getSize());
+    }
+}
+
+template <typename ChunkType>
+void GeneratorHelper<ChunkType>::addPaddingBytes(ChunkType *chunk,
+    std::string &buffer) {
+
+    auto assignedSize = chunk->getAssignedPosition()->getAssignedSize();
+    if(assignedSize > chunk->getSize()) {
+        auto padding = assignedSize - chunk->getSize();
 #ifdef ARCH_X86_64
-            backing->getBuffer().append(padding, static_cast<char>(0x90));
+        buffer.append(padding, static_cast<char>(0x90));
 #else
-            // Should use platform-specific NOP here
-            backing->getBuffer().append(padding, static_cast<char>(0x0));
+        // Should use platform-specific NOP here
+        buffer.append(padding, static_cast<char>(0x0));
 #endif
-        }
     }
     else if(assignedSize < chunk->getSize()) {
         LOG(0, "ERROR: assigned size " << std::dec << assignedSize
@@ -138,26 +199,45 @@ void GeneratorHelper<ChunkType>::addPaddingBytes(ChunkType *chunk, Sandbox *sand
 }
 
 void Generator::assignAddresses(Program *program) {
+    // cold functions of all modules go after all other code
+    for(auto module : CIter::modules(program)) {
+        assignAddresses(module, pickFunctionOrder(module), PART_HOT);
+    }
     for(auto module : CIter::modules(program)) {
-        assignAddresses(module);
+        assignAddresses(module, pickFunctionOrder(module), PART_COLD);
     }
 }
 
 void Generator::generateCode(Program *program, const std::vector<Function *> &order) {
+    auto complete = completeOrder(program, order);
+    copyFunctionsToSandbox(selectPart(complete, false));
     for(auto module : CIter::modules(program)) {
-        generateCode(module, order);
+        copyPLTsToSandbox(module);
     }
+    copyFunctionsToSandbox(selectPart(complete, true));
 }
 
 void Generator::assignAddresses(Program *program, const std::vector<Function *> &order) {
+    // the order may interleave functions from different modules
+    auto complete = completeOrder(program, order);
+    assignFunctionAddresses(selectPart(complete, false));
     for(auto module : CIter::modules(program)) {
-        assignAddresses(module, order);
+        assignPLTAddresses(module);
+    }
+    assignFunctionAddresses(selectPart(complete, true));
+
+    for(auto module : CIter::modules(program)) {
+        ClearSpatialPass clearSpatial;
+        module->accept(&clearSpatial);
     }
 }
 
 void Generator::generateCode(Program *program) {
     for(auto module : CIter::modules(program)) {
-        generateCode(module);
+        generateCode(module, pickFunctionOrder(module), PART_HOT);
+    }
+    for(auto module : CIter::modules(program)) {
+        generateCode(module, pickFunctionOrder(module), PART_COLD);
     }
 }
 
@@ -194,7 +274,80 @@ std::vector<Function *> Generator::pickFunctionOrder(Module *module) {
 }
 
 void Generator::assignAddresses(Module *module) {
-    auto order = pickFunctionOrder(module);
+    assignAddresses(module, pickFunctionOrder(module), PART_ALL);
+}
+
+void Generator::generateCode(Module *module) {
+    generateCode(module, pickFunctionOrder(module), PART_ALL);
+}
+
+void Generator::assignAddresses(Module *module, const std::vector<Function *> &order) {
+    assignAddresses(module, order, PART_ALL);
+}
+
+void Generator::generateCode(Module *module, const std::vector<Function *> &order) {
+    generateCode(module, order, PART_ALL);
+}
+
+std::vector<Function *> Generator::completeOrder(Program *program,
+    const std::vector<Function *> &order) {
+
+    // e.g. functions added by passes after the order was computed
+    std::set<Function *> seen(order.begin(), order.end());
+    std::vector<Function *> complete = order;
+    for(auto module : CIter::modules(program)) {
+        for(auto f : pickFunctionOrder(module)) {
+            if(seen.find(f) == seen.end()) complete.push_back(f);
+        }
+    }
+    return complete;
+}
+
+std::vector<Function *> Generator::selectPart(
+    const std::vector<Function *> &order, bool cold) {
+
+    std::vector<Function *> part;
+    for(auto f : order) {
+        if(f->isCold() == cold) part.push_back(f);
+    }
+    return part;
+}
+
+void Generator::assignAddresses(Module *module,
+    const std::vector<Function *> &order, int part) {
+
+    if(part & PART_HOT) {
+        assignFunctionAddresses(selectPart(order, false));
+        assignPLTAddresses(module);
+    }
+
+    if(part & PART_COLD) {
+        assignFunctionAddresses(selectPart(order, true));
+
+        ClearSpatialPass clearSpatial;
+        module->accept(&clearSpatial);
+    }
+}
+
+void Generator::generateCode(Module *module,
+    const std::vector<Function *> &order, int part) {
+
+    if(part & PART_HOT) {
+        LOG(1, "Copying code into sandbox");
+        copyFunctionsToSandbox(selectPart(order, false));
+        copyPLTsToSandbox(module);
+    }
+
+    if(part & PART_COLD) {
+        auto cold = selectPart(order, true);
+        if(!cold.empty()) {
+            LOG(1, "Copying cold code into sandbox");
+            copyFunctionsToSandbox(cold);
+        }
+    }
+}
+
+void Generator::assignFunctionAddresses(const std::vector<Function *> &order) {
     for(auto f : order) {
         auto slot = sandbox->allocate(f->getSize());
         LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
@@ -202,81 +355,244 @@ void Generator::assignAddresses(Module *module) {
             << "] size " << std::dec << f->getSize());
         GeneratorHelper<Function>().assignAddress(f, slot);
     }
+}
 
-    if(module->getPLTList()) {
-        // these don't have to be contiguous
-        //const size_t pltSize = PLTList::getPLTTrampolineSize();
-        for(auto plt : CIter::plts(module)) {
-            auto slot = sandbox->allocate(plt->getSize());
-            LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
-                << " for [" << plt->getName()
-                << "] size " << std::dec << plt->getSize());
-            GeneratorHelper<PLTTrampoline>().assignAddress(plt, slot);
-        }
+void Generator::assignPLTAddresses(Module *module) {
+    if(!module->getPLTList()) return;
+
+    // these don't have to be contiguous
+    //const size_t pltSize = PLTList::getPLTTrampolineSize();
+    for(auto plt : CIter::plts(module)) {
+        auto slot = sandbox->allocate(plt->getSize());
+        LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
+            << " for [" << plt->getName()
+            << "] size " << std::dec << plt->getSize());
+        GeneratorHelper<PLTTrampoline>().assignAddress(plt, slot);
+    }
+}
+
+void Generator::copyPLTsToSandbox(Module *module) {
+    if(!module->getPLTList()) return;
+
+    LOG(1, "Copying PLT entries into sandbox");
+    for(auto plt : CIter::plts(module)) {
+        GeneratorHelper<PLTTrampoline>().copyToSandbox(plt, sandbox);
     }
+}
 
-    ClearSpatialPass clearSpatial;
-    module->accept(&clearSpatial);
+void Generator::setThreadCount(size_t count) {
+    if(count == 0) count = std::thread::hardware_concurrency();
+    this->threadCount = std::max(count, static_cast<size_t>(1));
 }
 
-void Generator::generateCode(Module *module) {
-    LOG(1, "Copying code into sandbox");
-    auto order = pickFunctionOrder(module);
+void Generator::copyFunctionsToSandbox(const std::vector<Function *> &order) {
+    IF_LOG(1) {
+        size_t cached = 0;
+        for(auto f : order) {
+            if(GeneratorHelper<Function>::getCache(f)) cached ++;
+        }
+        LOG(1, "    " << std::dec << cached << " of " << order.size()
+            << " functions emitted from an existing cache");
+    }
+
+    if(threadCount > 1 && order.size() > threadCount) {
+        copyFunctionsInParallel(order);
+        return;
+    }
+
     for(auto f : order) {
         LOG(2, "    writing out [" << f->getName() << "] at 0x"
             << std::hex << f->getAddress());
 
         GeneratorHelper<Function>().copyToSandbox(f, sandbox);
     }
+}
 
-    if(module->getPLTList()) {
-        LOG(1, "Copying PLT entries into sandbox");
-        for(auto plt : CIter::plts(module)) {
-            GeneratorHelper<PLTTrampoline>().copyToSandbox(plt, sandbox);
+void Generator::copyFunctionsInParallel(const std::vector<Function *> &order) {
+    // Once addresses have been assigned the functions occupy disjoint
+    // slots, so direct-write sandboxes can be filled in place. Buffer-backed
+    // sandboxes are appended to in order, so the buffer is grown once and
+    // each function is written at its offset (in the same order as assigned).
+    const bool direct = sandbox->supportsDirectWrites();
+    std::vector<char *> outputs;
+    if(direct) {
+        for(auto f : order) {
+            outputs.push_back(sandbox->getBacking()->getWritableAddress(
+                f->getAddress()));
+        }
+    }
+    else {
+        auto &buffer = sandbox->getBacking()->getBuffer();
+        std::vector<size_t> offsets;
+        size_t offset = buffer.length();
+        for(auto f : order) {
+            offsets.push_back(offset);
+            offset += std::max(f->getSize(),
+                f->getAssignedPosition()->getAssignedSize());
+        }
+        buffer.resize(offset);
+        for(auto o : offsets) outputs.push_back(&buffer[o]);
+    }
+
+    // Encoding can build Assembly objects through the shared AssemblyFactory
+    // (and its Disassemble handle), so functions without a cache are
+    // encoded here; the workers below only copy and fix up cached ones.
+    std::vector<size_t> cached;
+    for(size_t i = 0; i < order.size(); i ++) {
+        if(GeneratorHelper<Function>::getCache(order[i])) {
+            cached.push_back(i);
+            continue;
         }
+        GeneratorHelper<Function>().emit(order[i], outputs[i]);
+        GeneratorHelper<Function>().addPaddingBytes(order[i], outputs[i]);
+    }
+    if(cached.empty()) return;
+
+    // each thread takes a contiguous range of the cached functions
+    const size_t count = std::min(threadCount, cached.size());
+    const size_t perThread = (cached.size() + count - 1) / count;
+
+    LOG(1, "    emitting " << std::dec << cached.size()
+        << " cached functions on " << count << " threads");
+
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < count; t ++) {
+        size_t begin = t * perThread;
+        size_t end = std::min(begin + perThread, cached.size());
+        threads.emplace_back([&order, &outputs, &cached, begin, end] () {
+            for(size_t c = begin; c < end; c ++) {
+                auto i = cached[c];
+                GeneratorHelper<Function>().emit(order[i], outputs[i]);
+                GeneratorHelper<Function>().addPaddingBytes(
+                    order[i], outputs[i]);
+            }
+        });
+    }
+    for(auto &thread : threads) {
+        thread.join();
     }
 }
 
-void Generator::assignAddresses(Module *module, const std::vector<Function *> &order) {
-    for(auto f : order) {
+std::vector<Function *> Generator::reassignAddresses(Program *program) {
+    std::vector<Function *> moved;
+    for(auto module : CIter::modules(program)) {
+        auto m = reassignAddresses(module);
+        moved.insert(moved.end(), m.begin(), m.end());
+    }
+    return moved;
+}
+
+std::vector<Function *> Generator::reassignAddresses(Module *module) {
+    std::vector<Function *> moved;
+    for(auto f : pickFunctionOrder(module)) {
+        auto assigned = f->getAssignedPosition();
+        if(assigned && f->getSize() <= assigned->getAssignedSize()) continue;
+
         auto slot = sandbox->allocate(f->getSize());
-        LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
+        LOG(2, "    realloc 0x" << std::hex << slot.getAddress()
             << " for [" << f->getName()
             << "] size " << std::dec << f->getSize());
         GeneratorHelper<Function>().assignAddress(f, slot);
+        moved.push_back(f);
     }
 
-    if(module->getPLTList()) {
-        // these don't have to be contiguous
-        //const size_t pltSize = PLTList::getPLTTrampolineSize();
-        for(auto plt : CIter::plts(module)) {
-            auto slot = sandbox->allocate(plt->getSize());
-            LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
-                << " for [" << plt->getName()
-                << "] size " << std::dec << plt->getSize());
-            GeneratorHelper<PLTTrampoline>().assignAddress(plt, slot);
+    if(!moved.empty()) {
+        ClearSpatialPass clearSpatial;
+        module->accept(&clearSpatial);
+    }
+    return moved;
+}
+
+void Generator::regenerateCode(Program *program,
+    const std::vector<Function *> &moved) {
+
+    // functions whose internal layout changed are treated like moved ones,
+    // since other code may refer to blocks or instructions inside them
+    std::set<Function *> changed(moved.begin(), moved.end());
+    for(auto module : CIter::modules(program)) {
+        for(auto f : CIter::functions(module)) {
+            if(f->isDirty()) changed.insert(f);
         }
     }
 
-    ClearSpatialPass clearSpatial;
-    module->accept(&clearSpatial);
+    for(auto module : CIter::modules(program)) {
+        regenerateCode(module, changed);
+    }
 }
 
-void Generator::generateCode(Module *module, const std::vector<Function *> &order) {
-    LOG(1, "Copying code into sandbox");
-    for(auto f : order) {
-        LOG(2, "    writing out [" << f->getName() << "] at 0x"
-            << std::hex << f->getAddress());
+void Generator::regenerateCode(Module *module,
+    const std::set<Function *> &changed) {
 
-        GeneratorHelper<Function>().copyToSandbox(f, sandbox);
+    size_t emitted = 0, patched = 0;
+    for(auto f : CIter::functions(module)) {
+        if(changed.count(f)) {
+            LOG(2, "    rewriting [" << f->getName() << "] at 0x"
+                << std::hex << f->getAddress());
+            auto assignedSize = f->getAssignedPosition()->getAssignedSize();
+            char *output = getOutputFor(f->getAddress(), assignedSize);
+            GeneratorHelper<Function>().emit(f, output);
+            GeneratorHelper<Function>().addPaddingBytes(f, output);
+            emitted ++;
+            continue;
+        }
+
+        patched += patchReferences(f, changed);
     }
 
     if(module->getPLTList()) {
-        LOG(1, "Copying PLT entries into sandbox");
+        // PLT entries are never dirty, but may jump to moved code
         for(auto plt : CIter::plts(module)) {
-            GeneratorHelper<PLTTrampoline>().copyToSandbox(plt, sandbox);
+            patched += patchReferences(plt, changed);
+        }
+    }
+
+    LOG(1, "Regenerated " << std::dec << emitted << " functions and "
+        << patched << " references in [" << module->getName() << "]");
+}
+
+char *Generator::getOutputFor(address_t address, size_t size) {
+    if(sandbox->supportsDirectWrites()) {
+        return sandbox->getBacking()->getWritableAddress(address);
+    }
+
+    // buffer offsets mirror sandbox addresses, since slots are contiguous
+    auto backing = sandbox->getBacking();
+    auto &buffer = backing->getBuffer();
+    auto offset = address - backing->getBase();
+    if(offset + size > buffer.length()) buffer.resize(offset + size);
+    return &buffer[offset];
+}
+
+size_t Generator::patchReferences(Chunk *chunk,
+    const std::set<Function *> &changed) {
+
+    size_t patched = 0;
+    for(auto b : chunk->getChildren()->genericIterable()) {
+        auto block = static_cast<Block *>(b);
+        for(auto i : CIter::children(block)) {
+            auto semantic = i->getSemantic();
+            auto link = semantic->getLink();
+            if(!link || !refersToChanged(link, changed)) continue;
+
+            char *output = getOutputFor(i->getAddress(), i->getSize());
+            InstrWriterCString writer(output);
+            semantic->accept(&writer);
+            patched ++;
+        }
+    }
+    return patched;
+}
+
+bool Generator::refersToChanged(Link *link,
+    const std::set<Function *> &changed) {
+
+    for(Chunk *c = link->getTarget(); c; c = c->getParent()) {
+        if(auto function = dynamic_cast<Function *>(c)) {
+            return changed.count(function) > 0;
         }
+        if(dynamic_cast<Module *>(c)) break;
     }
+    return false;
 }
 
 void Generator::assignAddressForFunction(Function *function) {
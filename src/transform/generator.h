@@ -2,21 +2,42 @@
 #define EGALITO_TRANSFORM_GENERATOR_H
 
 #include <vector>
+#include <string>
+#include <set>
 #include "sandbox.h"
 
 class PLTTrampoline;
+class Link;
 
 class Generator {
 private:
+    enum Part {
+        PART_HOT = 1 << 0,  // functions not marked cold, then PLT entries
+        PART_COLD = 1 << 1,
+        PART_ALL = PART_HOT | PART_COLD
+    };
     Sandbox *sandbox;
     bool useDisps;
+    size_t threadCount;
 public:
     Generator(Sandbox *sandbox, bool useDisps = true)
-        : sandbox(sandbox), useDisps(useDisps) {}
+        : sandbox(sandbox), useDisps(useDisps), threadCount(1) {}
 
+    /** Emit functions on this many threads (requires assigned addresses).
+        A count of 0 means one thread per hardware thread.
+    */
+    void setThreadCount(size_t count);
+
+    /** Cold functions (see Function::isCold()) are placed after all other
+        code, including PLT entries.
+    */
     void assignAddresses(Program *program);
     void generateCode(Program *program);
 
+    /** The order may contain functions of several modules; functions it
+        omits follow in their default order. PLT entries of all modules
+        come after the functions that are not cold.
+    */
     void assignAddresses(Program *program, const std::vector<Function *> &order);
     void generateCode(Program *program, const std::vector<Function *> &order);
 
@@ -26,6 +47,20 @@ public:
     void assignAddresses(Module *module, const std::vector<Function *> &order);
     void generateCode(Module *module, const std::vector<Function *> &order);
 
+    /** Incremental re-generation, after a full assignAddresses() and
+        generateCode() into the same sandbox. Functions keep their slot if
+        they still fit; the ones given a new slot are returned.
+    */
+    std::vector<Function *> reassignAddresses(Program *program);
+    std::vector<Function *> reassignAddresses(Module *module);
+
+    /** Re-emits dirty and moved functions. In all other functions, only
+        instructions referring into those functions are re-encoded. Data
+        (e.g. function pointers) must be fixed separately.
+    */
+    void regenerateCode(Program *program, const std::vector<Function *> &moved);
+    void regenerateCode(Module *module, const std::set<Function *> &changed);
+
     // For function generation
     void assignAddressForFunction(Function *function);
     void generateCodeForFunction(Function *function);
@@ -38,6 +73,22 @@ public:
     void jumpToSandbox(Module *module, const char *function = "main");
 private:
     std::vector<Function *> pickFunctionOrder(Module *module);
+    std::vector<Function *> completeOrder(Program *program,
+        const std::vector<Function *> &order);
+    static std::vector<Function *> selectPart(
+        const std::vector<Function *> &order, bool cold);
+    void assignAddresses(Module *module, const std::vector<Function *> &order,
+        int part);
+    void generateCode(Module *module, const std::vector<Function *> &order,
+        int part);
+    void assignFunctionAddresses(const std::vector<Function *> &order);
+    void assignPLTAddresses(Module *module);
+    void copyPLTsToSandbox(Module *module);
+    void copyFunctionsToSandbox(const std::vector<Function *> &order);
+    void copyFunctionsInParallel(const std::vector<Function *> &order);
+    char *getOutputFor(address_t address, size_t size);
+    size_t patchReferences(Chunk *chunk, const std::set<Function *> &changed);
+    bool refersToChanged(Link *link, const std::set<Function *> &changed);
     void pickFunctionAddressInSandbox(Function *function);
     void pickPLTAddressInSandbox(PLTTrampoline *trampoline);
 };
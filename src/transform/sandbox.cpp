@@ -1,26 +1,99 @@
 #include <iostream>
 #include <cstring>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
 #include "sandbox.h"
 #include "chunk/module.h"
 #include "config.h"
+#include "log/log.h"
 
 MemoryBacking::MemoryBacking(address_t address, size_t size)
     : SandboxBackingImpl(address, size) {
 
-    address_t base = (address_t) mmap((void *)address, size,
+    address_t base = map(address, size, 0);
+    if(base == (address_t)-1) {
+        throw std::bad_alloc();
+    }
+    if(base != address) throw "Sandbox: Overlapping with other regions?";
+    setBase(base);
+}
+
+address_t MemoryBacking::map(address_t address, size_t size, int extraFlags) {
+    return (address_t) mmap((void *)address, size,
         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS
 #ifdef ARCH_X86_64
         | MAP_32BIT
 #endif
-        , -1, 0);
+        | extraFlags, -1, 0);
+}
+
+HugePageMemoryBacking::HugePageMemoryBacking(address_t address, size_t size,
+    int numaNode) : MemoryBacking(address,
+        (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1), true) {
+
+    address_t base = map(address, getSize(), MAP_HUGETLB);
+    if(base != (address_t)-1 && base != address) {
+        munmap((void *)base, getSize());
+        base = (address_t)-1;
+    }
     if(base == (address_t)-1) {
+        // not enough reserved hugetlbfs pages: use normal pages, which the
+        // kernel may still back with transparent huge pages
+        LOG(1, "hugetlb mapping failed, falling back to normal pages");
+        base = map(address, getSize(), 0);
+        if(base == (address_t)-1) {
+            throw std::bad_alloc();
+        }
+        madvise((void *)base, getSize(), MADV_HUGEPAGE);
+    }
+    if(base != address) throw "Sandbox: Overlapping with other regions?";
+    setBase(base);
+
+    if(numaNode >= 0) bindToNode(numaNode);
+}
+
+void HugePageMemoryBacking::bindToNode(int numaNode) {
+    // must happen before the pages are first touched
+    unsigned long nodeMask = 1ul << numaNode;
+    if(syscall(SYS_mbind, getBase(), getSize(), MPOL_BIND, &nodeMask,
+        sizeof(nodeMask) * 8, 0) != 0) {
+
+        LOG(0, "WARNING: unable to bind sandbox to NUMA node " << numaNode);
+    }
+}
+
+DualMappedMemoryBacking::DualMappedMemoryBacking(address_t address,
+    size_t size) : MemoryBacking(address, size, true), alias(0) {
+
+    int fd = syscall(SYS_memfd_create, "egalito-sandbox", 0);
+    if(fd < 0) throw std::bad_alloc();
+    if(ftruncate(fd, size) != 0) {
+        close(fd);
+        throw std::bad_alloc();
+    }
+
+    int flags = MAP_SHARED;
+#ifdef ARCH_X86_64
+    flags |= MAP_32BIT;
+#endif
+    address_t base = (address_t) mmap((void *)address, size,
+        PROT_READ | PROT_EXEC, flags, fd, 0);
+    this->alias = (address_t) mmap(NULL, size, PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == (address_t)-1 || alias == (address_t)-1) {
         throw std::bad_alloc();
     }
     if(base != address) throw "Sandbox: Overlapping with other regions?";
     setBase(base);
 }
 
+void DualMappedMemoryBacking::recreate() {
+    std::memset((void *)alias, 0, getSize());
+}
+
 void MemoryBacking::finalize() {
     mprotect((void *)getBase(), getSize(), PROT_READ | PROT_EXEC);
 }
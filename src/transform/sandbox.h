@@ -2,6 +2,7 @@
 #define EGALITO_TRANSFORM_SANDBOX_H
 
 #include <vector>
+#include <map>
 #include <new>
 #include <string>
 #include "slot.h"
@@ -9,6 +10,7 @@
 #include "elf/elfspace.h"
 
 #define MAX_SANDBOX_SIZE (16 * 0x1000 * 0x1000)
+#define HUGE_PAGE_SIZE (2 * 0x400 * 0x400)
 
 class SandboxBacking {
 public:
@@ -19,6 +21,10 @@ public:
     virtual size_t getSize() const = 0;
     virtual bool supportsDirectWrites() const = 0;
 
+    /** With direct writes, where to write code that will run at address. */
+    virtual char *getWritableAddress(address_t address) const
+        { return reinterpret_cast<char *>(address); }
+
     virtual void finalize() = 0;
     virtual bool reopen() = 0;
     virtual void recreate() = 0;
@@ -51,6 +57,49 @@ public:
     virtual void finalize();
     virtual bool reopen();
     virtual void recreate();
+protected:
+    // for subclasses which map the region themselves
+    MemoryBacking(address_t address, size_t size, bool)
+        : SandboxBackingImpl(address, size) {}
+    static address_t map(address_t address, size_t size, int extraFlags);
+};
+
+/** Like MemoryBacking, but backed by 2MB pages to reduce iTLB misses.
+
+    Uses MAP_HUGETLB if huge pages are reserved, otherwise asks for
+    transparent huge pages. The region can optionally be bound to a NUMA
+    node. Can be copied into a SandboxImpl<MemoryBacking, ...>, since only
+    the mapping differs.
+*/
+class HugePageMemoryBacking : public MemoryBacking {
+public:
+    /** May throw std::bad_alloc. address must be 2MB-aligned. */
+    HugePageMemoryBacking(address_t address, size_t size, int numaNode = -1);
+private:
+    void bindToNode(int numaNode);
+};
+
+/** Maps the same memory twice: read/execute at the sandbox address, and
+    read/write at a separate alias, through which all code is written. So
+    several threads can generate code while others execute it, without
+    mprotect()ing each other's pages and without any page being writable
+    and executable at once. finalize() and reopen() do nothing. Only used
+    for the shared-code JIT mode, where there is no single point at which
+    to flip protections.
+*/
+class DualMappedMemoryBacking : public MemoryBacking {
+private:
+    address_t alias;
+public:
+    /** May throw std::bad_alloc. */
+    DualMappedMemoryBacking(address_t address, size_t size);
+
+    virtual char *getWritableAddress(address_t address) const
+        { return reinterpret_cast<char *>(alias + (address - getBase())); }
+
+    virtual void finalize() {}
+    virtual bool reopen() { return true; }
+    virtual void recreate();
 };
 
 // Not mapped at final address, please write into the buffer instead.
@@ -107,6 +156,34 @@ Slot WatermarkAllocator<Backing>::allocate(size_t request) {
     return Slot(region, request);
 }
 
+/** Like WatermarkAllocator, but may be called from several threads. */
+template <typename Backing>
+class AtomicWatermarkAllocator : public SandboxAllocator<Backing> {
+private:
+    address_t base;
+    address_t watermark;
+public:
+    AtomicWatermarkAllocator(Backing *backing)
+        : SandboxAllocator<Backing>(backing),
+        base(backing->getBase()), watermark(backing->getBase()) {}
+
+    Slot allocate(size_t request);
+    address_t getCurrent() const
+        { return __atomic_load_n(&watermark, __ATOMIC_RELAXED); }
+};
+
+template <typename Backing>
+Slot AtomicWatermarkAllocator<Backing>::allocate(size_t request) {
+    size_t max = this->backing->getBase() + this->backing->getSize();
+    address_t region = __atomic_fetch_add(&watermark, request,
+        __ATOMIC_RELAXED);
+    if(region + request > max) {
+        throw std::bad_alloc();
+    }
+
+    return Slot(region, request);
+}
+
 template <typename Backing>
 class AlignedWatermarkAllocator : public SandboxAllocator<Backing> {
 private:
@@ -145,6 +222,160 @@ Slot AlignedWatermarkAllocator<Backing>::allocate(size_t request) {
     return Slot(region, request);
 }
 
+/** Like AlignedWatermarkAllocator, but does not let an allocation straddle
+    a huge page boundary if it fits within one huge page. Functions laid out
+    hottest-first then occupy as few iTLB entries as possible.
+*/
+template <typename Backing>
+class HugePageAllocator : public AlignedWatermarkAllocator<Backing> {
+public:
+    using AlignedWatermarkAllocator<Backing>::AlignedWatermarkAllocator;
+
+    Slot allocate(size_t request);
+};
+
+template <typename Backing>
+Slot HugePageAllocator<Backing>::allocate(size_t request) {
+    auto current = this->getCurrent();
+    auto nextPage = (current + HUGE_PAGE_SIZE) & ~(HUGE_PAGE_SIZE - 1);
+    if(current + request > nextPage && request <= HUGE_PAGE_SIZE) {
+        // pad up to the boundary with a slot of its own
+        AlignedWatermarkAllocator<Backing>::allocate(nextPage - current);
+    }
+    return AlignedWatermarkAllocator<Backing>::allocate(request);
+}
+
+/** Allocator which recycles slots instead of only bumping a watermark.
+
+    Requests are rounded up to a size class (four classes per power of two,
+    so at most 25% internal fragmentation), and each class keeps its own
+    free list. A released slot is not reused right away: it is retired into
+    the current epoch, and only becomes free at the second advanceEpoch()
+    after that, so an old copy of a function stays intact for one whole
+    period after it is replaced (as with the two halves of a DualSandbox).
+*/
+template <typename Backing>
+class SizeClassAllocator : public SandboxAllocator<Backing> {
+public:
+    enum {
+        MIN_CLASS_SIZE = 0x10,
+        MAX_CLASS_SIZE = 0x10000,
+        CLASS_COUNT = 1 + 4*12,     // 0x10, then 0x14 ... 0x10000
+        LARGE_ALIGNMENT = 0x1000
+    };
+private:
+    address_t base;
+    address_t watermark;
+    std::vector<address_t> freeList[CLASS_COUNT];
+    std::map<size_t, std::vector<address_t>> largeFreeList;
+    std::vector<Slot> retired[2];   // current epoch, previous epoch
+    size_t epoch;
+    size_t liveBytes;
+    size_t retiredBytes;
+    size_t freeBytes;
+public:
+    SizeClassAllocator(Backing *backing)
+        : SandboxAllocator<Backing>(backing),
+        base(backing->getBase()), watermark(backing->getBase()),
+        epoch(0), liveBytes(0), retiredBytes(0), freeBytes(0) {}
+
+    Slot allocate(size_t request);
+    /** slot may be the one returned by allocate(), or have the size
+        originally requested. */
+    void release(Slot slot);
+    void advanceEpoch();
+    address_t getCurrent() const { return watermark; }
+    void reset();
+
+    size_t getEpoch() const { return epoch; }
+    size_t getFootprint() const { return watermark - base; }
+    size_t getLiveBytes() const { return liveBytes; }
+    size_t getRetiredBytes() const { return retiredBytes; }
+    size_t getFreeBytes() const { return freeBytes; }
+
+    static size_t roundToClass(size_t request);
+private:
+    std::vector<address_t> &getFreeList(size_t size);
+};
+
+template <typename Backing>
+size_t SizeClassAllocator<Backing>::roundToClass(size_t request) {
+    if(request <= MIN_CLASS_SIZE) return MIN_CLASS_SIZE;
+    if(request > MAX_CLASS_SIZE) {
+        return (request + LARGE_ALIGNMENT-1) & ~(LARGE_ALIGNMENT-1);
+    }
+
+    // 2^k < request <= 2^(k+1), in steps of 2^(k-2)
+    size_t k = 8*sizeof(unsigned long) - 1 - __builtin_clzl(request - 1);
+    size_t step = 1ul << (k - 2);
+    return (request + step-1) & ~(step-1);
+}
+
+template <typename Backing>
+std::vector<address_t> &SizeClassAllocator<Backing>::getFreeList(size_t size) {
+    if(size > MAX_CLASS_SIZE) return largeFreeList[size];
+    if(size == MIN_CLASS_SIZE) return freeList[0];
+
+    size_t k = 8*sizeof(unsigned long) - 1 - __builtin_clzl(size - 1);
+    size_t step = 1ul << (k - 2);
+    size_t index = 1 + (k - 4)*4 + ((size - (1ul << k)) / step - 1);
+    return freeList[index];
+}
+
+template <typename Backing>
+Slot SizeClassAllocator<Backing>::allocate(size_t request) {
+    size_t size = roundToClass(request);
+
+    auto &list = getFreeList(size);
+    if(!list.empty()) {
+        address_t region = list.back();
+        list.pop_back();
+        freeBytes -= size;
+        liveBytes += size;
+        return Slot(region, size);
+    }
+
+    size_t max = this->backing->getBase() + this->backing->getSize();
+    if(watermark + size > max) {
+        throw std::bad_alloc();
+    }
+
+    address_t region = watermark;
+    watermark += size;
+    liveBytes += size;
+    return Slot(region, size);
+}
+
+template <typename Backing>
+void SizeClassAllocator<Backing>::release(Slot slot) {
+    size_t size = roundToClass(slot.getSize());
+    retired[0].push_back(Slot(slot.getAddress(), size));
+    liveBytes -= size;
+    retiredBytes += size;
+}
+
+template <typename Backing>
+void SizeClassAllocator<Backing>::advanceEpoch() {
+    for(const auto &slot : retired[1]) {
+        getFreeList(slot.getSize()).push_back(slot.getAddress());
+        retiredBytes -= slot.getSize();
+        freeBytes += slot.getSize();
+    }
+    retired[1].swap(retired[0]);
+    retired[0].clear();
+    epoch ++;
+}
+
+template <typename Backing>
+void SizeClassAllocator<Backing>::reset() {
+    watermark = base;
+    for(auto &list : freeList) list.clear();
+    largeFreeList.clear();
+    retired[0].clear();
+    retired[1].clear();
+    liveBytes = retiredBytes = freeBytes = 0;
+}
+
 class Sandbox {
 public:
     virtual ~Sandbox() {}
@@ -176,6 +407,7 @@ public:
 
     void recreate() { recreate(id<Backing>()); }
     virtual SandboxBacking *getBacking() { return &backing; }
+    Allocator *getAllocator() { return &alloc; }
     virtual bool supportsDirectWrites() const
         { return backing.supportsDirectWrites(); }
 
@@ -200,6 +432,7 @@ public:
         : sandbox{one, other}, i(0) {}
     void flip() { i^= 1; }
     //Sandbox *get() const { return sandbox[i]; }
+    SandboxImplType *getOther() const { return sandbox[i ^ 1]; }
 
     virtual Slot allocate(size_t request)
         { return sandbox[i]->allocate(request); }
@@ -211,9 +444,22 @@ public:
         { return sandbox[i]->supportsDirectWrites(); }
 };
 
+using LoaderSandbox = SandboxImpl<MemoryBacking,
+    AlignedWatermarkAllocator<MemoryBacking>>;
+
 using ShufflingSandbox = DualSandbox<
     SandboxImpl<MemoryBacking, WatermarkAllocator<MemoryBacking>>>;
 
+/** Single-region alternative to ShufflingSandbox: old function copies are
+    released into the allocator and their slots recycled, instead of
+    flipping between two buffers. */
+using RecyclingSandbox
+    = SandboxImpl<MemoryBacking, SizeClassAllocator<MemoryBacking>>;
+
+/** One sandbox shared by all threads in the shared-code JIT mode. */
+using SharedSandbox = SandboxImpl<DualMappedMemoryBacking,
+    AtomicWatermarkAllocator<DualMappedMemoryBacking>>;
+
 /*class SandboxBuilder {
 public:
     Sandbox *makeLoaderSandbox();
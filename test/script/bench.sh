@@ -0,0 +1,36 @@
+# Shared setup for the benchmark scripts; source it from test/script.
+# Sets up tmp/ and libegalito.so for the loader, and provides:
+#   fail reason          clean up, report failure and exit
+#   finish               clean up and report success
+#   mean_us label cmd..  run cmd N times (output to $out, default
+#                        /dev/null), set time_us to the mean wall time in
+#                        microseconds; fails with label if cmd fails
+
+mkdir -p tmp
+ln -sf ../../src/libegalito.so
+
+N=${N:-5}
+
+fail() {
+    rm -f libegalito.so
+    echo "test failed! ($1)"
+    exit 1
+}
+
+finish() {
+    rm -f libegalito.so
+    echo "test passed"
+}
+
+mean_us() {
+    local label=$1
+    shift
+    local total=0 start end i
+    for i in $(seq $N); do
+        start=$(date +%s%N)
+        "$@" > ${out:-/dev/null} 2>&1 || fail "$label"
+        end=$(date +%s%N)
+        total=$((total + (end - start) / 1000))
+    done
+    time_us=$((total / N))
+}
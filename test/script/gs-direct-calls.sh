@@ -0,0 +1,21 @@
+#!/bin/bash
+# Compare run time without GS, with GS, and with GS plus direct-call
+# patching of hot call sites (EGALITO_JIT_DIRECT_CALLS=threshold).
+# usage: ./gs-direct-calls.sh [program [args...]]
+
+if [ $# -eq 0 ]; then
+    set -- ../binary/build/hello
+fi
+
+. ./bench.sh
+
+mean_us none env EGALITO_DEBUG=/dev/null ../../src/loader "$@"
+echo "none: $time_us us (mean of $N)"
+mean_us gs env EGALITO_DEBUG=/dev/null EGALITO_USE_GS=1 \
+    ../../src/loader "$@"
+echo "gs: $time_us us (mean of $N)"
+mean_us direct env EGALITO_DEBUG=/dev/null EGALITO_USE_GS=1 \
+    EGALITO_JIT_DIRECT_CALLS=2 ../../src/loader "$@"
+echo "direct: $time_us us (mean of $N)"
+
+finish
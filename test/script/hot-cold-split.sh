@@ -0,0 +1,43 @@
+#!/bin/bash
+# Build a program with edge counters (etharden --edge-profile), run it once
+# to collect edges.data, then regenerate it with etorder -b, with and
+# without hot/cold splitting (-c). Compares i-cache and iTLB misses of the
+# two outputs with perf.
+# usage: ./hot-cold-split.sh [program [args...]]
+
+command -v perf > /dev/null 2>&1 || { echo >&2 "needs perf -- skipping"; exit 0; }
+
+if [ $# -eq 0 ]; then
+    set -- ../binary/build/hello
+fi
+program=$1
+shift
+
+. ./bench.sh
+
+../../app/etharden -m --edge-profile $program tmp/hcs-profiled \
+    > /dev/null || fail etharden
+rm -f edges.data
+./tmp/hcs-profiled "$@" > /dev/null || fail "profiling run"
+../../app/etprofile -e tmp/hcs-profiled > tmp/hcs-edges.txt \
+    || fail etprofile
+mv edges.data tmp/hcs-edges.data
+
+events=L1-icache-load-misses,iTLB-load-misses
+
+for split in 0 1; do
+    opt=
+    [ $split -eq 1 ] && opt=-c
+    ../../app/etorder -m -b tmp/hcs-edges.txt $opt $program /dev/null \
+        tmp/hcs-$split > /dev/null || fail "etorder $opt"
+
+    out=tmp/hcs-$split.out
+    perf stat -r $N -x, -e $events -o $out \
+        ./tmp/hcs-$split "$@" > /dev/null 2>&1 || fail "run $opt"
+    icache=$(grep L1-icache-load-misses $out | cut -d, -f1)
+    itlb=$(grep iTLB-load-misses $out | cut -d, -f1)
+    echo "split=$split: $icache i-cache misses, $itlb iTLB misses (mean of $N)"
+done
+readelf -S tmp/hcs-1 | grep -A1 '\.text\.cold'
+
+finish
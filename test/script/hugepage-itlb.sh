@@ -0,0 +1,26 @@
+#!/bin/bash
+# Compare iTLB misses of a program run through the loader with the regular
+# sandbox and with a huge-page sandbox (EGALITO_USE_HUGEPAGES=1).
+# usage: ./hugepage-itlb.sh [program [args...]]
+
+command -v perf > /dev/null 2>&1 || { echo >&2 "needs perf -- skipping"; exit 0; }
+
+if [ $# -eq 0 ]; then
+    set -- ../binary/build/hello
+fi
+
+. ./bench.sh
+
+events=iTLB-loads,iTLB-load-misses
+
+for hugepages in 0 1; do
+    out=tmp/hugepage-itlb-$hugepages.out
+    EGALITO_DEBUG=/dev/null EGALITO_USE_HUGEPAGES=$hugepages \
+        perf stat -r $N -x, -e $events -o $out \
+        ../../src/loader "$@" > /dev/null 2>&1 \
+        || fail "EGALITO_USE_HUGEPAGES=$hugepages"
+    misses=$(grep iTLB-load-misses $out | cut -d, -f1)
+    echo "EGALITO_USE_HUGEPAGES=$hugepages: $misses iTLB misses (mean of $N)"
+done
+
+finish
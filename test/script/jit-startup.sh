@@ -0,0 +1,25 @@
+#!/bin/bash
+# Record which functions a program JITs during startup, then compare the
+# run time in JIT mode with and without that profile (EGALITO_JIT_PROFILE).
+# usage: ./jit-startup.sh [program [args...]]
+
+if [ $# -eq 0 ]; then
+    set -- ../binary/build/hello
+fi
+
+. ./bench.sh
+
+profile=tmp/jit-startup.profile
+rm -f $profile
+
+env EGALITO_DEBUG=/dev/null EGALITO_USE_GS=1 EGALITO_JIT_RECORD=$profile \
+    ../../src/loader "$@" > /dev/null 2>&1 || fail record
+echo "recorded $(sort -u $profile | wc -l) functions in $profile"
+
+for use in "" $profile; do
+    mean_us "${use:-no profile}" env EGALITO_DEBUG=/dev/null EGALITO_USE_GS=1 \
+        ${use:+EGALITO_JIT_PROFILE=$use} ../../src/loader "$@"
+    echo "EGALITO_JIT_PROFILE=${use:-(none)}: $time_us us (mean of $N)"
+done
+
+finish
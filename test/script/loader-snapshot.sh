@@ -0,0 +1,35 @@
+#!/bin/bash
+# Run a program through the loader twice with EGALITO_SNAPSHOT: the first
+# run saves the snapshot, the second launches from it. Both must produce
+# the same output as a normal run.
+# usage: ./loader-snapshot.sh [program [args...]]
+
+if [ $# -eq 0 ]; then
+    set -- ../binary/build/hello
+fi
+
+. ./bench.sh
+
+snapshot=tmp/loader.snapshot
+rm -f $snapshot
+
+# each step depends on the previous one, so run each once
+N=1
+
+out=tmp/snapshot-none.out
+mean_us normal env EGALITO_DEBUG=/dev/null ../../src/loader "$@"
+echo "normal:   $time_us us"
+out=tmp/snapshot-save.out
+mean_us save env EGALITO_DEBUG=/dev/null EGALITO_SNAPSHOT=$snapshot \
+    ../../src/loader "$@"
+echo "save:     $time_us us"
+[ -f $snapshot ] || fail "no snapshot written"
+out=tmp/snapshot-launch.out
+mean_us launch env EGALITO_DEBUG=/dev/null EGALITO_SNAPSHOT=$snapshot \
+    ../../src/loader "$@"
+echo "launch:   $time_us us"
+
+cmp -s tmp/snapshot-none.out tmp/snapshot-save.out || fail "save output"
+cmp -s tmp/snapshot-none.out tmp/snapshot-launch.out || fail "launch output"
+
+finish
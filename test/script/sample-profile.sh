@@ -0,0 +1,27 @@
+#!/bin/bash
+# Run a program under the loader with and without the sampling profiler
+# (EGALITO_SAMPLE=file), report the overhead, and map the samples back to
+# functions with etprofile -s. The result is usable as an etorder profile.
+# usage: ./sample-profile.sh [program [args...]]
+
+if [ $# -eq 0 ]; then
+    set -- ../binary/build/hello
+fi
+
+. ./bench.sh
+
+mean_us none env EGALITO_DEBUG=/dev/null ../../src/loader "$@"
+time_none=$time_us
+echo "none: $time_none us (mean of $N)"
+mean_us sample env EGALITO_DEBUG=/dev/null EGALITO_SAMPLE=tmp/samples \
+    EGALITO_SAMPLE_HZ=997 ../../src/loader "$@"
+time_sample=$time_us
+echo "sample: $time_sample us (mean of $N)"
+echo "overhead: $(( (time_sample - time_none) * 100 / time_none ))%"
+
+# symbols.elf is written by the loader in non-release builds
+../../app/etprofile -s tmp/samples symbols.elf > tmp/samples.order \
+    || fail etprofile
+head -n 10 tmp/samples.order
+
+finish
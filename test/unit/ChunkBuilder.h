@@ -0,0 +1,46 @@
+#ifndef EGALITO_TEST_FRAMEWORK_CHUNK_BUILDER_H
+#define EGALITO_TEST_FRAMEWORK_CHUNK_BUILDER_H
+
+#include <vector>
+#include "chunk/concrete.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "disasm/disassemble.h"
+
+/** Appends a block to function, with one instruction per entry of code,
+    each disassembled at address 0.
+*/
+inline Block *makeBlock(Function *function,
+    const std::vector<std::vector<unsigned char>> &code) {
+
+    auto block = new Block();
+    for(auto &bytes : code) {
+        ChunkMutator(block).append(Disassemble::instruction(bytes, true, 0));
+    }
+    ChunkMutator(function).append(block);
+    return block;
+}
+
+#ifdef ARCH_X86_64
+/** Appends an instruction to block whose first operand is a rip-relative
+    reference to offset in section, with a DataOffsetLink to it.
+*/
+inline Instruction *makeDataAccess(Block *block,
+    const std::vector<unsigned char> &bytes, DataSection *section,
+    address_t offset) {
+
+    DisasmHandle handle(true);
+    auto instr = new Instruction();
+    auto semantic = new LinkedInstruction(instr);
+    semantic->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
+        bytes));
+    semantic->setLink(new DataOffsetLink(section, offset,
+        Link::SCOPE_INTERNAL_DATA));
+    semantic->setIndex(0);
+    instr->setSemantic(semantic);
+    ChunkMutator(block).append(instr);
+    return instr;
+}
+#endif
+
+#endif
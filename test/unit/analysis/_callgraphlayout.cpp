@@ -0,0 +1,37 @@
+#include "framework/include.h"
+#include "analysis/callgraphlayout.h"
+
+TEST_CASE("Call graph layout places callees after their callers",
+    "[analysis][fast]") {
+
+    CallGraphLayout graph;
+    auto cold = graph.addNode(100, 0);
+    auto callee = graph.addNode(100, 50);
+    auto other = graph.addNode(100, 10);
+    auto caller = graph.addNode(100, 100);
+
+    graph.addArc(caller, callee, 50);
+    graph.addArc(other, callee, 5);
+
+    auto order = graph.computeOrder();
+    REQUIRE(order.size() == 4);
+    CHECK(order[0] == caller);
+    CHECK(order[1] == callee);
+    CHECK(order[2] == other);
+    CHECK(order[3] == cold);
+}
+
+TEST_CASE("Call graph layout respects the cluster size limit",
+    "[analysis][fast]") {
+
+    CallGraphLayout graph(150);
+    auto a = graph.addNode(100, 10);
+    auto b = graph.addNode(100, 20);
+    graph.addArc(a, b, 10);
+
+    // too big to merge, so ordered by density alone
+    auto order = graph.computeOrder();
+    REQUIRE(order.size() == 2);
+    CHECK(order[0] == b);
+    CHECK(order[1] == a);
+}
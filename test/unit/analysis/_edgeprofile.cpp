@@ -0,0 +1,80 @@
+#include <fstream>
+#include <cstdio>  // for std::remove
+#include "framework/include.h"
+#include "analysis/edgeprofile.h"
+#include "chunk/function.h"
+#include "chunk/module.h"
+
+TEST_CASE("Edge profile parses and sums counts", "[analysis][fast]") {
+    const char *filename = "/tmp/egalito-edgeprofile-test";
+    {
+        std::ofstream file(filename);
+        file << "   10 [main] 0 block\n"
+            << "    7 [main] 0 taken\n"
+            << "    3 [main] 2 block\n"
+            << "    5 [main] 2 block\n"
+            << "garbage line\n"
+            << "    1 [helper] 1 block\n";
+    }
+
+    EdgeProfile profile;
+    REQUIRE(profile.parse(filename));
+    std::remove(filename);
+
+    Function main;
+    main.setName("main");
+    Function helper;
+    helper.setName("helper");
+    Function other;
+    other.setName("other");
+
+    CHECK(profile.getBlockCount(&main, 0) == 10);
+    CHECK(profile.getTakenCount(&main, 0) == 7);
+    CHECK(profile.getBlockCount(&main, 1) == 0);
+    CHECK(profile.getBlockCount(&main, 2) == 8);
+    CHECK(profile.getTakenCount(&main, 2) == 0);
+    CHECK(profile.getBlockCount(&helper, 1) == 1);
+    CHECK(profile.getCounts(&other) == nullptr);
+}
+
+TEST_CASE("Edge profile rejects a missing file", "[analysis][fast]") {
+    EdgeProfile profile;
+    CHECK(!profile.parse("/nonexistent/edge/profile"));
+}
+
+TEST_CASE("Edge profile keeps same-named functions of modules apart",
+    "[analysis][fast]") {
+
+    const char *filename = "/tmp/egalito-edgeprofile-module-test";
+    {
+        std::ofstream file(filename);
+        file << "    4 [init] 0 block module-a\n"
+            << "    9 [init] 0 block module-b\n"
+            << "    2 [main] 0 block\n";
+    }
+
+    EdgeProfile profile;
+    REQUIRE(profile.parse(filename));
+    std::remove(filename);
+
+    Module moduleA, moduleB;
+    moduleA.setName("module-a");
+    moduleB.setName("module-b");
+    FunctionList listA, listB;
+    listA.setParent(&moduleA);
+    listB.setParent(&moduleB);
+
+    Function initA, initB, mainB;
+    initA.setName("init");
+    initA.setParent(&listA);
+    initB.setName("init");
+    initB.setParent(&listB);
+    mainB.setName("main");
+    mainB.setParent(&listB);
+
+    CHECK(profile.getBlockCount(&initA, 0) == 4);
+    CHECK(profile.getBlockCount(&initB, 0) == 9);
+
+    // a line without a module matches the name in any module
+    CHECK(profile.getBlockCount(&mainB, 0) == 2);
+}
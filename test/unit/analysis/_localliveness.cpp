@@ -0,0 +1,77 @@
+#include "framework/include.h"
+#include "analysis/localliveness.h"
+#include "chunk/concrete.h"
+#include "instr/register.h"
+#include "operation/mutator.h"
+#include "disasm/disassemble.h"
+
+#ifdef ARCH_X86_64
+static std::vector<Instruction *> makeList(
+    const std::vector<std::vector<unsigned char>> &code) {
+
+    std::vector<Instruction *> list;
+    for(auto &bytes : code) {
+        list.push_back(Disassemble::instruction(bytes, true, 0));
+    }
+    return list;
+}
+#endif
+
+TEST_CASE("local liveness of registers", "[analysis][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto list = makeList({
+        {0x4c, 0x89, 0xd0},                     // mov %r10,%rax
+        {0x41, 0xbb, 0x01, 0x00, 0x00, 0x00},   // mov $1,%r11d
+        {0x41, 0xb2, 0x01},                     // mov $1,%r10b
+        {0x48, 0x8b, 0x40, 0x08},               // mov 0x8(%rax),%rax
+        {0xc3},                                 // ret
+    });
+
+    CHECK(!LocalLiveness::isDead(list, 0, X86Register::R10));
+    CHECK(LocalLiveness::isDead(list, 0, X86Register::R11));
+    CHECK(LocalLiveness::isDead(list, 0, X86Register::R0));
+
+    // a byte write keeps the rest of the register
+    CHECK(!LocalLiveness::isDead(list, 2, X86Register::R10));
+
+    // the address uses %rax before it is overwritten
+    CHECK(!LocalLiveness::isDead(list, 3, X86Register::R0));
+
+    // nothing is known past the end of the block
+    CHECK(!LocalLiveness::isDead(list, 4, X86Register::R9));
+#endif
+}
+
+TEST_CASE("local liveness of flags", "[analysis][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto list = makeList({
+        {0x48, 0x89, 0xc1},                     // mov %rax,%rcx
+        {0x48, 0x31, 0xc0},                     // xor %rax,%rax
+        {0x0f, 0x94, 0xc0},                     // sete %al
+        {0x48, 0x83, 0xc1, 0x01},               // add $1,%rcx
+        {0xc3},                                 // ret
+    });
+
+    CHECK(LocalLiveness::flagsDead(list, 0));
+    CHECK(!LocalLiveness::flagsDead(list, 2));
+    CHECK(!LocalLiveness::flagsDead(list, 4));
+#endif
+}
+
+TEST_CASE("local liveness across system calls", "[analysis][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto list = makeList({
+        {0xb8, 0x3c, 0x00, 0x00, 0x00},         // mov $60,%eax
+        {0x0f, 0x05},                           // syscall
+        {0x31, 0xff},                           // xor %edi,%edi
+        {0xcd, 0x80},                           // int $0x80
+        {0x41, 0xba, 0x00, 0x00, 0x00, 0x00},   // mov $0,%r10d
+        {0xc3},                                 // ret
+    });
+
+    // the arguments in %rdi and %r10 are read by the kernel
+    CHECK(!LocalLiveness::isDead(list, 0, X86Register::R7));
+    CHECK(!LocalLiveness::isDead(list, 0, X86Register::R10));
+    CHECK(!LocalLiveness::isDead(list, 2, X86Register::R3));
+#endif
+}
@@ -146,6 +146,58 @@ TEST_CASE("calling insert functions with ChunkMutator", "[chunk][normal]") {
     delete block;
 }
 
+TEST_CASE("ChunkMutator marks the enclosing function dirty", "[chunk][fast]") {
+    PositionFactory *positionFactory = PositionFactory::getInstance();
+    Function *function = new Function(0x1000);
+    function->setPosition(
+        positionFactory->makePosition(nullptr, function, 0x1000));
+    auto block = makeBlock();
+    ChunkMutator(function).append(block);
+    CHECK(function->isDirty());
+
+    function->setDirty(false);
+    auto instr = makeWithImmediate(1);
+    instr->setPosition(positionFactory->makePosition(nullptr, instr, 0));
+    ChunkMutator(block).append(instr);
+    CHECK(function->isDirty());
+
+    function->setDirty(false);
+    ChunkMutator(block).removeLast();
+    CHECK(function->isDirty());
+
+    delete function;
+}
+
+TEST_CASE("replacing a semantic marks the enclosing function dirty",
+    "[chunk][fast]") {
+
+    PositionFactory *positionFactory = PositionFactory::getInstance();
+    Function *function = new Function(0x1000);
+    function->setPosition(
+        positionFactory->makePosition(nullptr, function, 0x1000));
+    auto block = makeBlock();
+    ChunkMutator(function).append(block);
+    auto instr = makeWithImmediate(1);
+    instr->setPosition(positionFactory->makePosition(nullptr, instr, 0));
+    ChunkMutator(block).append(instr);
+
+    // same-size replacement, so no sizes change
+    function->setDirty(false);
+    auto other = makeWithImmediate(2);
+    auto old = instr->getSemantic();
+    instr->setSemantic(other->getSemantic());
+    other->setSemantic(old);
+    CHECK(function->isDirty());
+    CHECK(function->getSize() == old->getSize());
+    delete other;
+
+    function->setDirty(false);
+    ChunkMutator(instr, false).markFunctionDirty();
+    CHECK(function->isDirty());
+
+    delete function;
+}
+
 #if 0
 TEST_CASE("calling splitBlockBefore() in ChunkMutator", "[chunk][fast]") {
     TemporaryLogLevel tll("pass", 20);
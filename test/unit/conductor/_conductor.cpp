@@ -0,0 +1,80 @@
+#include <vector>
+#include <string>
+#include "framework/include.h"
+#include "conductor/conductor.h"
+#include "chunk/concrete.h"
+#include "chunk/library.h"
+#include "log/registry.h"
+
+static std::vector<std::string> parseLazily(const char *executable,
+    std::vector<std::string> &unparsed) {
+
+    Conductor conductor;
+    conductor.parseAnything(executable, Library::ROLE_MAIN);
+    conductor.parseLibrariesLazily();
+
+    std::vector<std::string> modules;
+    for(auto module : CIter::modules(conductor.getProgram())) {
+        modules.push_back(module->getName());
+    }
+    for(auto library : CIter::children(conductor.getLibraryList())) {
+        if(!library->getModule()) unparsed.push_back(library->getName());
+    }
+    REQUIRE(conductor.getProgram()->getLibc() != nullptr);
+    return modules;
+}
+
+TEST_CASE("lazy library parsing does not depend on allocation order",
+    "[conductor][full]") {
+
+    GroupRegistry::getInstance()->muteAllSettings();
+
+    // a C++ program, so that several libraries are candidates
+    std::vector<std::string> unparsed1, unparsed2;
+    auto first = parseLazily(TESTDIR "cout", unparsed1);
+    auto second = parseLazily(TESTDIR "cout", unparsed2);
+    CHECK(first == second);
+    CHECK(unparsed1 == unparsed2);
+}
+
+TEST_CASE("lazy library parsing skips unreferenced libraries",
+    "[conductor][full]") {
+
+    GroupRegistry::getInstance()->muteAllSettings();
+
+    Conductor conductor;
+    conductor.parseAnything(TESTDIR "hello", Library::ROLE_MAIN);
+    auto libraryList = conductor.getLibraryList();
+
+    // hello only imports from libc, and libc imports nothing from libm
+    auto libc = libraryList->getLibc();
+    REQUIRE(libc != nullptr);
+    auto path = libc->getResolvedPath();
+    auto libm = new Library("libm.so.6", Library::ROLE_NORMAL);
+    libm->setResolvedPath(path.substr(0, path.rfind('/') + 1) + "libm.so.6");
+    REQUIRE(libraryList->add(libm));
+
+    conductor.parseLibrariesLazily();
+
+    REQUIRE(libraryList->getMain() != nullptr);
+    CHECK(libraryList->getMain()->getModule() != nullptr);
+    CHECK(libc->getModule() != nullptr);
+    CHECK(conductor.getProgram()->getLibc() == libc->getModule());
+    CHECK(libm->getModule() == nullptr);
+}
+
+TEST_CASE("lazy library parsing keeps the C++ runtime",
+    "[conductor][full]") {
+
+    GroupRegistry::getInstance()->muteAllSettings();
+
+    Conductor conductor;
+    conductor.parseAnything(TESTDIR "cout", Library::ROLE_MAIN);
+    conductor.parseLibrariesLazily();
+
+    auto libraryList = conductor.getLibraryList();
+    REQUIRE(libraryList->getLibcpp() != nullptr);
+    CHECK(libraryList->getLibcpp()->getModule() != nullptr);
+    REQUIRE(libraryList->getLibc() != nullptr);
+    CHECK(libraryList->getLibc()->getModule() != nullptr);
+}
@@ -0,0 +1,132 @@
+#include <string>
+#include "framework/include.h"
+#include "ChunkBuilder.h"
+#include "pass/aflcoverage.h"
+#include "chunk/concrete.h"
+#include "instr/concrete.h"
+#include "instr/register.h"
+#include "operation/mutator.h"
+#include "disasm/disassemble.h"
+
+#ifdef ARCH_X86_64
+static void checkSnippet(int reg, const std::vector<std::string> &expected,
+    const std::vector<std::string> &registers) {
+
+    auto code = AFLCoveragePass::makeEdgeCoverageCode(reg, 0x1234);
+    REQUIRE(code.size() == expected.size());
+    for(size_t i = 0; i < code.size(); i ++) {
+        auto semantic = code[i]->getSemantic();
+        CAPTURE(i);
+        CHECK(semantic->getData() == expected[i]);
+
+        // each one decodes to a single instruction of that length
+        auto assembly = semantic->getAssembly();
+        REQUIRE(assembly);
+        CHECK(assembly->getSize() == expected[i].size());
+        CAPTURE(assembly->getOpStr());
+        CHECK(assembly->getOpStr().find(registers[i]) != std::string::npos);
+    }
+}
+#endif
+
+TEST_CASE("AFL edge counter encodes its scratch register", "[pass][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    // prev_loc is stored as 0x1234 >> 1 = 0x91a
+    const std::string store("\x65\xc7\x04\x25\x08\x00\x00\x00\x1a\x09\x00\x00",
+        12);
+
+    SECTION("%r10") {
+        checkSnippet(X86Register::R10, {
+            std::string("\x41\xba\x34\x12\x00\x00", 6),
+            std::string("\x65\x44\x33\x14\x25\x08\x00\x00\x00", 9),
+            std::string("\x41\xfe\x82\x00\x00\x00\x50", 7),
+            store,
+        }, {"%r10d", "%r10d", "(%r10)", "%gs:"});
+    }
+
+    SECTION("%rax") {
+        checkSnippet(X86Register::R0, {
+            std::string("\xb8\x34\x12\x00\x00", 5),
+            std::string("\x65\x33\x04\x25\x08\x00\x00\x00", 8),
+            std::string("\xfe\x80\x00\x00\x00\x50", 6),
+            store,
+        }, {"%eax", "%eax", "(%rax)", "%gs:"});
+    }
+#endif
+}
+
+TEST_CASE("AFL edge coverage skips blocks implied by their predecessor", "[pass][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto function = new Function(0x1000);
+    function->setPosition(new AbsolutePosition(0x1000));
+
+    SECTION("fallthrough chain") {
+        auto entry = makeBlock(function, {{0x90}});     // nop
+        auto second = makeBlock(function, {{0x90}});    // nop
+        auto third = makeBlock(function, {{0xc3}});     // ret
+
+        auto implied = AFLCoveragePass::findImpliedBlocks(function);
+        CHECK(implied.size() == 2);
+        CHECK(implied.count(entry) == 0);
+        CHECK(implied.count(second) == 1);
+        CHECK(implied.count(third) == 1);
+    }
+
+    SECTION("conditional jump around a block") {
+        auto entry = makeBlock(function, {{0x90}});     // nop
+        auto middle = makeBlock(function, {{0x90}});    // nop
+        auto last = makeBlock(function, {{0xc3}});      // ret
+
+        // je last, at the end of the entry block
+        auto branch = new Instruction();
+        auto semantic = new ControlFlowInstruction(
+            X86_INS_JE, branch, "\x0f\x84", "je", 4);
+        semantic->setLink(new NormalLink(
+            last->getChildren()->getIterable()->get(0),
+            Link::SCOPE_INTERNAL_JUMP));
+        branch->setSemantic(semantic);
+        ChunkMutator(entry).append(branch);
+
+        // middle may be skipped, and last has two predecessors
+        auto implied = AFLCoveragePass::findImpliedBlocks(function);
+        CHECK(implied.count(middle) == 0);
+        CHECK(implied.count(last) == 0);
+        CHECK(implied.empty());
+    }
+
+    SECTION("jump table targets") {
+        auto entry = makeBlock(function, {{0xff, 0xe0}});  // jmpq *%rax
+        auto first = makeBlock(function, {{0x90}});         // nop
+        auto second = makeBlock(function, {{0xc3}});        // ret
+
+        // first falls into second, which the table also reaches
+        auto jumpTable = new JumpTable();
+        for(auto target : {first, second}) {
+            auto var = new DataVariable();
+            var->setDest(new NormalLink(
+                target->getChildren()->getIterable()->get(0),
+                Link::SCOPE_INTERNAL_JUMP));
+            jumpTable->getChildren()->add(new JumpTableEntry(var));
+        }
+        auto jump = dynamic_cast<IndirectJumpInstruction *>(
+            entry->getChildren()->getIterable()->get(0)->getSemantic());
+        REQUIRE(jump);
+        jump->addJumpTable(jumpTable);
+
+        auto implied = AFLCoveragePass::findImpliedBlocks(function);
+        CHECK(implied.count(first) == 0);
+        CHECK(implied.count(second) == 0);
+    }
+
+    SECTION("unresolved indirect jump") {
+        makeBlock(function, {{0x90}});                  // nop
+        auto second = makeBlock(function, {{0x90}});    // nop
+        makeBlock(function, {{0xff, 0xe0}});            // jmpq *%rax
+
+        // the jump could go back to second
+        auto implied = AFLCoveragePass::findImpliedBlocks(function);
+        CHECK(implied.count(second) == 0);
+        CHECK(implied.empty());
+    }
+#endif
+}
@@ -0,0 +1,123 @@
+#include "framework/include.h"
+#include "ChunkBuilder.h"
+#include "pass/collapsegot.h"
+#include "chunk/concrete.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "disasm/disassemble.h"
+
+#ifdef ARCH_X86_64
+static DataSection *makeSection(const std::string &name, address_t address,
+    DataRegion *region = nullptr) {
+
+    auto section = new DataSection();
+    section->setName(name);
+    section->setPosition(new AbsolutePosition(address));
+    section->setSize(0x100);
+    if(region) section->setParent(region);
+    return section;
+}
+
+static Function *makeFunction(const std::string &name, address_t address) {
+    auto function = new Function(address);
+    function->setName(name);
+    function->setPosition(new AbsolutePosition(address));
+    ChunkMutator(function).append(new Block());
+    return function;
+}
+
+//  48 8b 05 00 00 00 00    mov    0x0(%rip),%rax
+static Instruction *addLoad(Block *block, DataSection *got, address_t offset) {
+    return makeDataAccess(block, {0x48, 0x8b, 0x05, 0x00, 0x00, 0x00, 0x00},
+        got, offset);
+}
+
+//  ff 15 00 00 00 00       call   *0x0(%rip)
+static Instruction *addCall(Block *block, DataSection *got, address_t offset) {
+    auto instr = Disassemble::instruction(
+        {0xff, 0x15, 0x00, 0x00, 0x00, 0x00}, true, 0);
+    instr->getSemantic()->setLink(new DataOffsetLink(got, offset,
+        Link::SCOPE_INTERNAL_DATA));
+    ChunkMutator(block).append(instr);
+    return instr;
+}
+#endif
+
+TEST_CASE("collapse .got loads and calls", "[pass][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto data = makeSection(".data", 0x10000);
+    auto tls = makeSection(".tdata", 0x18000, new TLSDataRegion());
+    auto got = makeSection(".got", 0x20000);
+    auto gotplt = makeSection(".got.plt", 0x30000);
+
+    auto callee = makeFunction("callee", 0x5000);
+    auto ifunc = makeFunction("ifunc", 0x6000);
+    ifunc->setIsIFunc(true);
+
+    DataVariable::create(got, 0x20000,
+        new NormalLink(callee, Link::SCOPE_EXTERNAL_JUMP), nullptr);
+    DataVariable::create(got, 0x20008,
+        new DataOffsetLink(data, 0x10, Link::SCOPE_INTERNAL_DATA), nullptr);
+    DataVariable::create(got, 0x20010,
+        new NormalLink(ifunc, Link::SCOPE_EXTERNAL_JUMP), nullptr);
+    DataVariable::create(got, 0x20018,
+        new AbsoluteDataLink(tls, 0, Link::SCOPE_INTERNAL_DATA), nullptr);
+    DataVariable::create(got, 0x20020,
+        new InternalAndExternalDataLink(nullptr, data, 0x10), nullptr);
+    DataVariable::create(gotplt, 0x30000,
+        new NormalLink(callee, Link::SCOPE_EXTERNAL_JUMP), nullptr);
+
+    auto caller = makeFunction("caller", 0x1000);
+    auto block = caller->getChildren()->getIterable()->get(0);
+    auto load = addLoad(block, got, 0x08);
+    auto call = addCall(block, got, 0x00);
+
+    // left alone
+    auto gotpltCall = addCall(block, gotplt, 0x00);
+    auto ifuncCall = addCall(block, got, 0x10);
+    auto tlsLoad = addLoad(block, got, 0x18);
+    auto externalLoad = addLoad(block, got, 0x20);
+    std::vector<std::pair<Instruction *, InstructionSemantic *>> unchanged;
+    for(auto instr : {gotpltCall, ifuncCall, tlsLoad, externalLoad}) {
+        unchanged.push_back({instr, instr->getSemantic()});
+    }
+
+    CollapseGOTPass pass;
+    caller->accept(&pass);
+
+    CHECK(pass.getLoadsRemoved() == 1);
+    CHECK(pass.getCallsRemoved() == 1);
+
+    SECTION("mov becomes lea of the variable") {
+        auto lea = dynamic_cast<LinkedInstruction *>(load->getSemantic());
+        REQUIRE(lea);
+        CHECK(lea->getData().size() == 7);
+        CHECK(static_cast<unsigned char>(lea->getData()[1]) == 0x8d);
+        REQUIRE(lea->getAssembly());
+        CHECK(lea->getAssembly()->getId() == X86_INS_LEA);
+
+        auto link = dynamic_cast<DataOffsetLink *>(lea->getLink());
+        REQUIRE(link);
+        CHECK(link->getTarget() == data);
+        CHECK(link->getTargetAddress() == 0x10010);
+    }
+
+    SECTION("indirect call becomes call rel32") {
+        auto cfi = dynamic_cast<ControlFlowInstruction *>(call->getSemantic());
+        REQUIRE(cfi);
+        CHECK(cfi->getId() == X86_INS_CALL);
+        CHECK(cfi->getSize() == 5);
+        CHECK(call->getSize() == 5);
+
+        auto link = dynamic_cast<NormalLink *>(cfi->getLink());
+        REQUIRE(link);
+        CHECK(link->getTarget() == callee);
+    }
+
+    SECTION(".got.plt, IFUNC, TLS and interposable entries are kept") {
+        for(auto &p : unchanged) {
+            CHECK(p.first->getSemantic() == p.second);
+        }
+    }
+#endif
+}
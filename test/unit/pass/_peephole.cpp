@@ -0,0 +1,61 @@
+#include "framework/include.h"
+#include "ChunkBuilder.h"
+#include "pass/peephole.h"
+#include "chunk/concrete.h"
+
+TEST_CASE("peephole between adjacent instrumentation", "[pass][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto function = new Function(0x1000);
+    function->setPosition(new AbsolutePosition(0x1000));
+
+    // two ChunkAddInline snippets, clobbering %r10 and the flags
+    auto block = makeBlock(function, {
+        {0x90},                                     // nop
+        {0x48, 0x8d, 0x64, 0x24, 0x80},             // lea -0x80(%rsp),%rsp
+        {0x9c},                                     // pushfq
+        {0x41, 0x52},                               // push %r10
+        {0x41, 0xba, 0x01, 0x00, 0x00, 0x00},       // mov $1,%r10d
+        {0x41, 0x5a},                               // pop %r10
+        {0x9d},                                     // popfq
+        {0x48, 0x8d, 0xa4, 0x24, 0x80, 0x00, 0x00, 0x00},  // lea 0x80(%rsp),%rsp
+        {0x48, 0x8d, 0x64, 0x24, 0x80},             // lea -0x80(%rsp),%rsp
+        {0x9c},                                     // pushfq
+        {0x41, 0x52},                               // push %r10
+        {0x41, 0xba, 0x02, 0x00, 0x00, 0x00},       // mov $2,%r10d
+        {0x49, 0x81, 0xe2, 0xff, 0xff, 0x00, 0x00}, // and $0xffff,%r10
+        {0x41, 0x5a},                               // pop %r10
+        {0x9d},                                     // popfq
+        {0x48, 0x8d, 0xa4, 0x24, 0x80, 0x00, 0x00, 0x00},  // lea 0x80(%rsp),%rsp
+        {0xc3},                                     // ret
+    });
+
+    PeepholePass peephole;
+    function->accept(&peephole);
+
+    // the second snippet's and overwrites the flags before they are read
+    CHECK(block->getChildren()->getIterable()->getCount() == 17 - 6);
+    CHECK(peephole.getBytesSaved() == 8 + 5 + 1 + 1 + 2 + 2);
+#endif
+}
+
+TEST_CASE("peephole keeps live registers and block starts", "[pass][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto function = new Function(0x1000);
+    function->setPosition(new AbsolutePosition(0x1000));
+
+    makeBlock(function, {
+        {0x41, 0x52},                               // push %r10
+        {0x41, 0x5a},                               // pop %r10
+        {0x41, 0x5a},                               // pop %r10
+        {0x41, 0x52},                               // push %r10
+        {0x4c, 0x89, 0xd0},                         // mov %r10,%rax
+        {0xc3},                                     // ret
+    });
+    auto size = function->getSize();
+
+    PeepholePass peephole;
+    function->accept(&peephole);
+
+    CHECK(function->getSize() == size);
+#endif
+}
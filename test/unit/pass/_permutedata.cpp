@@ -0,0 +1,65 @@
+#include "framework/include.h"
+#include "ChunkBuilder.h"
+#include "pass/permutedata.h"
+#include "chunk/concrete.h"
+#include "operation/mutator.h"
+
+#ifdef ARCH_X86_64
+// a rip-relative access to offset of section
+static void addAccess(Block *block, DataSection *section, address_t offset,
+    bool write) {
+
+    //  48 89 05 00 00 00 00    mov    %rax,0x0(%rip)
+    //  48 8b 05 00 00 00 00    mov    0x0(%rip),%rax
+    makeDataAccess(block, {0x48,
+        static_cast<unsigned char>(write ? 0x89 : 0x8b),
+        0x05, 0x00, 0x00, 0x00, 0x00}, section, offset);
+}
+#endif
+
+TEST_CASE("hot data layout groups and aligns variables", "[pass][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto section = new DataSection();
+    section->setName(".data");
+    section->setAlignment(64);
+    section->setPosition(new AbsolutePosition(0x10000));
+
+    auto module = new Module();
+    auto functionList = new FunctionList();
+    module->setFunctionList(functionList);
+    functionList->setParent(module);
+
+    auto function = new Function(0x1000);
+    function->setPosition(new AbsolutePosition(0x1000));
+    auto block = new Block();
+    ChunkMutator(function).append(block);
+    functionList->getChildren()->add(function);
+    function->setParent(functionList);
+
+    std::vector<Range> ranges = {
+        Range(0x00, 0x08),  // written
+        Range(0x08, 0x38),  // never accessed
+        Range(0x40, 0x08),  // read, 64-byte aligned
+        Range(0x48, 0x08),  // read more often
+    };
+    addAccess(block, section, 0x00, true);
+    addAccess(block, section, 0x40, false);
+    addAccess(block, section, 0x48, false);
+    addAccess(block, section, 0x4c, false);
+
+    PermuteDataPass pass(PermuteDataPass::MODE_HOT);
+    auto size = pass.makeHotLayout(module, section, ranges);
+    auto &layout = pass.getLayout();
+
+    REQUIRE(layout.size() == 4);
+    // written variables first, then read-mostly ones on the next line
+    CHECK(layout.at(0x00).getStart() == 0x00);
+    CHECK(layout.at(0x48).getStart() == 0x40);
+    // 0x48 rounded up to the original alignment, not just to 16
+    CHECK(layout.at(0x40).getStart() == 0x80);
+    // then the cold one on a line of its own
+    CHECK(layout.at(0x08).getStart() == 0xc0);
+    CHECK(layout.at(0x08).getSize() == 0x38);
+    CHECK(size == 0x100);
+#endif
+}
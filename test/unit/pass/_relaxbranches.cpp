@@ -0,0 +1,96 @@
+#include <capstone/capstone.h>
+#include "framework/include.h"
+#include "pass/relaxbranches.h"
+#include "chunk/concrete.h"
+#include "chunk/link.h"
+#include "operation/mutator.h"
+#include "instr/concrete.h"
+#include "disasm/disassemble.h"
+
+#ifdef ARCH_X86_64
+static Block *makeBlock(Function *function,
+    const std::vector<Instruction *> &instructions) {
+
+    auto block = new Block();
+    for(auto instr : instructions) ChunkMutator(block).append(instr);
+    ChunkMutator(function).append(block);
+    return block;
+}
+
+static Instruction *makeAdd() {
+    // add $1, %eax
+    return Disassemble::instruction({0x83, 0xc0, 0x01}, true, 0);
+}
+
+static Instruction *makeRet() {
+    return Disassemble::instruction({0xc3}, true, 0);
+}
+
+static Instruction *makeJump(unsigned int id, const char *opcode,
+    const char *mnemonic) {
+
+    auto jump = new Instruction();
+    jump->setSemantic(new ControlFlowInstruction(
+        id, jump, opcode, mnemonic, 4));
+    return jump;
+}
+
+static void setTarget(Instruction *jump, Block *block) {
+    jump->getSemantic()->setLink(new NormalLink(
+        block->getChildren()->getIterable()->get(0),
+        Link::SCOPE_INTERNAL_JUMP));
+}
+
+static ControlFlowInstruction *getJump(Instruction *instr) {
+    return dynamic_cast<ControlFlowInstruction *>(instr->getSemantic());
+}
+#endif
+
+TEST_CASE("relaxing a jump to the next block", "[pass][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto function = new Function(0x1000);
+    function->setPosition(new AbsolutePosition(0x1000));
+
+    auto jump = makeJump(X86_INS_JMP, "\xe9", "jmp");
+    auto b0 = makeBlock(function, {makeAdd(), jump});
+    auto b1 = makeBlock(function, {makeRet()});
+    setTarget(jump, b1);
+    CHECK(function->getSize() == 3 + 5 + 1);
+
+    RelaxBranchesPass relax;
+    function->accept(&relax);
+
+    CHECK(b0->getChildren()->getIterable()->getCount() == 1);
+    CHECK(function->getSize() == 3 + 1);
+    CHECK(relax.getBytesSaved() == 5);
+#endif
+}
+
+TEST_CASE("threading and shrinking jumps", "[pass][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    auto function = new Function(0x1000);
+    function->setPosition(new AbsolutePosition(0x1000));
+
+    auto je = makeJump(X86_INS_JE, "\x0f\x84", "je");
+    auto jmp = makeJump(X86_INS_JMP, "\xe9", "jmp");
+    makeBlock(function, {makeAdd(), je});
+    makeBlock(function, {makeAdd(), makeRet()});
+    auto b2 = makeBlock(function, {jmp});
+    auto b3 = makeBlock(function, {makeRet()});
+    setTarget(je, b2);
+    setTarget(jmp, b3);
+
+    RelaxBranchesPass relax;
+    function->accept(&relax);
+
+    // je goes straight to the ret; the lone jmp can only shrink
+    CHECK(je->getSemantic()->getLink()->getTarget()
+        == b3->getChildren()->getIterable()->get(0));
+    CHECK(getJump(je)->getDisplacementSize() == 1);
+    CHECK(getJump(je)->getOpcode() == "\x74");
+    CHECK(getJump(jmp)->getDisplacementSize() == 1);
+    CHECK(getJump(jmp)->getOpcode() == "\xeb");
+    CHECK(function->getSize() == (3 + 2) + (3 + 1) + 2 + 1);
+    CHECK(getJump(je)->calculateDisplacement() == 4 + 2);
+#endif
+}
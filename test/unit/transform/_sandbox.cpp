@@ -0,0 +1,50 @@
+#include "framework/include.h"
+#include "transform/sandbox.h"
+
+typedef SizeClassAllocator<MemoryBufferBacking> TestAllocator;
+
+TEST_CASE("SizeClassAllocator rounds requests to size classes",
+    "[transform][fast]") {
+
+    CHECK(TestAllocator::roundToClass(1) == 0x10);
+    CHECK(TestAllocator::roundToClass(0x11) == 0x14);
+    CHECK(TestAllocator::roundToClass(0x20) == 0x20);
+    CHECK(TestAllocator::roundToClass(0x21) == 0x28);
+    CHECK(TestAllocator::roundToClass(0x281) == 0x300);
+    CHECK(TestAllocator::roundToClass(0x10000) == 0x10000);
+    CHECK(TestAllocator::roundToClass(0x10001) == 0x11000);
+}
+
+TEST_CASE("SizeClassAllocator reuses slots after two epochs",
+    "[transform][fast]") {
+
+    MemoryBufferBacking backing(0x1000000, 0x10000);
+    TestAllocator alloc(&backing);
+
+    auto a = alloc.allocate(0x30);
+    auto b = alloc.allocate(0x30);
+    CHECK(b.getAddress() == a.getAddress() + 0x30);
+
+    alloc.release(a);
+    CHECK(alloc.getRetiredBytes() == 0x30);
+    CHECK(alloc.allocate(0x30).getAddress() == a.getAddress() + 0x60);
+
+    alloc.advanceEpoch();
+    CHECK(alloc.allocate(0x2c).getAddress() == a.getAddress() + 0x90);
+
+    alloc.advanceEpoch();
+    CHECK(alloc.getFreeBytes() == 0x30);
+    CHECK(alloc.allocate(0x2c).getAddress() == a.getAddress());
+    CHECK(alloc.getFootprint() == 0xc0);
+    CHECK(alloc.getLiveBytes() == 0xc0);
+}
+
+TEST_CASE("SizeClassAllocator throws when the backing is full",
+    "[transform][fast]") {
+
+    MemoryBufferBacking backing(0x1000000, 0x100);
+    TestAllocator alloc(&backing);
+
+    alloc.allocate(0xc0);
+    CHECK_THROWS_AS(alloc.allocate(0x50), std::bad_alloc);
+}